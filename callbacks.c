@@ -185,6 +185,12 @@ void event_tick_string(void *opaque, int ticker_id, tr_tick_type_t type, const c
     tws_cb_printf(opaque, 0, "tick_string: opaque=%p, ticker_id=%d, type=%d (%s), value=[%s]\n", opaque, ticker_id, type, tick_type_name(type), value);
 }
 
+void event_tick_rt_volume(void *opaque, int ticker_id, const tr_rt_volume_t *trade)
+{
+    tws_cb_printf(opaque, 0, "tick_rt_volume: opaque=%p, ticker_id=%d, price=%g, size=%ld, time=%lld, total_volume=%ld, vwap=%g, single_trade=%d\n",
+		opaque, ticker_id, trade->rv_price, trade->rv_size, trade->rv_time, trade->rv_total_volume, trade->rv_vwap, trade->rv_single_trade);
+}
+
 void event_tick_efp(void *opaque, int ticker_id, tr_tick_type_t tick_type, double basis_points, const char formatted_basis_points[], double implied_futures_price, int hold_days, const char future_expiry[], double dividend_impact, double dividends_to_expiry)
 {
     tws_cb_printf(opaque, 0, "tick_efp: opaque=%p, ticker_id=%d, type=%d (%s), basis_points=%g, formatted_basis_points=[%s], implied_futures_price=%g, hold_days=%d, future_expiry=[%s], dividend_impact=%g, dividends_to_expiry=%g\n",
@@ -252,6 +258,16 @@ void event_contract_details(void *opaque, int req_id, const tr_contract_details_
 	tws_cb_print_contract_details(opaque, cd);
 }
 
+void event_contract_resolution_done(void *opaque, tr_contract_resolution_t *items, int count)
+{
+    int i;
+
+    tws_cb_printf(opaque, 0, "contract_resolution_done: opaque=%p, count=%d\n", opaque, count);
+    for(i = 0; i < count; i++)
+        tws_cb_printf(opaque, 1, "req_id=%d, status=%d, num_matches=%d, conid=%d, error_code=%d\n",
+            items[i].cr_req_id, (int)items[i].cr_status, items[i].cr_num_matches, items[i].cr_conid, items[i].cr_error_code);
+}
+
 void event_bond_contract_details(void *opaque, int req_id, const tr_contract_details_t *cd)
 {
     tws_cb_printf(opaque, 0, "bond_contract_details: opaque=%p, req_id=%d, ...\n", opaque, req_id);
@@ -288,6 +304,12 @@ void event_update_news_bulletin(void *opaque, int msgid, int msg_type, const cha
 		opaque, msgid, msg_type, news_msg, origin_exch);
 }
 
+void event_update_news_bulletin_chunk(void *opaque, int msgid, int msg_type, const char data[], unsigned int len, int is_last, const char origin_exch[])
+{
+    tws_cb_printf(opaque, 0, "update_news_bulletin_chunk: opaque=%p, msgid=%d, msg_type=%d, is_last=%d, origin_exch=[%s], data(len=%u)=[%.*s]\n",
+           opaque, msgid, msg_type, is_last, origin_exch ? origin_exch : "", len, (int)len, data ? data : "");
+}
+
 void event_managed_accounts(void *opaque, const char accounts_list[])
 {
     tws_cb_printf(opaque, 0, "managed_accounts: opaque=%p, accounts_list=[%s]\n",
@@ -299,6 +321,12 @@ void event_receive_fa(void *opaque, tr_fa_msg_type_t fa_data_type, const char cx
     tws_cb_printf(opaque, 0, "receive_fa: opaque=%p, fa_data_type=%d (%s), xml='%s'\n", opaque, (int)fa_data_type, fa_msg_type_name(fa_data_type), cxml);
 }
 
+void event_receive_fa_chunk(void *opaque, tr_fa_msg_type_t fa_data_type, const char data[], unsigned int len, int is_last)
+{
+    tws_cb_printf(opaque, 0, "receive_fa_chunk: opaque=%p, fa_data_type=%d (%s), is_last=%d, xml(len=%u)='%.*s'\n",
+           opaque, (int)fa_data_type, fa_msg_type_name(fa_data_type), is_last, len, (int)len, data ? data : "");
+}
+
 void event_historical_data(void *opaque, int req_id, const char date[], double open, double high, double low, double close, long int volume, int bar_count, double wap, int has_gaps)
 {
     tws_cb_printf(opaque, 0, "historical: opaque=%p, req_id=%d, date=%s, ohlc=%.4g/%.4g/%.4g/%.4g, volume=%ld, bar_count=%d, wap=%.4g, has_gaps=%d\n",
@@ -310,11 +338,50 @@ void event_historical_data_end(void *opaque, int req_id, const char completion_f
     tws_cb_printf(opaque, 0, "historical list end: opaque=%p, req_id=%d, from date=[%s], to date=[%s]\n", opaque, req_id, completion_from, completion_to);
 }
 
+void event_historical_data_columns(void *opaque, int req_id, const tr_historical_bars_t *bars)
+{
+    int j;
+
+    tws_cb_printf(opaque, 0, "historical columns: opaque=%p, req_id=%d, count=%d\n", opaque, req_id, bars->hb_count);
+
+    for (j = 0; j < bars->hb_count; j++)
+    {
+        tws_cb_printf(opaque, 1, "bar[%d]: time=%ld, ohlc=%.4g/%.4g/%.4g/%.4g, volume=%ld, bar_count=%d, wap=%.4g, has_gaps=%d\n",
+            j, bars->hb_time[j], bars->hb_open[j], bars->hb_high[j], bars->hb_low[j], bars->hb_close[j],
+            bars->hb_volume[j], bars->hb_bar_count[j], bars->hb_wap[j], (int)bars->hb_has_gaps[j]);
+    }
+}
+
 void event_scanner_parameters(void *opaque, const char xml[])
 {
     tws_cb_printf(opaque, 0, "scanner_parameters: opaque=%p, xml(len=%d)=[%s]\n", opaque, (int)strlen(xml), xml);
 }
 
+void event_xml_start_element(void *opaque, tr_xml_source_t source, const char name[])
+{
+    tws_cb_printf(opaque, 0, "xml_start_element: opaque=%p, source=%d, name=[%s]\n", opaque, (int)source, name);
+}
+
+void event_xml_attribute(void *opaque, tr_xml_source_t source, const char name[], const char value[])
+{
+    tws_cb_printf(opaque, 1, "xml_attribute: opaque=%p, source=%d, name=[%s], value=[%s]\n", opaque, (int)source, name, value);
+}
+
+void event_xml_text(void *opaque, tr_xml_source_t source, const char text[], int len)
+{
+    tws_cb_printf(opaque, 1, "xml_text: opaque=%p, source=%d, text(len=%d)=[%s]\n", opaque, (int)source, len, text);
+}
+
+void event_xml_end_element(void *opaque, tr_xml_source_t source, const char name[])
+{
+    tws_cb_printf(opaque, 0, "xml_end_element: opaque=%p, source=%d, name=[%s]\n", opaque, (int)source, name);
+}
+
+void event_xml_end_document(void *opaque, tr_xml_source_t source)
+{
+    tws_cb_printf(opaque, 0, "xml_end_document: opaque=%p, source=%d\n", opaque, (int)source);
+}
+
 void event_scanner_data(void *opaque, int ticker_id, int rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[])
 {
     tws_cb_printf(opaque, 0, "scanner_data: opaque=%p, ticker_id=%d, rank=%d, distance=[%s], benchmark=[%s], projection=[%s], legs_str=[%s]\n",
@@ -324,6 +391,12 @@ void event_scanner_data(void *opaque, int ticker_id, int rank, tr_contract_detai
     /* it seems that NYSE traded stocks have different market_name and trading_class from NASDAQ */
 }
 
+void event_scanner_data_changed(void *opaque, int ticker_id, tr_scanner_change_t change, int conid, int rank, int prev_rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[])
+{
+    tws_cb_printf(opaque, 0, "scanner_data_changed: opaque=%p, ticker_id=%d, change=%s, conid=%d, rank=%d, prev_rank=%d\n",
+           opaque, ticker_id, change == SCANNER_ROW_ENTERED ? "entered" : change == SCANNER_ROW_LEFT ? "left" : "moved", conid, rank, prev_rank);
+}
+
 void event_scanner_data_start(void *opaque, int ticker_id, int num_elements)
 {
     tws_cb_printf(opaque, 0, "scanner_data_start: opaque=%p, ticker_id=%d, num_elements=%d\n", opaque, ticker_id, num_elements);
@@ -338,8 +411,15 @@ void event_current_time(void *opaque, long time)
 {
     char tbuf[40];
     time_t timestamp = (time_t)time;
+    struct tm tm;
 
-    strftime(tbuf, sizeof(tbuf), "[%Y%m%dT%H%M%S] ", gmtime(&timestamp));
+    /* callbacks of several instances may run at the same time (e.g. tws_decode_msg_util -j) */
+#ifdef unix
+    gmtime_r(&timestamp, &tm);
+#else
+    gmtime_s(&tm, &timestamp);
+#endif
+    strftime(tbuf, sizeof(tbuf), "[%Y%m%dT%H%M%S] ", &tm);
 
     tws_cb_printf(opaque, 0, "current_time: opaque=%p, time=%ld ~ '%s'\n", opaque, time, tbuf);
 }
@@ -349,11 +429,21 @@ void event_realtime_bar(void *opaque, int req_id, long time, double open, double
     tws_cb_printf(opaque, 0, "realtime_bar: opaque=%p, req_id=%d, time=%ld, ohlc=%.4g/%.4g/%.4g/%.4g, vol=%ld, wap=%.4g, count=%d\n", opaque, req_id, time, open, high, low, close, volume, wap, count);
 }
 
+void event_aggregated_bar(void *opaque, int req_id, int period, long time, double open, double high, double low, double close, long int volume, double wap, int count)
+{
+    tws_cb_printf(opaque, 0, "aggregated_bar: opaque=%p, req_id=%d, period=%d, time=%ld, ohlc=%.4g/%.4g/%.4g/%.4g, vol=%ld, wap=%.4g, count=%d\n", opaque, req_id, period, time, open, high, low, close, volume, wap, count);
+}
+
 void event_fundamental_data(void *opaque, int req_id, const char data[])
 {
     tws_cb_printf(opaque, 0, "fundamental_data: opaque=%p, req_id=%d, data=[%s]\n", opaque, req_id, data);
 }
 
+void event_fundamental_data_chunk(void *opaque, int req_id, const char data[], unsigned int len, int is_last)
+{
+    tws_cb_printf(opaque, 0, "fundamental_data_chunk: opaque=%p, req_id=%d, is_last=%d, data(len=%u)=[%.*s]\n", opaque, req_id, is_last, len, (int)len, data ? data : "");
+}
+
 void event_contract_details_end(void *opaque, int req_id)
 {
     tws_cb_printf(opaque, 0, "contract_details_end: opaque=%p, req_id=%d\n", opaque, req_id);
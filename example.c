@@ -1,129 +1,17 @@
 #include "twsapi.h"
 
-#ifdef unix
-#include <pthread.h>
-#include <sys/select.h>
-#include <netdb.h>
-#include <fcntl.h>
-#else
-#include <process.h>
-#include <winsock2.h>
-#include <WS2tcpip.h> /* for ipv6 DNS lookups if needed */
+#ifdef WINDOWS
+#error "example.c needs twsapi-socket.c, which is unix only: on windows give tws_create() transport callbacks of your own"
 #endif
 
+#include "twsapi-socket.h"
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
 #include <math.h>
 
-static void tws_thread_status(int state, void *tws)
-{
-    /* the real reason for having this func
-     * is so that array_of_threads[NAME_OF_THIS_ONE] can be set to
-     * pthread_self() on startup and 0 on termination, so that
-     * the top level thread can cancel one or all if it wants to
-     */
-    printf("tws reader thread %s\n", arg == 2 ? "termination pending" : arg == 1 ? "terminated" : "started");
-}
-
-static int mythread_starter(tws_func_t func, void *arg)
-{
-#ifdef unix
-    pthread_t thr;
-#endif
-    int err;
-
-#ifdef unix
-    err = pthread_create(&thr, 0, (void *(*)(void *)) func, arg);
-#else
-    /* if using _beginthreadex: beware of stack leak if func expected to
-     * use Pascal calling convention but declaration of func in another
-     * unit conveys C calling convention, wrap pascal func in C func if
-     * this is the case. Also cleanup is more complex for _beginthreadex.
-     */
-    err =  _beginthread(func, 2*8192, arg);
-#endif
-
-    return err; /* 0 success, -1 error */
-}
-
-/* User is responsible for implementing this function
- * name is a null terminated string
- * addr is where the address should be copied on success
- * addr_len contains length of addr buffer and
- * may be decreased on return to caller
- * function returns -1 on failure, 0 on success
- */
-static int resolve_name(const void *name, void *addr, long *addr_len)
-{
-    int error = -1;
-#if 1
-    struct hostent *h;
-
-    if(*addr_len < 4)
-        goto out;
-
-    h = gethostbyname((char *) name); /* does not support ipv6 either, though the API does */
-    if(!h)
-        goto out;
-
-    memcpy(addr, h->h_addr_list[0], 4);
-    *addr_len = 4;
-    error = 0;
-#else
-    struct addrinfo *ai = 0, hints;
-
-    if(*addr_len < 4)
-        goto out;
-
-    memset((void *) &hints, 0, sizeof hints);
-    hints.ai_family = PF_INET; /* first attempt ipv4 resolution */
-    hints.ai_socktype = SOCK_STREAM;
-    error = getaddrinfo((char *) name, 0, &hints, &ai);
-    if(!error && ai && ai->ai_family == PF_INET) {
-        struct sockaddr_in a4;
-
-        memcpy((void *) &a4, &ai->ai_addr[0], sizeof a4);
-        memcpy(addr, &a4.sin_addr, 4);
-        *addr_len = 4;
-        error = 0;
-    } else
-        error = -1;
-
-    if(ai)
-        freeaddrinfo(ai);
-
-    if(!error)
-        goto out;
-
-    /* try to get an ipv6 address */
-    if(*addr_len < 16) {
-        error = -1;
-        goto out;
-    }
-
-    ai = 0;
-    hints.ai_family = PF_INET6;
-    error = getaddrinfo((char *) name, 0, &hints, &ai);
-
-    if(!error && ai && ai->ai_family == PF_INET6) {
-        struct sockaddr_in6 a6;
-
-        memcpy((void *) &a6, &ai->ai_addr[0], sizeof a6);
-        memcpy(addr, &a6.sin6_addr, 16);
-        *addr_len = 16;
-        error = 0;
-    } else
-        error = -1;
-
-    if(ai)
-        freeaddrinfo(ai);
-#endif
-out:
-    return error;
-}
-
 /* find top percentage gainers (US stocks) with price > 5 and volume > 2M */
 static void scan_market(void *ti)
 {
@@ -144,29 +32,31 @@ static void scan_market(void *ti)
 
 int main(int argc, char *argv[])
 {
-    int err, no_thread = 0;
+    int err;
+    tws_socket_options_t opt;
+    tws_socket_t *sock;
     tws_instance_t *ti;
     tr_contract_t c;
 
-    if(argc != 2) {
-    usage:
-        printf("Usage: %s spawn_thread|no_thread\n", argv[0]);
+    if(argc > 4) {
+        printf("Usage: %s [host [port [client id]]]\n", argv[0]);
         return 1;
     }
 
-    if(!memcmp(argv[1], "spawn_thread", sizeof "spawn_thread" -1))
-        ;
-    else if(!memcmp(argv[1], "no_thread", sizeof "no_thread" -1))
-        no_thread = 1;
-    else
-        goto usage;
-
-    /* 'no_thread' here could also mean that an externally spawned thread
-     * that we did not create will handle IO from TWS, somehow we may happen
-     * to run in the context of that thread
-     */
-    ti = tws_create(no_thread ? TWS_NO_THREAD : mythread_starter, (void *) 0x12345, tws_thread_status);
-    err = tws_connect(ti, 0 , 7496, 1, resolve_name);
+    /* the bundled TCP transport (unix); see twsapi-socket.h for its options */
+    tws_socket_init_options(&opt);
+    if(argc > 1)
+        opt.host = argv[1];
+    if(argc > 2)
+        opt.port = (unsigned short)atoi(argv[2]);
+
+    /* the socket is the 'opaque' echoed in every callback; its user pointer is free for the application */
+    sock = tws_socket_create(&opt, NULL);
+    if(!sock) {
+        printf("out of memory\n"); exit(1);
+    }
+    ti = tws_create(sock, tws_socket_transmit, tws_socket_receive, tws_socket_flush, tws_socket_open, tws_socket_close, NULL, NULL);
+    err = tws_connect(ti, argc > 3 ? atoi(argv[3]) : 1);
     if(err) {
         printf("tws connect returned %d\n", err); exit(1);
     }
@@ -207,16 +97,12 @@ int main(int argc, char *argv[])
     tws_req_account_updates(ti, 1, "");
     tws_request_realtime_bars(ti, 4, &c, 5, "TRADES", 1);
 
-    if(no_thread) {
-        while(0 == tws_event_process(ti));
-    } else {
-#ifdef unix
-        for(;;) select(1,0,0,0,0);
-#else
-        Sleep(INFINITE);
-#endif
-    }
+    /* the events of all requests arrive here, in this thread, through the callbacks in callbacks.c */
+    while(tws_connected(ti))
+        tws_event_process(ti);
 
+    tws_disconnect(ti);
     tws_destroy(ti);
+    tws_socket_destroy(sock);
     return 0;
 }
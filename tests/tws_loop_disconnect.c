@@ -0,0 +1,239 @@
+/*
+Regression test of the event loop (twsapi-loop.h) for instances disconnected outside the loop's own processing.
+
+Four instances run over socket pairs, with the test as the server at the other end. A timer makes a request on one
+instance whose peer is gone, so that the failed send disconnects it, and reconnects another one, whose new socket most
+likely gets the number the first one's socket just gave up. The loop has to report the first instance as closed within
+that turn, without its socket number taking the second instance's new socket off epoll; both are then connected again
+and all four have to receive a message.
+
+Build from this directory, e.g. with:
+
+    cc -g -I.. -o tws_loop_disconnect tws_loop_disconnect.c ../twsapi.c ../twsapi-loop.c ../twsapi-srv-encode.c ../callbacks.c -lm
+
+Exits with 0 when the test passes.
+*/
+
+#include "twsapi.h"
+#include "twsapi-loop.h"
+#include "twsapi-srv-encode.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define CONNS       4
+#define TURN_MS     10
+#define MAX_TURNS   100             /* 1 s for each step at the most */
+
+
+typedef struct lt_conn {
+    tws_instance_t *ti;
+    int fd;                         /* the instance's end */
+    int peer;                       /* the server's end */
+    int index;
+    int messages;
+    int closed;
+} lt_conn_t;
+
+static lt_conn_t conns[CONNS];
+static int timer_fired;
+static int failures;
+
+void tws_cb_printf(void *opaque, int indent_level, const char *fmt, ...)
+{
+}
+
+void tws_debug_printf(void *opaque, const char *fmt, ...)
+{
+}
+
+static void fail(const char *what)
+{
+    printf("FAILED: %s\n", what);
+    failures++;
+}
+
+/* what the server sends: a handshake, or a message */
+static int send_to(int fd, const tws_srv_buffer_t *b)
+{
+    return !b->error && send(fd, b->data, b->len, MSG_NOSIGNAL) == (ssize_t)b->len ? 0 : -1;
+}
+
+static int lt_transmit(void *arg, const void *buf, unsigned int buflen)
+{
+    lt_conn_t *c = (lt_conn_t *)arg;
+
+    return (int)send(c->fd, buf, buflen, MSG_NOSIGNAL);
+}
+
+static int lt_receive(void *arg, void *buf, unsigned int max_bufsize)
+{
+    lt_conn_t *c = (lt_conn_t *)arg;
+
+    return (int)recv(c->fd, buf, max_bufsize, 0);
+}
+
+static int lt_flush(void *arg)
+{
+    return 0;
+}
+
+static int lt_open(void *arg)
+{
+    lt_conn_t *c = (lt_conn_t *)arg;
+    tws_srv_buffer_t b;
+    int sv[2], err;
+
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+        return CONNECT_FAIL;
+    c->fd = sv[0];
+    c->peer = sv[1];
+
+    tws_srv_buffer_init(&b, 0);
+    tws_srv_encode_hello(&b, b.server_version, "20121008 10:00:00 EST");
+    err = send_to(c->peer, &b);
+    tws_srv_buffer_free(&b);
+    return err ? CONNECT_FAIL : 0;
+}
+
+static int lt_close(void *arg)
+{
+    lt_conn_t *c = (lt_conn_t *)arg;
+
+    close(c->fd);
+    if(c->peer >= 0)
+        close(c->peer);
+    c->fd = c->peer = -1;
+    return 0;
+}
+
+/* the receive observer gets the instance: counts the messages */
+static int lt_observe(void *arg, const char *elem, unsigned int elem_size, int return_value)
+{
+    int j;
+
+    if(!elem)
+        for(j = 0; j < CONNS; j++)
+            if(conns[j].ti == (tws_instance_t *)arg)
+                conns[j].messages++;
+    return 0;
+}
+
+static void on_closed(tws_loop_t *loop, tws_instance_t *ti, void *arg)
+{
+    lt_conn_t *c = (lt_conn_t *)arg;
+
+    c->closed++;
+    if(tws_connect(ti, c->index) || tws_loop_add(loop, ti, c->fd, on_closed, c))
+        fail("cannot connect again after 'closed'");
+}
+
+static void on_timer(tws_loop_t *loop, void *arg)
+{
+    lt_conn_t *c0 = &conns[0], *c1 = &conns[1];
+    int old_fd = c0->fd;
+
+    timer_fired = 1;
+
+    /* the peer is gone: the request's send fails, which disconnects the instance and closes its socket */
+    close(c0->peer);
+    c0->peer = -1;
+    tws_req_current_time(c0->ti);
+    if(tws_connected(c0->ti))
+        fail("a failed send did not disconnect");
+
+    if(tws_reconnect(c1->ti, c1->index) || tws_loop_add(loop, c1->ti, c1->fd, on_closed, c1))
+        fail("cannot reconnect from a timer");
+    if(c1->fd != old_fd)
+        printf("note: the reconnected socket did not reuse the closed socket's number\n");
+}
+
+/* turn until 'done()' or MAX_TURNS */
+static int run_until(tws_loop_t *loop, int (*done)(void))
+{
+    int turns;
+
+    for(turns = 0; turns < MAX_TURNS && !done(); turns++)
+        if(tws_loop_run_once(loop, TURN_MS) < 0)
+            return -1;
+    return done() ? 0 : -1;
+}
+
+static int timer_done(void)
+{
+    return timer_fired;
+}
+
+static int all_received(void)
+{
+    int j;
+
+    for(j = 0; j < CONNS; j++)
+        if(!conns[j].messages)
+            return 0;
+    return 1;
+}
+
+int main(void)
+{
+    tws_loop_t *loop = tws_loop_create();
+    tws_srv_buffer_t msg;
+    int j;
+
+    if(!loop) {
+        fprintf(stderr, "cannot create a loop\n");
+        return EXIT_FAILURE;
+    }
+
+    for(j = 0; j < CONNS; j++) {
+        lt_conn_t *c = &conns[j];
+
+        c->fd = c->peer = -1;
+        c->index = j;
+        c->ti = tws_create(c, lt_transmit, lt_receive, lt_flush, lt_open, lt_close, NULL, lt_observe);
+        if(!c->ti || tws_connect(c->ti, j) || tws_loop_add(loop, c->ti, c->fd, on_closed, c)) {
+            fprintf(stderr, "cannot connect instance %d\n", j);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(!tws_loop_timer_add(loop, 20, on_timer, NULL) || run_until(loop, timer_done))
+        fail("the timer did not fire");
+    /* 'closed' comes within the turn of the timer, and has added the instance again */
+    if(conns[0].closed != 1)
+        fail("the instance disconnected by the timer was not reported closed");
+    if(conns[1].closed)
+        fail("the instance reconnected by the timer was reported closed");
+    if(tws_loop_count(loop) != CONNS)
+        fail("the loop does not hold all instances");
+
+    /* every socket has to be watched, the reconnected ones' too */
+    tws_srv_buffer_init(&msg, 0);
+    tws_srv_encode_current_time(&msg, tws_srv_msg_version(CURRENT_TIME), 1349712000);
+    for(j = 0; j < CONNS; j++) {
+        conns[j].messages = 0;
+        if(send_to(conns[j].peer, &msg))
+            fail("cannot send a message");
+    }
+    tws_srv_buffer_free(&msg);
+    if(run_until(loop, all_received))
+        for(j = 0; j < CONNS; j++)
+            if(!conns[j].messages) {
+                printf("instance %d: ", j);
+                fail("no message, its socket is not watched");
+            }
+
+    for(j = 0; j < CONNS; j++) {
+        tws_loop_remove(loop, conns[j].ti);
+        tws_disconnect(conns[j].ti);
+        tws_destroy(conns[j].ti);
+    }
+    tws_loop_destroy(loop);
+
+    if(!failures)
+        printf("ok\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
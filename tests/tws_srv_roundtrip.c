@@ -0,0 +1,957 @@
+/*
+Round trip test of the server side encoders against the decoder.
+
+For every incoming message type and every message version from 1 up to tws_srv_msg_version(), one or more messages are
+encoded with tws_srv_encode_*() and fed to tws_event_process(); the event_*() callbacks of this file encode what they are
+called with once more, with the same encoders. As decoding calls the callback with the arguments the message was encoded
+from (see twsapi-srv-encode.h), both encodings must be identical byte for byte: a field the decoder skips, misreads or
+stores in the wrong place shows as a difference, and so does a field an encoder gets wrong. Every case is fed twice, as a
+whole and one byte per receive() call, so that fields are split across receive buffers as well.
+
+Build from this directory, e.g. with:
+
+    cc -g -I.. -o tws_srv_roundtrip tws_srv_roundtrip.c ../twsapi.c ../twsapi-srv-encode.c -lm
+
+Usage: tws_srv_roundtrip [-v]
+
+    -v        print every case, not only the failed ones
+
+Exits with 0 when all cases pass.
+*/
+
+#include "twsapi.h"
+#include "twsapi-srv-encode.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+
+
+/* the decoding side: the input stream and the encoding of the callbacks' arguments */
+typedef struct rt_conn {
+    tws_srv_buffer_t in;
+    size_t pos;
+    size_t piece;                   /* bytes per receive() call */
+    tws_srv_buffer_t out;
+    int version;                    /* the version of the message being decoded: the callbacks encode at the same one */
+    tws_srv_buffer_t bars;          /* historical bars until the end of the data set, which has their count */
+    int bar_count;
+    int price_pending;              /* a tick_price waits for the size tick the decoder delivers after it */
+    int price_ticker_id;
+    tr_tick_type_t price_tick_type;
+    double price;
+    int price_can_auto_execute;
+    int unexpected;                 /* callbacks the encoders have no counterpart for */
+} rt_conn_t;
+
+static int rt_transmit(void *arg, const void *buf, unsigned int buflen)
+{
+    return (int)buflen;
+}
+
+static int rt_receive(void *arg, void *buf, unsigned int max_bufsize)
+{
+    rt_conn_t *c = (rt_conn_t *)arg;
+    size_t n = c->in.len - c->pos;
+
+    if(n > c->piece)
+        n = c->piece;
+    if(n > max_bufsize)
+        n = max_bufsize;
+    memcpy(buf, c->in.data + c->pos, n);
+    c->pos += n;
+    return (int)n;
+}
+
+static int rt_flush(void *arg)
+{
+    return 0;
+}
+
+static int rt_open(void *arg)
+{
+    return 0;
+}
+
+static int rt_close(void *arg)
+{
+    return 0;
+}
+
+static void flush_price(rt_conn_t *c, int size)
+{
+    if(c->price_pending) {
+        c->price_pending = 0;
+        tws_srv_encode_tick_price(&c->out, c->version, c->price_ticker_id, c->price_tick_type, c->price, size, c->price_can_auto_execute);
+    }
+}
+
+static const double zero = 0.0;
+
+#define CONN    ((rt_conn_t *)opaque)
+
+/* every callback but event_tick_size() starts with taking a waiting tick_price as one without size tick */
+#define ENCODE(call) do { flush_price(CONN, 0); call; } while(0)
+
+
+void event_tick_price(void *opaque, int ticker_id, tr_tick_type_t field, double price, int can_auto_execute)
+{
+    flush_price(CONN, 0);
+    if(CONN->version >= 2 && (field == BID || field == ASK || field == LAST)) {
+        CONN->price_pending = 1;
+        CONN->price_ticker_id = ticker_id;
+        CONN->price_tick_type = field;
+        CONN->price = price;
+        CONN->price_can_auto_execute = can_auto_execute;
+    } else {
+        tws_srv_encode_tick_price(&CONN->out, CONN->version, ticker_id, field, price, 0, can_auto_execute);
+    }
+}
+
+void event_tick_size(void *opaque, int ticker_id, tr_tick_type_t field, int size)
+{
+    if(CONN->price_pending)
+        flush_price(CONN, size);
+    else
+        tws_srv_encode_tick_size(&CONN->out, CONN->version, ticker_id, field, size);
+}
+
+void event_tick_option_computation(void *opaque, int ticker_id, tr_tick_type_t type, double implied_vol, double delta, double opt_price, double pv_dividend, double gamma, double vega, double theta, double und_price)
+{
+    ENCODE(tws_srv_encode_tick_option_computation(&CONN->out, CONN->version, ticker_id, type, implied_vol, delta, opt_price, pv_dividend, gamma, vega, theta, und_price));
+}
+
+void event_tick_generic(void *opaque, int ticker_id, tr_tick_type_t type, double value)
+{
+    ENCODE(tws_srv_encode_tick_generic(&CONN->out, CONN->version, ticker_id, type, value));
+}
+
+void event_tick_string(void *opaque, int ticker_id, tr_tick_type_t type, const char value[])
+{
+    ENCODE(tws_srv_encode_tick_string(&CONN->out, CONN->version, ticker_id, type, value));
+}
+
+void event_tick_rt_volume(void *opaque, int ticker_id, const tr_rt_volume_t *trade)
+{
+    char buf[128];
+
+    ENCODE(tws_srv_encode_tick_string(&CONN->out, CONN->version, ticker_id, RT_VOLUME, tws_srv_format_rt_volume(buf, sizeof buf, trade)));
+}
+
+void event_tick_efp(void *opaque, int ticker_id, tr_tick_type_t tick_type, double basis_points, const char formatted_basis_points[], double implied_futures_price, int hold_days, const char future_expiry[], double dividend_impact, double dividends_to_expiry)
+{
+    ENCODE(tws_srv_encode_tick_efp(&CONN->out, CONN->version, ticker_id, tick_type, basis_points, formatted_basis_points, implied_futures_price, hold_days, future_expiry, dividend_impact, dividends_to_expiry));
+}
+
+void event_order_status(void *opaque, int order_id, const char status[], int filled, int remaining, double avg_fill_price, int perm_id, int parent_id, double last_fill_price, int client_id, const char why_held[])
+{
+    ENCODE(tws_srv_encode_order_status(&CONN->out, CONN->version, order_id, status, filled, remaining, avg_fill_price, perm_id, parent_id, last_fill_price, client_id, why_held));
+}
+
+void event_open_order(void *opaque, int order_id, const tr_contract_t *contract, const tr_order_t *order, const tr_order_status_t *ost)
+{
+    const under_comp_t *und = contract->c_undercomp;
+    tr_contract_t c = *contract;
+
+    /* the decoder hands an absent delta neutral component over as a zeroed one */
+    if(und && !und->u_conid && !memcmp(&und->u_delta, &zero, sizeof zero) && !memcmp(&und->u_price, &zero, sizeof zero))
+        c.c_undercomp = NULL;
+    ENCODE(tws_srv_encode_open_order(&CONN->out, CONN->version, order_id, &c, order, ost));
+}
+
+void event_open_order_end(void *opaque)
+{
+    ENCODE(tws_srv_encode_open_order_end(&CONN->out, CONN->version));
+}
+
+void event_update_account_value(void *opaque, const char key[], const char val[], const char currency[], const char account_name[])
+{
+    ENCODE(tws_srv_encode_acct_value(&CONN->out, CONN->version, key, val, currency, account_name));
+}
+
+void event_update_portfolio(void *opaque, const tr_contract_t *contract, int position, double mkt_price, double mkt_value, double average_cost, double unrealized_pnl, double realized_pnl, const char account_name[])
+{
+    ENCODE(tws_srv_encode_portfolio_value(&CONN->out, CONN->version, contract, position, mkt_price, mkt_value, average_cost, unrealized_pnl, realized_pnl, account_name));
+}
+
+void event_update_account_time(void *opaque, const char time_stamp[])
+{
+    ENCODE(tws_srv_encode_acct_update_time(&CONN->out, CONN->version, time_stamp));
+}
+
+void event_next_valid_id(void *opaque, int order_id)
+{
+    ENCODE(tws_srv_encode_next_valid_id(&CONN->out, CONN->version, order_id));
+}
+
+void event_contract_details(void *opaque, int req_id, const tr_contract_details_t *contract_details)
+{
+    ENCODE(tws_srv_encode_contract_data(&CONN->out, CONN->version, req_id, contract_details));
+}
+
+void event_contract_details_end(void *opaque, int req_id)
+{
+    ENCODE(tws_srv_encode_contract_data_end(&CONN->out, CONN->version, req_id));
+}
+
+void event_contract_resolution_done(void *opaque, tr_contract_resolution_t *items, int count)
+{
+    CONN->unexpected++;
+}
+
+void event_bond_contract_details(void *opaque, int req_id, const tr_contract_details_t *contract_details)
+{
+    ENCODE(tws_srv_encode_bond_contract_data(&CONN->out, CONN->version, req_id, contract_details));
+}
+
+void event_exec_details(void *opaque, int req_id, const tr_contract_t *contract, const tr_execution_t *execution)
+{
+    ENCODE(tws_srv_encode_execution_data(&CONN->out, CONN->version, req_id, contract, execution));
+}
+
+void event_exec_details_end(void *opaque, int req_id)
+{
+    ENCODE(tws_srv_encode_execution_data_end(&CONN->out, CONN->version, req_id));
+}
+
+void event_error(void *opaque, int id, int error_code, const char error_string[])
+{
+    ENCODE(tws_srv_encode_err_msg(&CONN->out, CONN->version, id, error_code, error_string));
+}
+
+void event_update_mkt_depth(void *opaque, int ticker_id, int position, int operation, int side, double price, int size)
+{
+    ENCODE(tws_srv_encode_market_depth(&CONN->out, CONN->version, ticker_id, position, operation, side, price, size));
+}
+
+void event_update_mkt_depth_l2(void *opaque, int ticker_id, int position, const char *market_maker, int operation, int side, double price, int size)
+{
+    ENCODE(tws_srv_encode_market_depth_l2(&CONN->out, CONN->version, ticker_id, position, market_maker, operation, side, price, size));
+}
+
+void event_update_news_bulletin(void *opaque, int msgid, int msg_type, const char news_msg[], const char origin_exch[])
+{
+    ENCODE(tws_srv_encode_news_bulletins(&CONN->out, CONN->version, msgid, msg_type, news_msg, origin_exch));
+}
+
+void event_update_news_bulletin_chunk(void *opaque, int msgid, int msg_type, const char data[], unsigned int len, int is_last, const char origin_exch[])
+{
+    CONN->unexpected++;
+}
+
+void event_managed_accounts(void *opaque, const char accounts_list[])
+{
+    ENCODE(tws_srv_encode_managed_accts(&CONN->out, CONN->version, accounts_list));
+}
+
+void event_receive_fa(void *opaque, tr_fa_msg_type_t fa_data_type, const char cxml[])
+{
+    ENCODE(tws_srv_encode_receive_fa(&CONN->out, CONN->version, fa_data_type, cxml));
+}
+
+void event_receive_fa_chunk(void *opaque, tr_fa_msg_type_t fa_data_type, const char data[], unsigned int len, int is_last)
+{
+    CONN->unexpected++;
+}
+
+void event_historical_data(void *opaque, int req_id, const char date[], double open, double high, double low, double close, long int volume, int bar_count, double wap, int has_gaps)
+{
+    flush_price(CONN, 0);
+    tws_srv_encode_historical_bar(&CONN->bars, CONN->version, date, open, high, low, close, volume, bar_count, wap, has_gaps);
+    CONN->bar_count++;
+}
+
+void event_historical_data_end(void *opaque, int req_id, const char completion_from[], const char completion_to[])
+{
+    ENCODE(tws_srv_encode_historical_data(&CONN->out, CONN->version, req_id, completion_from, completion_to, CONN->bar_count));
+    tws_srv_put_bytes(&CONN->out, CONN->bars.data, CONN->bars.len);
+    tws_srv_buffer_reset(&CONN->bars);
+    CONN->bar_count = 0;
+}
+
+void event_historical_data_columns(void *opaque, int req_id, const tr_historical_bars_t *bars)
+{
+    CONN->unexpected++;
+}
+
+void event_scanner_parameters(void *opaque, const char xml[])
+{
+    ENCODE(tws_srv_encode_scanner_parameters(&CONN->out, CONN->version, xml));
+}
+
+void event_xml_start_element(void *opaque, tr_xml_source_t source, const char name[])
+{
+    CONN->unexpected++;
+}
+
+void event_xml_attribute(void *opaque, tr_xml_source_t source, const char name[], const char value[])
+{
+    CONN->unexpected++;
+}
+
+void event_xml_text(void *opaque, tr_xml_source_t source, const char text[], int len)
+{
+    CONN->unexpected++;
+}
+
+void event_xml_end_element(void *opaque, tr_xml_source_t source, const char name[])
+{
+    CONN->unexpected++;
+}
+
+void event_xml_end_document(void *opaque, tr_xml_source_t source)
+{
+    CONN->unexpected++;
+}
+
+void event_scanner_data(void *opaque, int ticker_id, int rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[])
+{
+    ENCODE(tws_srv_encode_scanner_row(&CONN->out, CONN->version, rank, cd, distance, benchmark, projection, legs_str));
+}
+
+void event_scanner_data_changed(void *opaque, int ticker_id, tr_scanner_change_t change, int conid, int rank, int prev_rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[])
+{
+    CONN->unexpected++;
+}
+
+void event_scanner_data_end(void *opaque, int ticker_id, int num_elements)
+{
+    flush_price(CONN, 0);
+}
+
+void event_scanner_data_start(void *opaque, int ticker_id, int num_elements)
+{
+    ENCODE(tws_srv_encode_scanner_data(&CONN->out, CONN->version, ticker_id, num_elements));
+}
+
+void event_current_time(void *opaque, long time)
+{
+    ENCODE(tws_srv_encode_current_time(&CONN->out, CONN->version, time));
+}
+
+void event_realtime_bar(void *opaque, int req_id, long time, double open, double high, double low, double close, long int volume, double wap, int count)
+{
+    ENCODE(tws_srv_encode_realtime_bars(&CONN->out, CONN->version, req_id, time, open, high, low, close, volume, wap, count));
+}
+
+void event_aggregated_bar(void *opaque, int req_id, int period, long time, double open, double high, double low, double close, long int volume, double wap, int count)
+{
+    CONN->unexpected++;
+}
+
+void event_fundamental_data(void *opaque, int req_id, const char data[])
+{
+    ENCODE(tws_srv_encode_fundamental_data(&CONN->out, CONN->version, req_id, data));
+}
+
+void event_fundamental_data_chunk(void *opaque, int req_id, const char data[], unsigned int len, int is_last)
+{
+    CONN->unexpected++;
+}
+
+void event_delta_neutral_validation(void *opaque, int req_id, const under_comp_t *und)
+{
+    ENCODE(tws_srv_encode_delta_neutral_validation(&CONN->out, CONN->version, req_id, und));
+}
+
+void event_acct_download_end(void *opaque, const char acct_name[])
+{
+    ENCODE(tws_srv_encode_acct_download_end(&CONN->out, CONN->version, acct_name));
+}
+
+void event_tick_snapshot_end(void *opaque, int req_id)
+{
+    ENCODE(tws_srv_encode_tick_snapshot_end(&CONN->out, CONN->version, req_id));
+}
+
+void event_market_data_type(void *opaque, int req_id, market_data_type_t data_type)
+{
+    ENCODE(tws_srv_encode_market_data_type(&CONN->out, CONN->version, req_id, data_type));
+}
+
+void event_commission_report(void *opaque, tr_commission_report_t *report)
+{
+    ENCODE(tws_srv_encode_commission_report(&CONN->out, CONN->version, report));
+}
+
+#undef ENCODE
+#undef CONN
+
+
+/* the messages of the cases: a contract with combo legs and a delta neutral component, an order using most features */
+static tr_contract_t contract;
+static tr_comboleg_t contract_legs[2];
+static under_comp_t under_comp;
+static tr_order_t order;
+static tr_order_combo_leg_t order_legs[2];
+static tr_tag_value_t algo_params[2], smart_params[1], sec_ids[1];
+static tr_order_status_t order_status;
+static tr_contract_details_t details;
+static tr_execution_t execution;
+static tr_commission_report_t commission;
+
+static void setup_messages(tws_instance_t *ti)
+{
+    int k;
+
+    tws_init_contract(ti, &contract);
+    contract.c_conid = 265598;
+    tws_strcpy(contract.c_symbol, "AAPL");
+    tws_strcpy(contract.c_sectype, "BAG");
+    tws_strcpy(contract.c_expiry, "20121020");
+    contract.c_strike = 600;
+    tws_strcpy(contract.c_right, "C");
+    tws_strcpy(contract.c_multiplier, "100");
+    tws_strcpy(contract.c_exchange, "SMART");
+    tws_strcpy(contract.c_primary_exch, "NASDAQ");
+    tws_strcpy(contract.c_currency, "USD");
+    tws_strcpy(contract.c_local_symbol, "AAPL  121020C00600000");
+    tws_strcpy(contract.c_combolegs_descrip, "100|1,101|2");
+    for(k = 0; k < 2; k++) {
+        tws_init_tr_comboleg(ti, &contract_legs[k]);
+        contract_legs[k].co_conid = 100 + k;
+        contract_legs[k].co_ratio = 1 + k;
+        tws_strcpy(contract_legs[k].co_action, k ? "SELL" : "BUY");
+        tws_strcpy(contract_legs[k].co_exchange, "SMART");
+        contract_legs[k].co_open_close = COMBOLEG_SAME;
+        contract_legs[k].co_exempt_code = -1;
+    }
+    contract.c_comboleg = contract_legs;
+    contract.c_num_combolegs = 2;
+    under_comp.u_conid = 4242;
+    under_comp.u_delta = 0.5;
+    under_comp.u_price = 99.5;
+    contract.c_undercomp = &under_comp;
+
+    for(k = 0; k < 2; k++)
+        tws_init_tag_value(ti, &algo_params[k]);
+    tws_strcpy(algo_params[0].t_tag, "maxPct");
+    tws_strcpy(algo_params[0].t_val, "0.1");
+    tws_strcpy(algo_params[1].t_tag, "noTakeLiq");
+    tws_strcpy(algo_params[1].t_val, "1");
+    tws_init_tag_value(ti, &smart_params[0]);
+    tws_strcpy(smart_params[0].t_tag, "NonGuaranteed");
+    tws_strcpy(smart_params[0].t_val, "1");
+    tws_init_tag_value(ti, &sec_ids[0]);
+    tws_strcpy(sec_ids[0].t_tag, "ISIN");
+    tws_strcpy(sec_ids[0].t_val, "US0378331005");
+
+    tws_init_order(ti, &order);
+    tws_strcpy(order.o_action, "BUY");
+    order.o_total_quantity = 10;
+    tws_strcpy(order.o_order_type, "LMT");
+    order.o_lmt_price = 1.25;
+    tws_strcpy(order.o_tif, "DAY");
+    tws_strcpy(order.o_account, "DU1");
+    tws_strcpy(order.o_open_close, "O");
+    order.o_clientid = 3;
+    order.o_permid = 999;
+    order.o_outside_rth = 1;
+    order.o_hidden = 1;
+    order.o_discretionary_amt = 0.5;
+    tws_strcpy(order.o_fagroup, "grp");
+    tws_strcpy(order.o_rule80a, "A");
+    order.o_percent_offset = 0.01;
+    order.o_exempt_code = 3;
+    order.o_min_qty = 5;
+    order.o_oca_type = 2;
+    order.o_parentid = 54;
+    order.o_trigger_method = 2;
+    order.o_volatility = 0.3;
+    order.o_volatility_type = 2;
+    tws_strcpy(order.o_delta_neutral_order_type, "LMT");
+    order.o_delta_neutral_aux_price = 2.5;
+    order.o_delta_neutral_con_id = 11;
+    tws_strcpy(order.o_delta_neutral_settling_firm, "SF");
+    order.o_continuous_update = 1;
+    order.o_reference_price_type = 1;
+    order.o_trail_stop_price = 1.1;
+    order.o_trailing_percent = 2;
+    for(k = 0; k < 2; k++)
+        tws_init_order_combo_leg(ti, &order_legs[k]);
+    order_legs[1].cl_price = 1.5;
+    order.o_combo_legs = order_legs;
+    order.o_combo_legs_count = 2;
+    order.o_smart_combo_routing_params = smart_params;
+    order.o_smart_combo_routing_params_count = 1;
+    order.o_scale_init_level_size = 100;
+    order.o_scale_subs_level_size = 50;
+    order.o_scale_price_increment = 0.05;
+    order.o_scale_price_adjust_value = 0.01;
+    order.o_scale_price_adjust_interval = 60;
+    order.o_scale_profit_offset = 0.2;
+    order.o_scale_auto_reset = 1;
+    order.o_scale_init_position = 10;
+    order.o_scale_init_fill_qty = 5;
+    order.o_scale_random_percent = 1;
+    tws_strcpy(order.o_hedge_type, "D");
+    tws_strcpy(order.o_hedge_param, "0.5");
+    order.o_opt_out_smart_routing = 1;
+    tws_strcpy(order.o_clearing_intent, "IB");
+    order.o_not_held = 1;
+    tws_strcpy(order.o_algo_strategy, "Vwap");
+    order.o_algo_params = algo_params;
+    order.o_algo_params_count = 2;
+    order.o_whatif = 1;
+
+    memset(&order_status, 0, sizeof order_status);
+    order_status.ost_status = "PreSubmitted";
+    order_status.ost_init_margin = "1000";
+    order_status.ost_commission = 1.5;
+    order_status.ost_min_commission = DBL_MAX;
+    order_status.ost_max_commission = DBL_MAX;
+    order_status.ost_commission_currency = "USD";
+    order_status.ost_warning_text = "w";
+
+    memset(&details, 0, sizeof details);
+    details.d_summary = contract;
+    details.d_summary.c_comboleg = NULL;
+    details.d_summary.c_num_combolegs = 0;
+    details.d_summary.c_undercomp = NULL;
+    details.d_market_name = "AAPL";
+    details.d_trading_class = "AAPL";
+    details.d_mintick = 0.01;
+    details.d_order_types = "LMT,MKT";
+    details.d_valid_exchanges = "SMART,CBOE";
+    details.d_price_magnifier = 1;
+    details.d_under_conid = 265598;
+    details.d_long_name = "APPLE INC";
+    details.d_contract_month = "201210";
+    details.d_industry = "Technology";
+    details.d_category = "Computers";
+    details.d_subcategory = "Hardware";
+    details.d_timezone_id = "EST";
+    details.d_trading_hours = "20121008:0400-2000;20121009:0400-2000";
+    details.d_liquid_hours = "20121008:0930-1600;20121009:0930-1600";
+    details.d_ev_rule = "aapl";
+    details.d_ev_multiplier = 2.5;
+    details.d_cusip = "912828";
+    details.d_coupon = 2.5;
+    details.d_maturity = "20221015";
+    details.d_issue_date = "20121015";
+    details.d_ratings = "AAA";
+    details.d_bond_type = "GOVT";
+    details.d_coupon_type = "FIXED";
+    details.d_convertible = 1;
+    details.d_putable = 1;
+    details.d_desc_append = "note";
+    details.d_next_option_date = "20130101";
+    details.d_next_option_type = "CALL";
+    details.d_next_option_partial = 1;
+    details.d_notes = "n";
+    details.d_sec_id_list = sec_ids;
+    details.d_sec_id_list_count = 1;
+
+    memset(&execution, 0, sizeof execution);
+    execution.e_orderid = 55;
+    execution.e_execid = "0001.01";
+    execution.e_time = "20121008  10:00:01";
+    execution.e_acct_number = "DU1";
+    execution.e_exchange = "ISLAND";
+    execution.e_side = "BOT";
+    execution.e_shares = 100;
+    execution.e_price = 635.85;
+    execution.e_permid = 9;
+    execution.e_clientid = 3;
+    execution.e_liquidation = 1;
+    execution.e_cum_qty = 100;
+    execution.e_avg_price = 635.8;
+    execution.e_orderref = "ref";
+    execution.e_ev_rule = "r";
+    execution.e_ev_multiplier = 1.5;
+
+    memset(&commission, 0, sizeof commission);
+    commission.cr_exec_id = "0001.01";
+    commission.cr_currency = "USD";
+    commission.cr_commission = 1.25;
+    commission.cr_realized_pnl = DBL_MAX;
+    commission.cr_yield = 0.035;
+    commission.cr_yield_redemption_date = 20121008;
+}
+
+/* the case encoders: the message(s) of one type at 'version' */
+
+static void enc_tick_price(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_price(b, version, 3, BID, 101.25, 700, 1);
+    tws_srv_encode_tick_price(b, version, 3, LAST, 101.3, 100, 0);
+    tws_srv_encode_tick_price(b, version, 3, HIGH, 102.5, 0, 0);
+}
+
+static void enc_tick_size(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_size(b, version, 4, VOLUME, 12345);
+}
+
+static void enc_tick_option_computation(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_option_computation(b, version, 5, MODEL_OPTION, 0.25, DBL_MAX, 2.5, DBL_MAX, 0.04, DBL_MAX, -0.02, 101.5);
+    tws_srv_encode_tick_option_computation(b, version, 5, BID_OPTION, 0.2515625, 0.55, 2.35, 0.12, 0.0473, 0.1134, -0.0217, 101.25);
+}
+
+static void enc_tick_generic(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_generic(b, version, 6, HALTED, 1);
+}
+
+static void enc_tick_string(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_string(b, version, 7, LAST_TIMESTAMP, "1349712000");
+}
+
+static void enc_rt_volume(tws_srv_buffer_t *b, int version)
+{
+    tr_rt_volume_t rv;
+    char buf[128];
+
+    rv.rv_price = 635.85;
+    rv.rv_size = 300;
+    rv.rv_time = 1349712000123LL;
+    rv.rv_total_volume = 987654;
+    rv.rv_vwap = 634.125;
+    rv.rv_single_trade = 1;
+    tws_srv_encode_tick_string(b, version, 8, RT_VOLUME, tws_srv_format_rt_volume(buf, sizeof buf, &rv));
+}
+
+/* cut short: decoded with tws_set_rt_volume_decoding(), these have to come back as plain tick strings */
+static void enc_rt_volume_truncated(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_string(b, version, 8, RT_VOLUME, "635.85;300;1349712000123");
+    tws_srv_encode_tick_string(b, version, 8, RT_VOLUME, "635.85;300;1349712000123;987654;634.125");
+    tws_srv_encode_tick_string(b, version, 8, RT_VOLUME, "635.85;300;1349712000123;987654;634.125;");
+}
+
+static void enc_tick_efp(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_efp(b, version, 9, BID_EFP_COMPUTATION, 12.5, "12.5 bp", 101.5, 30, "20121221", 0.5, 1.25);
+}
+
+static void enc_order_status(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_order_status(b, version, 10, "Filled", 100, 0, 82.8, 1234, 5, 82.75, 7, "locate");
+}
+
+static void enc_acct_value(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_acct_value(b, version, "NetLiquidation", "100000.5", "USD", "DU1");
+}
+
+static void enc_portfolio_value(tws_srv_buffer_t *b, int version)
+{
+    tr_contract_t c = contract;
+
+    tws_strcpy(c.c_sectype, "OPT");
+    c.c_comboleg = NULL;
+    c.c_num_combolegs = 0;
+    c.c_undercomp = NULL;
+    tws_srv_encode_portfolio_value(b, version, &c, 3, 1.5, 450, 1.25, 75, -3, "DU1");
+}
+
+static void enc_acct_update_time(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_acct_update_time(b, version, "10:01");
+}
+
+static void enc_err_msg(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_err_msg(b, version, 12, 200, "No security definition has been found for the request");
+}
+
+static void enc_open_order(tws_srv_buffer_t *b, int version)
+{
+    tr_contract_t c = contract;
+    tr_order_t o = order;
+
+    /* with combo legs, algo and scale parameters and a delta neutral component, then as a plain order arrives */
+    tws_srv_encode_open_order(b, version, 55, &contract, &order, &order_status);
+
+    tws_strcpy(c.c_sectype, "OPT");
+    c.c_comboleg = NULL;
+    c.c_num_combolegs = 0;
+    c.c_undercomp = NULL;
+    o.o_combo_legs = NULL;
+    o.o_combo_legs_count = 0;
+    o.o_smart_combo_routing_params = NULL;
+    o.o_smart_combo_routing_params_count = 0;
+    o.o_algo_params = NULL;
+    o.o_algo_params_count = 0;
+    o.o_algo_strategy = NULL;
+    o.o_scale_price_increment = DBL_MAX;
+    tws_srv_encode_open_order(b, version, 56, &c, &o, &order_status);
+}
+
+static void enc_next_valid_id(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_next_valid_id(b, version, 77);
+}
+
+static void enc_contract_data(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_contract_data(b, version, 13, &details);
+}
+
+static void enc_bond_contract_data(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_bond_contract_data(b, version, 14, &details);
+}
+
+static void enc_execution_data(tws_srv_buffer_t *b, int version)
+{
+    tr_contract_t c = contract;
+
+    tws_strcpy(c.c_sectype, "OPT");
+    c.c_comboleg = NULL;
+    c.c_num_combolegs = 0;
+    c.c_undercomp = NULL;
+    tws_srv_encode_execution_data(b, version, 15, &c, &execution);
+}
+
+static void enc_market_depth(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_market_depth(b, version, 16, 2, 1, 0, 100.25, 300);
+}
+
+static void enc_market_depth_l2(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_market_depth_l2(b, version, 17, 2, "ARCA", 1, 1, 100.5, 200);
+}
+
+static void enc_news_bulletins(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_news_bulletins(b, version, 18, 1, "Trading halted", "NYSE");
+}
+
+static void enc_managed_accts(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_managed_accts(b, version, "DU1,DU2");
+}
+
+static void enc_receive_fa(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_receive_fa(b, version, GROUPS, "<ListOfGroups><Group><name>g</name></Group></ListOfGroups>");
+}
+
+static void enc_historical_data(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_historical_data(b, version, 19, "20121008 00:00:00", "20121010 00:00:00", 2);
+    tws_srv_encode_historical_bar(b, version, "20121008", 1, 2, 0.5, 1.5, 1000, 10, 1.25, 0);
+    tws_srv_encode_historical_bar(b, version, "20121009", 1.5, 2.5, 1, 2, 2000, 20, 1.75, 1);
+}
+
+static void enc_scanner_parameters(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_scanner_parameters(b, version, "<ScanParameterResponse></ScanParameterResponse>");
+}
+
+static void enc_scanner_data(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_scanner_data(b, version, 20, 2);
+    tws_srv_encode_scanner_row(b, version, 0, &details, "d", "b", "p", "l");
+    tws_srv_encode_scanner_row(b, version, 1, &details, "", "", "", "");
+}
+
+static void enc_current_time(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_current_time(b, version, 1349712000);
+}
+
+static void enc_realtime_bars(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_realtime_bars(b, version, 21, 1349712005, 1, 2, 0.5, 1.5, 1200, 1.25, 11);
+}
+
+static void enc_fundamental_data(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_fundamental_data(b, version, 22, "<ReportSnapshot></ReportSnapshot>");
+}
+
+static void enc_contract_data_end(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_contract_data_end(b, version, 23);
+}
+
+static void enc_open_order_end(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_open_order_end(b, version);
+}
+
+static void enc_acct_download_end(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_acct_download_end(b, version, "DU1");
+}
+
+static void enc_execution_data_end(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_execution_data_end(b, version, 24);
+}
+
+static void enc_delta_neutral_validation(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_delta_neutral_validation(b, version, 25, &under_comp);
+}
+
+static void enc_tick_snapshot_end(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_tick_snapshot_end(b, version, 26);
+}
+
+static void enc_market_data_type(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_market_data_type(b, version, 27, FROZEN);
+}
+
+static void enc_commission_report(tws_srv_buffer_t *b, int version)
+{
+    tws_srv_encode_commission_report(b, version, &commission);
+}
+
+typedef struct rt_case {
+    tws_incoming_id_t id;
+    void (*encode)(tws_srv_buffer_t *b, int version);
+    int rt_volume;                  /* decode with tws_set_rt_volume_decoding() */
+} rt_case_t;
+
+static const rt_case_t rt_cases[] = {
+    { TICK_PRICE, enc_tick_price, 0 },
+    { TICK_SIZE, enc_tick_size, 0 },
+    { TICK_OPTION_COMPUTATION, enc_tick_option_computation, 0 },
+    { TICK_GENERIC, enc_tick_generic, 0 },
+    { TICK_STRING, enc_tick_string, 0 },
+    { TICK_STRING, enc_rt_volume, 0 },
+    { TICK_STRING, enc_rt_volume, 1 },
+    { TICK_STRING, enc_rt_volume_truncated, 1 },
+    { TICK_EFP, enc_tick_efp, 0 },
+    { ORDER_STATUS, enc_order_status, 0 },
+    { ACCT_VALUE, enc_acct_value, 0 },
+    { PORTFOLIO_VALUE, enc_portfolio_value, 0 },
+    { ACCT_UPDATE_TIME, enc_acct_update_time, 0 },
+    { ERR_MSG, enc_err_msg, 0 },
+    { OPEN_ORDER, enc_open_order, 0 },
+    { NEXT_VALID_ID, enc_next_valid_id, 0 },
+    { SCANNER_DATA, enc_scanner_data, 0 },
+    { CONTRACT_DATA, enc_contract_data, 0 },
+    { EXECUTION_DATA, enc_execution_data, 0 },
+    { MARKET_DEPTH, enc_market_depth, 0 },
+    { MARKET_DEPTH_L2, enc_market_depth_l2, 0 },
+    { NEWS_BULLETINS, enc_news_bulletins, 0 },
+    { MANAGED_ACCTS, enc_managed_accts, 0 },
+    { RECEIVE_FA, enc_receive_fa, 0 },
+    { HISTORICAL_DATA, enc_historical_data, 0 },
+    { BOND_CONTRACT_DATA, enc_bond_contract_data, 0 },
+    { SCANNER_PARAMETERS, enc_scanner_parameters, 0 },
+    { CURRENT_TIME, enc_current_time, 0 },
+    { REAL_TIME_BARS, enc_realtime_bars, 0 },
+    { FUNDAMENTAL_DATA, enc_fundamental_data, 0 },
+    { CONTRACT_DATA_END, enc_contract_data_end, 0 },
+    { OPEN_ORDER_END, enc_open_order_end, 0 },
+    { ACCT_DOWNLOAD_END, enc_acct_download_end, 0 },
+    { EXECUTION_DATA_END, enc_execution_data_end, 0 },
+    { DELTA_NEUTRAL_VALIDATION, enc_delta_neutral_validation, 0 },
+    { TICK_SNAPSHOT_END, enc_tick_snapshot_end, 0 },
+    { MARKET_DATA_TYPE, enc_market_data_type, 0 },
+    { COMMISSION_REPORT, enc_commission_report, 0 }
+};
+
+/* print a stream with the fields separated by '|' */
+static void print_fields(const char *label, const tws_srv_buffer_t *b)
+{
+    size_t i;
+
+    printf("    %s:", label);
+    for(i = 0; i < b->len; i++)
+        putchar(b->data[i] ? b->data[i] : '|');
+    putchar('\n');
+}
+
+/* decode the input of 'c' from a fresh connection; returns 0 when the callbacks encoded exactly the input */
+static int run_case(rt_conn_t *c, const rt_case_t *rc, int version, size_t piece, int verbose)
+{
+    tws_instance_t *ti = tws_create(c, rt_transmit, rt_receive, rt_flush, rt_open, rt_close, 0, 0);
+    size_t end;
+    int ok;
+
+    tws_srv_buffer_reset(&c->in);
+    tws_srv_buffer_reset(&c->out);
+    tws_srv_buffer_reset(&c->bars);
+    c->pos = 0;
+    c->piece = piece;
+    c->version = version;
+    c->bar_count = 0;
+    c->price_pending = 0;
+    c->unexpected = 0;
+
+    tws_srv_encode_hello(&c->in, c->in.server_version, "20121008 10:00:00 EST");
+    if(!ti || tws_connect(ti, 1)) {
+        printf("%s: cannot connect\n", tws_incoming_msg_name(rc->id));
+        if(ti)
+            tws_destroy(ti);
+        return -1;
+    }
+    tws_set_rt_volume_decoding(ti, rc->rt_volume);
+
+    tws_srv_buffer_reset(&c->in);
+    c->pos = 0;
+    rc->encode(&c->in, version);
+    /* a message id the decoder does not know ends the stream */
+    end = c->in.len;
+    tws_srv_put_int(&c->in, 0);
+    while(tws_connected(ti) && !tws_event_process(ti))
+        ;
+    flush_price(c, 0);
+
+    ok = tws_connected(ti) && c->pos == c->in.len && !c->unexpected && !c->in.error && !c->out.error
+        && c->out.len == end && !memcmp(c->out.data, c->in.data, end);
+    if(!ok || verbose) {
+        printf("%s version %d%s, %u byte pieces: %s\n", tws_incoming_msg_name(rc->id), version, rc->rt_volume ? " (rt_volume)" : "",
+               (unsigned int)piece, ok ? "ok" : tws_connected(ti) ? "FAILED" : "FAILED, the decoder dropped the connection");
+        if(!ok) {
+            print_fields("sent   ", &c->in);
+            print_fields("decoded", &c->out);
+        }
+    }
+
+    tws_destroy(ti);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t pieces[] = { 1 << 16, 1 };
+    rt_conn_t conn;
+    tws_instance_t *ti;
+    int verbose = argc > 1 && !strcmp(argv[1], "-v");
+    int cases = 0, failed = 0, version, p;
+    size_t i;
+
+    /* the messages' strings come from an instance's pool, as an application's do */
+    ti = tws_create(NULL, rt_transmit, rt_receive, rt_flush, rt_open, rt_close, 0, 0);
+    if(!ti) {
+        fprintf(stderr, "cannot create an instance\n");
+        return EXIT_FAILURE;
+    }
+    setup_messages(ti);
+
+    memset(&conn, 0, sizeof conn);
+    tws_srv_buffer_init(&conn.in, 0);
+    tws_srv_buffer_init(&conn.out, 0);
+    tws_srv_buffer_init(&conn.bars, 0);
+
+    for(i = 0; i < sizeof rt_cases / sizeof rt_cases[0]; i++) {
+        for(version = 1; version <= tws_srv_msg_version(rt_cases[i].id); version++) {
+            for(p = 0; p < (int)(sizeof pieces / sizeof pieces[0]); p++) {
+                cases++;
+                if(run_case(&conn, &rt_cases[i], version, pieces[p], verbose))
+                    failed++;
+            }
+        }
+    }
+    printf("%d cases, %d failed\n", cases, failed);
+
+    tws_srv_buffer_free(&conn.in);
+    tws_srv_buffer_free(&conn.out);
+    tws_srv_buffer_free(&conn.bars);
+    tws_destroy(ti);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,921 @@
+/*
+Decoder and encoder throughput benchmark.
+
+Decoder: builds a synthetic wire stream for each of a set of incoming message types and feeds it through
+tws_event_process() from an in-memory receive function, in receive buffer sized pieces, as a socket under load would
+deliver it. Reports messages/s, ns/message, bytes/s and heap allocations per message for every type.
+
+Encoder: sends simple, algo, combo and scale orders, market data (single contract and BAG), historical data requests and
+order cancellations over a transport that drops what it is given. Reports the bytes on the wire per request, the
+mean and percentiles of the time a single call takes, and heap allocations per request.
+
+The library is compiled into this file (see the #include "twsapi.c" below) so that its heap calls can be counted;
+the default callbacks.c is linked in with a tws_cb_printf() that prints nothing, so the figures cover the decoder
+and the callback invocation, not any formatting. Build with the flags used in production, e.g.:
+
+    cc -O2 -D_REENTRANT -o tws_bench tws_bench.c twsapi-srv-encode.c -lm
+
+Usage: tws_bench [-d|-e] [-l] [-s <seconds per type>] [-t <message or request name>]
+
+    -d, -e    run the decoder or the encoder part only
+    -l        also print the decoder latency percentiles of tws_enable_latency_stats() (which slows the decoder down a little)
+*/
+
+/* system headers first: the allocation counting macros below must not touch their declarations */
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+#ifdef unix
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#endif
+
+static unsigned long long bench_allocs;
+
+static void *bench_malloc(size_t n)
+{
+    bench_allocs++;
+    return malloc(n);
+}
+
+static void *bench_calloc(size_t n, size_t size)
+{
+    bench_allocs++;
+    return calloc(n, size);
+}
+
+static void *bench_realloc(void *p, size_t n)
+{
+    bench_allocs++;
+    return realloc(p, n);
+}
+
+#define malloc(n)           bench_malloc(n)
+#define calloc(n, size)     bench_calloc(n, size)
+#define realloc(p, n)       bench_realloc(p, n)
+#include "twsapi.c"
+#undef malloc
+#undef calloc
+#undef realloc
+
+#include "callbacks.c"
+#include "twsapi-srv-encode.h"
+
+void tws_cb_printf(void *opaque, int indent_level, const char *fmt, ...)
+{
+}
+
+void tws_debug_printf(void *opaque, const char *fmt, ...)
+{
+}
+
+
+/* message generators, written with the server side field writers: 'i' varies ids, prices and sizes from message to message */
+
+static void gen_tick_price(tws_srv_buffer_t *w, int i)
+{
+    static const int types[] = { BID, ASK, LAST };
+
+    tws_srv_put_int(w, TICK_PRICE);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_int(w, types[i % 3]);
+    tws_srv_put_double(w, 100 + (i % 1000) * 0.01);
+    tws_srv_put_int(w, 100 + i % 7 * 100);
+    tws_srv_put_int(w, 1);
+}
+
+static void gen_tick_size(tws_srv_buffer_t *w, int i)
+{
+    static const int types[] = { BID_SIZE, ASK_SIZE, VOLUME };
+
+    tws_srv_put_int(w, TICK_SIZE);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_int(w, types[i % 3]);
+    tws_srv_put_int(w, 100 + i % 50 * 100);
+}
+
+static void gen_tick_option_computation(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, TICK_OPTION_COMPUTATION);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, i % 500);
+    tws_srv_put_int(w, BID_OPTION + i % 4);
+    tws_srv_put_double(w, 0.2 + (i % 100) * 0.001);
+    tws_srv_put_double(w, 0.55 - (i % 100) * 0.001);
+    tws_srv_put_double(w, 2.35 + (i % 100) * 0.01);
+    tws_srv_put_double(w, 0.12);
+    tws_srv_put_double(w, 0.0473);
+    tws_srv_put_double(w, 0.1134);
+    tws_srv_put_double(w, -0.0217);
+    tws_srv_put_double(w, 101.25 + (i % 100) * 0.01);
+}
+
+static void gen_tick_generic(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, TICK_GENERIC);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_int(w, HALTED);
+    tws_srv_put_double(w, 0);
+}
+
+static void gen_tick_string(tws_srv_buffer_t *w, int i)
+{
+    char buf[32];
+
+    tws_srv_put_int(w, TICK_STRING);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_int(w, LAST_TIMESTAMP);
+    sprintf(buf, "%d", 1349712000 + i);
+    tws_srv_put_str(w, buf);
+}
+
+static void gen_order_status(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, ORDER_STATUS);
+    tws_srv_put_int(w, 6);
+    tws_srv_put_int(w, 1000 + i % 100);
+    tws_srv_put_str(w, i % 2 ? "Submitted" : "Filled");
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_int(w, 100 - i % 100);
+    tws_srv_put_double(w, 82.8);
+    tws_srv_put_int(w, 121390623 + i % 100);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_double(w, 82.8);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_str(w, "");
+}
+
+static void gen_acct_value(tws_srv_buffer_t *w, int i)
+{
+    static const char *const keys[] = { "NetLiquidation", "BuyingPower", "AvailableFunds", "ExcessLiquidity" };
+
+    tws_srv_put_int(w, ACCT_VALUE);
+    tws_srv_put_int(w, 2);
+    tws_srv_put_str(w, keys[i % 4]);
+    tws_srv_put_double(w, 1000000 + i % 1000 * 12.5);
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "DU15143");
+}
+
+static void gen_portfolio_value(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, PORTFOLIO_VALUE);
+    tws_srv_put_int(w, 7);
+    tws_srv_put_int(w, 265598 + i % 20);
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_str(w, "STK");
+    tws_srv_put_str(w, "");
+    tws_srv_put_double(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "NASDAQ");
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_int(w, 100 + i % 20);
+    tws_srv_put_double(w, 635.85);
+    tws_srv_put_double(w, 63585);
+    tws_srv_put_double(w, 600.12);
+    tws_srv_put_double(w, 3573);
+    tws_srv_put_double(w, 0);
+    tws_srv_put_str(w, "DU15143");
+}
+
+static void gen_market_depth(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, MARKET_DEPTH);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, i % 10);
+    tws_srv_put_int(w, i % 10);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, i & 1);
+    tws_srv_put_double(w, 100 + (i % 10) * 0.01);
+    tws_srv_put_int(w, 100 + i % 30 * 100);
+}
+
+static void gen_market_depth_l2(tws_srv_buffer_t *w, int i)
+{
+    static const char *const makers[] = { "ISLAND", "ARCA", "NSDQ", "BATS" };
+
+    tws_srv_put_int(w, MARKET_DEPTH_L2);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, i % 10);
+    tws_srv_put_int(w, i % 10);
+    tws_srv_put_str(w, makers[i % 4]);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, i & 1);
+    tws_srv_put_double(w, 100 + (i % 10) * 0.01);
+    tws_srv_put_int(w, 100 + i % 30 * 100);
+}
+
+/* a version 30 limit order as TWS 9.x sends it: no combo legs, algo or scale fields */
+static void gen_open_order(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, OPEN_ORDER);
+    tws_srv_put_int(w, 30);
+    tws_srv_put_int(w, 1000 + i % 100);     /* order id */
+    tws_srv_put_int(w, 15016059);           /* contract */
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "CASH");
+    tws_srv_put_str(w, "");
+    tws_srv_put_double(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "IDEALPRO");
+    tws_srv_put_str(w, "JPY");
+    tws_srv_put_str(w, "USD.JPY");
+    tws_srv_put_str(w, "BUY");              /* order */
+    tws_srv_put_int(w, 25000);
+    tws_srv_put_str(w, "LMT");
+    tws_srv_put_double(w, 82.8);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "GTC");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "DU15143");
+    tws_srv_put_str(w, "O");
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 1);                  /* client id */
+    tws_srv_put_int(w, 121390623 + i % 100);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_double(w, 0);
+    tws_srv_put_str(w, "");                 /* good after time */
+    tws_srv_put_str(w, "");                 /* deprecated shares allocation */
+    tws_srv_put_str(w, "");                 /* FA */
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");                 /* good till date */
+    tws_srv_put_str(w, "");                 /* rule 80A */
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, -1);                 /* exempt code */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 0);                  /* display size */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 3);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 0);                  /* parent id */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");                 /* volatility */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");                 /* delta neutral order type */
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");                 /* trail stop price */
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");                 /* basis points */
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_int(w, 0);                  /* combo legs */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 0);                  /* smart combo routing params */
+    tws_srv_put_str(w, "");                 /* scale */
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");                 /* hedge type */
+    tws_srv_put_int(w, 0);
+    tws_srv_put_str(w, "");                 /* clearing */
+    tws_srv_put_str(w, "IB");
+    tws_srv_put_int(w, 0);                  /* not held */
+    tws_srv_put_int(w, 0);                  /* under comp */
+    tws_srv_put_str(w, "");                 /* algo strategy */
+    tws_srv_put_int(w, 0);                  /* what if */
+    tws_srv_put_str(w, i % 2 ? "Submitted" : "Filled");
+    tws_srv_put_double(w, 12500);          /* what-if margins */
+    tws_srv_put_double(w, 10000);
+    tws_srv_put_double(w, 1012500);
+    tws_srv_put_double(w, 2.5);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "");
+}
+
+static void gen_execution_data(tws_srv_buffer_t *w, int i)
+{
+    char buf[64];
+
+    tws_srv_put_int(w, EXECUTION_DATA);
+    tws_srv_put_int(w, 9);
+    tws_srv_put_int(w, -1);
+    tws_srv_put_int(w, 1000 + i % 100);
+    tws_srv_put_int(w, 265598);
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_str(w, "STK");
+    tws_srv_put_str(w, "");
+    tws_srv_put_double(w, 0);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "SMART");
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "AAPL");
+    sprintf(buf, "0000e0d5.50730f4c.01.%02d", i % 100);
+    tws_srv_put_str(w, buf);
+    tws_srv_put_str(w, "20121008  10:00:01");
+    tws_srv_put_str(w, "DU15143");
+    tws_srv_put_str(w, "ISLAND");
+    tws_srv_put_str(w, "BOT");
+    tws_srv_put_int(w, 100);
+    tws_srv_put_double(w, 635.85);
+    tws_srv_put_int(w, 121390623 + i % 100);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, 0);
+    tws_srv_put_int(w, 100);
+    tws_srv_put_double(w, 635.85);
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "");
+    tws_srv_put_double(w, 0);
+}
+
+static void gen_historical_data(tws_srv_buffer_t *w, int i)
+{
+    char date[32];
+    int j;
+
+    tws_srv_put_int(w, HISTORICAL_DATA);
+    tws_srv_put_int(w, 3);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_str(w, "20121001  09:30:00");
+    tws_srv_put_str(w, "20121008  16:00:00");
+    tws_srv_put_int(w, 2000);
+    for(j = 0; j < 2000; j++) {
+        double p = 630 + (j % 97) * 0.05;
+
+        sprintf(date, "201210%02d  %02d:%02d:00", 1 + j / 390, 9 + (30 + j % 390) / 60, (30 + j % 390) % 60);
+        tws_srv_put_str(w, date);
+        tws_srv_put_double(w, p);
+        tws_srv_put_double(w, p + 0.4);
+        tws_srv_put_double(w, p - 0.35);
+        tws_srv_put_double(w, p + 0.1);
+        tws_srv_put_int(w, 15000 + j % 300 * 10);
+        tws_srv_put_double(w, p + 0.02);
+        tws_srv_put_str(w, "false");
+        tws_srv_put_int(w, 40 + j % 60);
+    }
+}
+
+static void gen_scanner_data(tws_srv_buffer_t *w, int i)
+{
+    char sym[16];
+    int j;
+
+    tws_srv_put_int(w, SCANNER_DATA);
+    tws_srv_put_int(w, 3);
+    tws_srv_put_int(w, 7);
+    tws_srv_put_int(w, 50);
+    for(j = 0; j < 50; j++) {
+        sprintf(sym, "SYM%d", (i + j) % 80);
+        tws_srv_put_int(w, j);
+        tws_srv_put_int(w, 1000 + (i + j) % 80);
+        tws_srv_put_str(w, sym);
+        tws_srv_put_str(w, "STK");
+        tws_srv_put_str(w, "");
+        tws_srv_put_double(w, 0);
+        tws_srv_put_str(w, "");
+        tws_srv_put_str(w, "SMART");
+        tws_srv_put_str(w, "USD");
+        tws_srv_put_str(w, sym);
+        tws_srv_put_str(w, "NMS");
+        tws_srv_put_str(w, sym);
+        tws_srv_put_str(w, "");
+        tws_srv_put_str(w, "");
+        tws_srv_put_str(w, "");
+        tws_srv_put_str(w, "");
+    }
+}
+
+static void gen_realtime_bars(tws_srv_buffer_t *w, int i)
+{
+    double p = 630 + (i % 97) * 0.05;
+
+    tws_srv_put_int(w, REAL_TIME_BARS);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, i % 10);
+    tws_srv_put_int(w, 1349712000 + 5 * i);
+    tws_srv_put_double(w, p);
+    tws_srv_put_double(w, p + 0.1);
+    tws_srv_put_double(w, p - 0.12);
+    tws_srv_put_double(w, p + 0.03);
+    tws_srv_put_int(w, 1200 + i % 40 * 10);
+    tws_srv_put_double(w, p + 0.01);
+    tws_srv_put_int(w, 11 + i % 20);
+}
+
+static void gen_contract_data(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, CONTRACT_DATA);
+    tws_srv_put_int(w, 8);
+    tws_srv_put_int(w, i % 100);
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_str(w, "OPT");
+    tws_srv_put_str(w, "20121020");
+    tws_srv_put_double(w, 600 + i % 40 * 5);
+    tws_srv_put_str(w, i % 2 ? "C" : "P");
+    tws_srv_put_str(w, "SMART");
+    tws_srv_put_str(w, "USD");
+    tws_srv_put_str(w, "AAPL  121020C00600000");
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_str(w, "AAPL");
+    tws_srv_put_int(w, 120000000 + i % 1000);
+    tws_srv_put_double(w, 0.01);
+    tws_srv_put_str(w, "100");
+    tws_srv_put_str(w, "ACTIVETIM,ADJUST,ALERT,ALLOC,AVGCOST,BASKET,COND,CONDORDER,DAY,DEACT,DEACTDIS,DEACTEOD,GAT,GTC,GTD,GTT,"
+               "HID,ICE,IOC,LIT,LMT,MIT,MKT,MTL,NONALGO,OCA,PAON,POSTONLY,RELSTK,SCALE,SCALERST,SMARTSTG,STP,STPLMT,TRAIL,"
+               "TRAILLIT,TRAILLMT,TRAILMIT,VOLAT,WHATIF");
+    tws_srv_put_str(w, "SMART,AMEX,BATS,BOX,CBOE,CBOE2,ISE,MIAX,NASDAQOM,PHLX,PSE,TPLUS1");
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, 265598);
+    tws_srv_put_str(w, "APPLE INC");
+    tws_srv_put_str(w, "");
+    tws_srv_put_str(w, "201210");
+    tws_srv_put_str(w, "Technology");
+    tws_srv_put_str(w, "Computers");
+    tws_srv_put_str(w, "Computers");
+    tws_srv_put_str(w, "EST");
+    tws_srv_put_str(w, "20121008:0930-1600;20121009:0930-1600");
+    tws_srv_put_str(w, "20121008:0930-1600;20121009:0930-1600");
+    tws_srv_put_str(w, "");
+    tws_srv_put_double(w, 0);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_str(w, "ISIN");
+    tws_srv_put_str(w, "US0378331005");
+}
+
+static void gen_news_bulletins(tws_srv_buffer_t *w, int i)
+{
+    tws_srv_put_int(w, NEWS_BULLETINS);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_int(w, 1000 + i);
+    tws_srv_put_int(w, 1);
+    tws_srv_put_str(w, "The exchange has announced a trading halt in the following securities pending the release of news. "
+               "Orders for these securities will be held until trading resumes; open orders remain working. "
+               "Please contact customer service with any questions about the status of your orders.");
+    tws_srv_put_str(w, "NYSE");
+}
+
+typedef struct bench_type {
+    tws_incoming_id_t id;
+    void (*gen)(tws_srv_buffer_t *w, int i);
+    int block;                  /* messages per generated stream; the stream is played in a loop */
+} bench_type_t;
+
+static const bench_type_t bench_types[] = {
+    { TICK_PRICE, gen_tick_price, 4096 },
+    { TICK_SIZE, gen_tick_size, 4096 },
+    { TICK_OPTION_COMPUTATION, gen_tick_option_computation, 4096 },
+    { TICK_GENERIC, gen_tick_generic, 4096 },
+    { TICK_STRING, gen_tick_string, 4096 },
+    { ORDER_STATUS, gen_order_status, 1024 },
+    { ACCT_VALUE, gen_acct_value, 1024 },
+    { PORTFOLIO_VALUE, gen_portfolio_value, 1024 },
+    { MARKET_DEPTH, gen_market_depth, 4096 },
+    { MARKET_DEPTH_L2, gen_market_depth_l2, 4096 },
+    { OPEN_ORDER, gen_open_order, 1024 },
+    { EXECUTION_DATA, gen_execution_data, 1024 },
+    { HISTORICAL_DATA, gen_historical_data, 8 },
+    { SCANNER_DATA, gen_scanner_data, 64 },
+    { REAL_TIME_BARS, gen_realtime_bars, 4096 },
+    { CONTRACT_DATA, gen_contract_data, 1024 },
+    { NEWS_BULLETINS, gen_news_bulletins, 1024 }
+};
+
+/* the in-memory connection: the handshake once, then the stream over and over; whatever is sent is counted and dropped */
+typedef struct bench_conn {
+    const char *hello;
+    size_t hello_len;
+    const tws_srv_buffer_t *stream;
+    size_t pos;
+    int connected;
+    unsigned long long tx_bytes;
+} bench_conn_t;
+
+static int bench_transmit(void *arg, const void *buf, unsigned int buflen)
+{
+    bench_conn_t *c = (bench_conn_t *)arg;
+
+    c->tx_bytes += buflen;
+    return (int)buflen;
+}
+
+static int bench_receive(void *arg, void *buf, unsigned int max_bufsize)
+{
+    bench_conn_t *c = (bench_conn_t *)arg;
+    size_t n;
+
+    if(!c->connected) {
+        c->connected = 1;
+        memcpy(buf, c->hello, c->hello_len);
+        return (int)c->hello_len;
+    }
+    if(!c->stream || !c->stream->len)
+        return 0;
+
+    n = c->stream->len - c->pos;
+    if(n > max_bufsize)
+        n = max_bufsize;
+    memcpy(buf, c->stream->data + c->pos, n);
+    c->pos += n;
+    if(c->pos == c->stream->len)
+        c->pos = 0;
+    return (int)n;
+}
+
+static int bench_flush(void *arg)
+{
+    return 0;
+}
+
+static int bench_open(void *arg)
+{
+    return 0;
+}
+
+static int bench_close(void *arg)
+{
+    return 0;
+}
+
+static unsigned long long bench_clock(void)
+{
+    struct timespec ts;
+
+#ifdef unix
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* an instance connected to 'conn', which plays 'stream' (nothing when NULL) after a handshake from a server version 63 TWS */
+static tws_instance_t *bench_connect(bench_conn_t *conn, const tws_srv_buffer_t *stream)
+{
+    static const char hello[] = "63\0" "20121008 10:00:00 EST";
+    tws_instance_t *ti;
+
+    memset(conn, 0, sizeof *conn);
+    conn->hello = hello;
+    conn->hello_len = sizeof hello;
+    conn->stream = stream;
+
+    ti = tws_create(conn, bench_transmit, bench_receive, bench_flush, bench_open, bench_close, 0, 0);
+    if(ti && tws_connect(ti, 1)) {
+        tws_destroy(ti);
+        ti = NULL;
+    }
+    return ti;
+}
+
+/* print the -l figures of the message type just run */
+static void print_latency(tws_instance_t *ti, tws_incoming_id_t id)
+{
+    static const char *const phases[] = { "decode", "callback", "total", "receive wait" };
+    int ph;
+
+    for(ph = 0; ph < LATENCY_PHASE_COUNT; ph++) {
+        const tr_latency_histogram_t *h = tws_get_latency_stats(ti, id, (tr_latency_phase_t)ph);
+
+        if(h && h->lh_count)
+            printf("    %-20s p50 %6llu  p99 %6llu  p99.9 %7llu  max %8llu ns\n", phases[ph], tws_latency_percentile(h, 50),
+                   tws_latency_percentile(h, 99), tws_latency_percentile(h, 99.9), h->lh_max_ns);
+    }
+}
+
+static int run_type(const bench_type_t *bt, double seconds, int latency)
+{
+    bench_conn_t conn;
+    tws_srv_buffer_t stream;
+    tws_instance_t *ti;
+    unsigned long long messages = 0, allocs, start, elapsed;
+    int i;
+
+    tws_srv_buffer_init(&stream, 0);
+    for(i = 0; i < bt->block; i++)
+        bt->gen(&stream, i);
+    if(stream.error) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ti = bench_connect(&conn, &stream);
+    if(!ti) {
+        fprintf(stderr, "%s: cannot connect\n", tws_incoming_msg_name(bt->id));
+        tws_srv_buffer_free(&stream);
+        return -1;
+    }
+
+    /* warm up caches and the decoder's buffers with one pass over the stream */
+    for(i = 0; i < bt->block; i++)
+        tws_event_process(ti);
+    if(latency)
+        tws_enable_latency_stats(ti, 1);
+
+    allocs = bench_allocs;
+    start = bench_clock();
+    do {
+        for(i = 0; i < bt->block; i++)
+            tws_event_process(ti);
+        messages += bt->block;
+        elapsed = bench_clock() - start;
+    } while(elapsed < seconds * 1e9 && tws_connected(ti));
+    allocs = bench_allocs - allocs;
+
+    if(!tws_connected(ti)) {
+        fprintf(stderr, "%s: the decoder dropped the connection, the generated stream is malformed\n", tws_incoming_msg_name(bt->id));
+        tws_destroy(ti);
+        tws_srv_buffer_free(&stream);
+        return -1;
+    }
+
+    printf("%-24s %10.0f %8.1f %12.0f %8.1f %10.2f\n", tws_incoming_msg_name(bt->id),
+           (double)stream.len / bt->block, (double)elapsed / messages, messages * 1e9 / elapsed,
+           (double)messages * stream.len / bt->block * 1e3 / elapsed, (double)allocs / messages);
+    if(latency)
+        print_latency(ti, bt->id);
+
+    tws_destroy(ti);
+    tws_srv_buffer_free(&stream);
+    return 0;
+}
+
+
+/* encoder side: one request of each kind, built once and sent over and over */
+typedef struct enc_request {
+    tr_contract_t contract;
+    tr_order_t order;
+    tr_comboleg_t legs[2];
+    tr_order_combo_leg_t order_legs[2];
+} enc_request_t;
+
+typedef struct enc_case {
+    const char *name;
+    void (*setup)(tws_instance_t *ti, enc_request_t *rq);
+    int (*call)(tws_instance_t *ti, enc_request_t *rq, int i);
+} enc_case_t;
+
+static tr_tag_value_t *make_tag_values(tws_instance_t *ti, const char *const *pairs, int count)
+{
+    tr_tag_value_t *t = (tr_tag_value_t *)calloc(count, sizeof *t);
+    int j;
+
+    for(j = 0; j < count; j++) {
+        tws_init_tag_value(ti, &t[j]);
+        strcpy(t[j].t_tag, pairs[2 * j]);
+        strcpy(t[j].t_val, pairs[2 * j + 1]);
+    }
+    return t;
+}
+
+static void setup_stock(tws_instance_t *ti, enc_request_t *rq)
+{
+    tws_init_contract(ti, &rq->contract);
+    strcpy(rq->contract.c_symbol, "AAPL");
+    strcpy(rq->contract.c_sectype, "STK");
+    strcpy(rq->contract.c_exchange, "SMART");
+    strcpy(rq->contract.c_primary_exch, "NASDAQ");
+    strcpy(rq->contract.c_currency, "USD");
+    rq->contract.c_conid = 265598;
+
+    tws_init_order(ti, &rq->order);
+    strcpy(rq->order.o_action, "BUY");
+    strcpy(rq->order.o_order_type, "LMT");
+    strcpy(rq->order.o_tif, "DAY");
+    strcpy(rq->order.o_account, "DU15143");
+    rq->order.o_total_quantity = 100;
+    rq->order.o_lmt_price = 635.85;
+}
+
+static void setup_algo(tws_instance_t *ti, enc_request_t *rq)
+{
+    static const char *const params[] = {
+        "maxPctVol", "0.1", "startTime", "09:30:00 EST", "endTime", "16:00:00 EST", "allowPastEndTime", "1", "noTakeLiq", "0"
+    };
+
+    setup_stock(ti, rq);
+    strcpy(rq->order.o_algo_strategy, "Vwap");
+    rq->order.o_algo_params = make_tag_values(ti, params, 5);
+    rq->order.o_algo_params_count = 5;
+}
+
+static void setup_combo(tws_instance_t *ti, enc_request_t *rq)
+{
+    static const char *const params[] = { "NonGuaranteed", "1" };
+    int j;
+
+    setup_stock(ti, rq);
+    strcpy(rq->contract.c_symbol, "AAPL,MSFT");
+    strcpy(rq->contract.c_sectype, "BAG");
+    rq->contract.c_conid = 0;
+    for(j = 0; j < 2; j++) {
+        tws_init_tr_comboleg(ti, &rq->legs[j]);
+        rq->legs[j].co_conid = j ? 272093 : 265598;
+        rq->legs[j].co_ratio = 1;
+        strcpy(rq->legs[j].co_action, j ? "SELL" : "BUY");
+        strcpy(rq->legs[j].co_exchange, "SMART");
+
+        tws_init_order_combo_leg(ti, &rq->order_legs[j]);
+        rq->order_legs[j].cl_price = j ? 28.4 : 635.85;
+    }
+    rq->contract.c_comboleg = rq->legs;
+    rq->contract.c_num_combolegs = 2;
+    rq->order.o_combo_legs = rq->order_legs;
+    rq->order.o_combo_legs_count = 2;
+    rq->order.o_smart_combo_routing_params = make_tag_values(ti, params, 1);
+    rq->order.o_smart_combo_routing_params_count = 1;
+}
+
+static void setup_scale(tws_instance_t *ti, enc_request_t *rq)
+{
+    setup_stock(ti, rq);
+    rq->order.o_total_quantity = 1000;
+    rq->order.o_scale_init_level_size = 200;
+    rq->order.o_scale_subs_level_size = 100;
+    rq->order.o_scale_price_increment = 0.05;
+    rq->order.o_scale_price_adjust_value = 0.01;
+    rq->order.o_scale_price_adjust_interval = 60;
+    rq->order.o_scale_profit_offset = 0.25;
+    rq->order.o_scale_auto_reset = 1;
+    rq->order.o_scale_init_position = 0;
+    rq->order.o_scale_init_fill_qty = 0;
+}
+
+static void teardown(tws_instance_t *ti, enc_request_t *rq)
+{
+    int j;
+
+    for(j = 0; j < rq->contract.c_num_combolegs; j++)
+        tws_destroy_tr_comboleg(ti, &rq->legs[j]);
+    rq->order.o_combo_legs = NULL;
+    tws_destroy_order(ti, &rq->order);
+    tws_destroy_contract(ti, &rq->contract);
+}
+
+static int call_place_order(tws_instance_t *ti, enc_request_t *rq, int i)
+{
+    return tws_place_order(ti, 1000 + i, &rq->contract, &rq->order);
+}
+
+static int call_req_mkt_data(tws_instance_t *ti, enc_request_t *rq, int i)
+{
+    return tws_req_mkt_data(ti, i, &rq->contract, "100,101,104,106,165,221,225,233,236,258", 0);
+}
+
+static int call_req_historical_data(tws_instance_t *ti, enc_request_t *rq, int i)
+{
+    return tws_req_historical_data(ti, i, &rq->contract, "20121008 16:00:00", "1 W", "1 min", "TRADES", 1, 1);
+}
+
+static int call_cancel_order(tws_instance_t *ti, enc_request_t *rq, int i)
+{
+    return tws_cancel_order(ti, 1000 + i);
+}
+
+static const enc_case_t enc_cases[] = {
+    { "place_order", setup_stock, call_place_order },
+    { "place_order_algo", setup_algo, call_place_order },
+    { "place_order_combo", setup_combo, call_place_order },
+    { "place_order_scale", setup_scale, call_place_order },
+    { "req_mkt_data", setup_stock, call_req_mkt_data },
+    { "req_mkt_data_bag", setup_combo, call_req_mkt_data },
+    { "req_historical_data", setup_stock, call_req_historical_data },
+    { "cancel_order", setup_stock, call_cancel_order }
+};
+
+#define ENC_MAX_SAMPLES (1 << 21)
+
+static int compare_samples(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* run one case for 'seconds' or ENC_MAX_SAMPLES calls and report the latency distribution of a single call */
+static int run_encoder(const enc_case_t *ec, double seconds, unsigned int *samples)
+{
+    bench_conn_t conn;
+    enc_request_t rq;
+    tws_instance_t *ti;
+    unsigned long long allocs, start, now, total = 0;
+    unsigned int n;
+    int err = 0;
+
+    ti = bench_connect(&conn, NULL);
+    if(!ti) {
+        fprintf(stderr, "%s: cannot connect\n", ec->name);
+        return -1;
+    }
+    memset(&rq, 0, sizeof rq);
+    ec->setup(ti, &rq);
+
+    for(n = 0; n < 1000 && !err; n++)
+        err = ec->call(ti, &rq, (int)n);
+
+    conn.tx_bytes = 0;
+    allocs = bench_allocs;
+    start = bench_clock();
+    for(n = 0, now = start; n < ENC_MAX_SAMPLES && !err && now - start < seconds * 1e9; n++) {
+        unsigned long long t = now;
+
+        err = ec->call(ti, &rq, (int)n);
+        now = bench_clock();
+        samples[n] = (unsigned int)(now - t);
+        total += now - t;
+    }
+    allocs = bench_allocs - allocs;
+
+    if(err) {
+        fprintf(stderr, "%s: request failed with error %d\n", ec->name, err);
+    } else {
+        qsort(samples, n, sizeof *samples, compare_samples);
+        printf("%-24s %9.0f %8.1f %7u %7u %7u %7u %7u %10.2f\n", ec->name,
+               (double)conn.tx_bytes / n, (double)total / n, samples[n / 2], samples[n * 9ULL / 10],
+               samples[n * 99ULL / 100], samples[n * 999ULL / 1000], samples[n - 1], (double)allocs / n);
+    }
+
+    teardown(ti, &rq);
+    tws_destroy(ti);
+    return err ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *only = NULL;
+    double seconds = 1.0;
+    unsigned int *samples, j;
+    unsigned long long t0, t1;
+    int i, decode = 1, encode = 1, latency = 0, err = 0;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "-t") && i + 1 < argc) {
+            only = argv[++i];
+        } else if(!strcmp(argv[i], "-d")) {
+            encode = 0;
+        } else if(!strcmp(argv[i], "-e")) {
+            decode = 0;
+        } else if(!strcmp(argv[i], "-l")) {
+            latency = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-d|-e] [-l] [-s <seconds per type>] [-t <message or request name>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(decode) {
+        printf("%-24s %10s %8s %12s %8s %10s\n", "message", "bytes/msg", "ns/msg", "msgs/s", "MB/s", "allocs/msg");
+        for(j = 0; j < sizeof bench_types / sizeof bench_types[0]; j++) {
+            if(only && strcasecmp(only, tws_incoming_msg_name(bench_types[j].id)))
+                continue;
+            err |= run_type(&bench_types[j], seconds, latency);
+        }
+    }
+
+    if(encode) {
+        samples = (unsigned int *)malloc(ENC_MAX_SAMPLES * sizeof *samples);
+        if(!samples) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        /* every sample includes one clock read */
+        t0 = bench_clock();
+        for(j = 0; j < 1000; j++)
+            t1 = bench_clock();
+        printf("%s%-24s %9s %8s %7s %7s %7s %7s %7s %10s   (ns per call, clock read %.0f ns included)\n", decode ? "\n" : "",
+               "request", "bytes/req", "mean", "p50", "p90", "p99", "p99.9", "max", "allocs/req", (double)(t1 - t0) / 1000);
+        for(j = 0; j < sizeof enc_cases / sizeof enc_cases[0]; j++) {
+            if(only && strcasecmp(only, enc_cases[j].name))
+                continue;
+            err |= run_encoder(&enc_cases[j], seconds, samples);
+        }
+        free(samples);
+    }
+
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #define TWS_DEBUG
 #include "twsapi.h"
 #include "twsapi-debug.h"
+#include "twsapi-replay.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -10,6 +11,13 @@
 #include <time.h>
 #include <ctype.h>
 
+#ifdef unix
+#include <pthread.h>
+#else
+#include <windows.h>
+#include <process.h>
+#endif
+
 
 #if defined(_MSC_VER)
 #pragma warning(disable: 4100)
@@ -20,6 +28,7 @@ typedef struct tws_client_custom_data
 {
 	FILE *inf;
 	FILE *outf;
+	tws_replay_t *replay;
 } tws_client_custom_data_t;
 
 
@@ -38,6 +47,12 @@ char *strend(char *s)
 
 int tws_transmit_func(void *arg, const void *buf, unsigned int buflen)
 {
+	tws_client_custom_data_t *cd = (tws_client_custom_data_t *)arg;
+
+	/* replays may run in several threads: keep them off the shared state machine */
+	if (cd->replay)
+		return buflen;
+
 	/* message is flushed/written to output, fake the server as a very simple state machine */
 	tws_tx_mode++;
 
@@ -50,6 +65,12 @@ int tws_receive_func(void *arg, void *buf_, unsigned int max_bufsize)
 	char *buf = (char *)buf_;
 	unsigned int len = 0;
 
+	if (cd->replay)
+	{
+		/* binary capture: the replay engine takes care of the handshake as well */
+		return tws_replay_receive(cd->replay, buf_, max_bufsize);
+	}
+
 	switch (tws_tx_mode)
 	{
 	case 3:
@@ -209,9 +230,13 @@ int tws_receive_func(void *arg, void *buf_, unsigned int max_bufsize)
 /* 'flush()' marks the end of the outgoing message: it should be transmitted ASAP */
 int tws_flush_func(void *arg)
 {
+	tws_client_custom_data_t *cd = (tws_client_custom_data_t *)arg;
 	time_t now = time(NULL);
 	char *dst;
 
+	if (cd->replay)
+		return 0;
+
 	switch (tws_tx_mode)
 	{
 	case 2:
@@ -238,6 +263,10 @@ int tws_flush_func(void *arg)
 /* open callback is invoked when tws_connect is invoked and no connection has been established yet (tws_connected() == false); return 0 on success; a twsclient_error_codes error code on failure. */
 int tws_open_func(void *arg)
 {
+	tws_client_custom_data_t *cd = (tws_client_custom_data_t *)arg;
+
+	if (cd->replay)
+		return 0;
 	tws_tx_mode = 1;
 	return 0;
 }
@@ -279,6 +308,119 @@ void tws_debug_printf(void *opaque, const char *msg, ...)
 
 
 
+/* one segment of a capture decoded in parallel (-j) */
+typedef struct replay_worker
+{
+	tws_client_custom_data_t cd;    /* outf is a temporary file, copied to the real output once all workers are done */
+	unsigned long long begin, end;
+	int rv;
+#ifdef unix
+	pthread_t thread;
+#else
+	HANDLE thread;
+#endif
+} replay_worker_t;
+
+#ifdef unix
+static void *replay_worker_main(void *arg)
+#else
+static unsigned __stdcall replay_worker_main(void *arg)
+#endif
+{
+	replay_worker_t *w = (replay_worker_t *)arg;
+	tws_instance_t *ti = tws_create(&w->cd, tws_transmit_func, tws_receive_func, tws_flush_func, tws_open_func, tws_close_func, 0, 0);
+
+	if (!ti)
+	{
+		w->rv = -1;
+		return 0;
+	}
+	tws_replay_set_range(w->cd.replay, w->begin, w->end);
+	w->rv = tws_replay_run(w->cd.replay, ti, 666 /* client_id */);
+	tws_destroy(ti);
+	return 0;
+}
+
+/*
+split the capture at its index into one segment per job and decode the segments side by side, one tws instance per thread.
+The output of each segment is collected in a temporary file and written out in segment order, i.e. in capture order.
+*/
+int replay_parallel(const char *capture_path, double speed, int jobs, FILE *outf)
+{
+	tws_capture_t *cap;
+	unsigned long long *offsets;
+	replay_worker_t *workers;
+	int segments, i, started, rv = 0;
+	char buf[65536];
+	size_t n;
+
+	cap = tws_capture_open(capture_path);
+	if (!cap)
+	{
+		fprintf(stderr, "ERROR: Cannot open capture file [%s].\n", capture_path);
+		return -1;
+	}
+	offsets = (unsigned long long *)malloc((jobs + 1) * sizeof(*offsets));
+	workers = (replay_worker_t *)calloc(jobs, sizeof(*workers));
+	segments = offsets && workers ? tws_capture_split(cap, jobs, offsets) : 0;
+	tws_capture_close(cap);
+
+	for (started = 0; started < segments; started++)
+	{
+		replay_worker_t *w = &workers[started];
+
+		w->cd.outf = tmpfile();
+		w->cd.replay = tws_replay_open(capture_path, speed);
+		w->begin = offsets[started];
+		w->end = offsets[started + 1];
+		if (!w->cd.outf || !w->cd.replay)
+			break;
+#ifdef unix
+		if (pthread_create(&w->thread, NULL, replay_worker_main, w))
+			break;
+#else
+		w->thread = (HANDLE)_beginthreadex(NULL, 0, replay_worker_main, w, 0, NULL);
+		if (!w->thread)
+			break;
+#endif
+	}
+	if (started < segments)
+	{
+		fprintf(stderr, "ERROR: Cannot start decoder thread %d.\n", started);
+		rv = -1;
+	}
+
+	for (i = 0; i < segments; i++)
+	{
+		replay_worker_t *w = &workers[i];
+
+		if (i < started)
+		{
+#ifdef unix
+			pthread_join(w->thread, NULL);
+#else
+			WaitForSingleObject(w->thread, INFINITE);
+			CloseHandle(w->thread);
+#endif
+			if (w->rv && !rv)
+				rv = w->rv;
+			if (!rv)
+			{
+				rewind(w->cd.outf);
+				while ((n = fread(buf, 1, sizeof(buf), w->cd.outf)) > 0)
+					fwrite(buf, 1, n, outf);
+			}
+		}
+		if (w->cd.outf)
+			fclose(w->cd.outf);
+		tws_replay_close(w->cd.replay);
+	}
+
+	free(offsets);
+	free(workers);
+	return rv;
+}
+
 const char *get_fpath_argval(const char *opt_arg, int *opt_idx_ref, int argc, char **argv)
 {
 	if (opt_arg && *opt_arg)
@@ -313,6 +455,9 @@ int main(int argc, char *argv[])
 	};
 	int i;
 	int rv;
+	const char *capture_path = NULL;
+	double speed = 0;
+	int jobs = 1;
 
     if(argc < 2) 
 	{
@@ -324,6 +469,12 @@ usage:
 			"Options:\n"
 			"  -d            decode TWS/IB message traffic from stdin.\n"
 			"  -i <infile>   load message(s) from file <infile> instead of stdin.\n"
+			"  -r <capfile>  replay the binary capture <capfile> (as written by\n"
+			"                tws_start_capture()) instead of reading a text dump.\n"
+			"  -s <speed>    replay speed: 0 = as fast as possible (default),\n"
+			"                1 = real time, N = N times real time.\n"
+			"  -j <jobs>     decode the capture (-r) in <jobs> parallel segments;\n"
+			"                the output keeps the capture's message order.\n"
 			"  -o <outfile>  write human readable output to file <outfile>\n"
 			"                instead of stdout.\n"
 			"  -q            do NOT print any 'debug' messages originating from the\n"
@@ -353,6 +504,36 @@ usage:
 			}
 			continue;
 		}
+		if (0 == strncmp("-r", a, 2))
+		{
+			capture_path = get_fpath_argval(a + 2, &i, argc, argv);
+			if (!capture_path)
+			{
+				fprintf(stderr, "ERROR: -r requires a capture file.\n");
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+		if (0 == strncmp("-s", a, 2))
+		{
+			const char *val = get_fpath_argval(a + 2, &i, argc, argv);
+			if (!val || (speed = atof(val)) < 0)
+			{
+				fprintf(stderr, "ERROR: -s requires a speed >= 0.\n");
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+		if (0 == strncmp("-j", a, 2))
+		{
+			const char *val = get_fpath_argval(a + 2, &i, argc, argv);
+			if (!val || (jobs = atoi(val)) < 1)
+			{
+				fprintf(stderr, "ERROR: -j requires a number of jobs >= 1.\n");
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
 		if (0 == strncmp("-o", a, 2))
 		{
 			const char *fpath = get_fpath_argval(a + 2, &i, argc, argv);
@@ -387,19 +568,44 @@ usage:
 		return EXIT_FAILURE;
 	}
 
+	if (capture_path && jobs > 1)
+	{
+		rv = replay_parallel(capture_path, speed, jobs, cd.outf);
+		if (cd.outf != stdout && cd.outf != NULL) fclose(cd.outf);
+		return (rv ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	if (capture_path)
+	{
+		cd.replay = tws_replay_open(capture_path, speed);
+		if (!cd.replay)
+		{
+			fprintf(stderr, "ERROR: Cannot open capture file [%s].\n", capture_path);
+			return EXIT_FAILURE;
+		}
+	}
+
 	ti = tws_create(&cd, tws_transmit_func, tws_receive_func, tws_flush_func, tws_open_func, tws_close_func, 0, 0);
     if (!ti) 
 	{
         fprintf(stderr, "ERROR: failed to initialize the TWS API lib.\n"); 
 		return EXIT_FAILURE;
     }
-	rv = tws_connect(ti, 666 /* client_id */);
-
-	if (!rv)
+	if (cd.replay)
 	{
-	    while(!feof(cd.inf) && 0 == tws_event_process(ti));
+		rv = tws_replay_run(cd.replay, ti, 666 /* client_id */);
+	}
+	else
+	{
+		rv = tws_connect(ti, 666 /* client_id */);
+
+		if (!rv)
+		{
+			while(!feof(cd.inf) && 0 == tws_event_process(ti));
+		}
 	}
 	tws_destroy(ti);
+	tws_replay_close(cd.replay);
 
 	if (cd.inf != stdin && cd.inf != NULL) fclose(cd.inf);
 	if (cd.outf != stdout && cd.outf != NULL) fclose(cd.outf);
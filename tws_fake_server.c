@@ -0,0 +1,1068 @@
+/*
+Fake TWS for load and soak testing (unix).
+
+Listens on the loopback interface and speaks the server side of the TWS protocol: it answers the handshake, claiming
+server version MIN_SERVER_VER_TRAILING_PERCENT + 1, and then streams incoming messages to every connected client at a
+configurable rate and burst shape. At the same time it reads the client's requests and acknowledges them:
+
+    req_ids                     next_valid_id
+    req_current_time            current_time
+    place_order                 order_status "Submitted"
+    cancel_order                order_status "Cancelled"
+    req_mkt_data                subscribes the ticker id: the synthetic ticks go to the subscribed ids from then on
+                                (0..99 while there are none); a snapshot request gets a bid, an ask and tick_snapshot_end
+    cancel_mkt_data             unsubscribes
+    req_historical_data         historical_data, 100 daily bars
+    req_open_orders, req_all_open_orders, req_account_data, req_executions, req_contract_data, req_managed_accts
+                                the matching *_end or managed_accts message
+
+All other requests the library can send are read and ignored. Requests are not length prefixed, so the server has to know
+the layout of each of them at the advertised server version; a request it does not know gets an err_msg and the
+connection is closed, as the rest of its input cannot be interpreted.
+
+The stream is either synthetic (-t), generated per client so that it follows the client's subscriptions, or a script
+(-s): a text file with one message per line, its fields separated by whitespace and quoted with ' or " where they
+contain whitespace or are empty (the syntax tws_decode_msg_util reads; lines starting with # are comments), or a binary
+capture (see tws_start_capture()), of which the received messages are played. Without -t and -s the server only answers
+requests. Build e.g. with:
+
+    cc -O2 -o tws_fake_server tws_fake_server.c twsapi-capture.c twsapi-srv-encode.c
+
+Usage: tws_fake_server [-p <port>] [-t <message name>|mix] [-s <script or capture>] [-l] [-r <messages/s>] [-b <burst>]
+                       [-w <on ms>:<off ms>] [-n <messages>] [-q]
+
+    -p        port to listen on, default 7496
+    -t        synthetic stream: tick_price, tick_size, tick_string, tick_option_computation, market_depth,
+              market_depth_l2, realtime_bars or mix (ticks as a busy market data feed sends them)
+    -s, -l    play a script or capture, once or (-l) in a loop
+    -r        messages per second and client; 0, the default, sends as fast as the client reads
+    -b        messages sent back to back; at a rate, bursts are spread out so that the average rate holds
+    -w        on/off pattern: send for <on ms>, then pause for <off ms>, and so on
+    -n        close the connection after that many stream messages
+    -q        no statistics; otherwise one line per second and one per closed connection
+
+The schedule is kept with the resolution of poll(), 1 ms: at higher rates messages go out in clumps per millisecond.
+*/
+
+#include "twsapi.h"
+#include "twsapi-capture.h"
+#include "twsapi-srv-encode.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+
+#define MAX_CLIENTS             64
+#define PATTERN_MESSAGES        1024            /* synthetic messages generated ahead, played in a loop */
+#define OUT_HIGH_WATER          (256 * 1024)    /* stop producing while this much output is pending */
+#define MAX_RECORDED_FIELDS     32
+#define HISTORICAL_BARS         100
+
+/* messages back to back; message i spans data[offsets[i]] .. data[offsets[i + 1]] */
+typedef struct stream {
+    tws_srv_buffer_t wire;
+    size_t *offsets;
+    unsigned int count, size;
+} stream_t;
+
+typedef void (*gen_func_t)(tws_srv_buffer_t *b, int i, int ticker_id);
+
+typedef enum client_state {
+    CL_HELLO, CL_CLIENT_ID, CL_RUNNING, CL_CLOSING
+} client_state_t;
+
+typedef struct client {
+    int fd;
+    client_state_t state;
+    tws_srv_buffer_t in;
+    tws_srv_buffer_t out;
+    size_t out_sent;                    /* bytes of 'out' written to the socket */
+    int *subs;                          /* market data subscriptions */
+    int sub_count, sub_size;
+    stream_t pattern;                   /* synthetic stream, following the subscriptions */
+    int pattern_dirty;
+    unsigned int next;                  /* next message of the stream */
+    unsigned long long start_ns;        /* when the stream started */
+    unsigned long long messages, bytes, requests;
+    int next_order_id;
+} client_t;
+
+typedef struct server {
+    int listen_fd;
+    client_t *clients[MAX_CLIENTS];
+    int client_count;
+    gen_func_t gen;
+    stream_t script;
+    int have_script, loop;
+    double rate;
+    unsigned int burst;
+    unsigned long long on_ns, off_ns;
+    unsigned long long max_messages;
+    int quiet;
+    unsigned long long messages, bytes, requests;   /* since the last statistics line */
+} server_t;
+
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* encoder output that could not be stored */
+static void check(const tws_srv_buffer_t *b)
+{
+    if(b->error) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* room for 'n' more bytes, for recv() */
+static void reserve(tws_srv_buffer_t *b, size_t n)
+{
+    if(b->len + n <= b->size)
+        return;
+
+    b->size = b->size ? 2 * b->size : 65536;
+    while(b->size < b->len + n)
+        b->size *= 2;
+    b->data = (char *)realloc(b->data, b->size);
+    if(!b->data) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void put_bytes(tws_srv_buffer_t *b, const void *p, size_t n)
+{
+    tws_srv_put_bytes(b, p, n);
+    check(b);
+}
+
+static void stream_mark(stream_t *s)
+{
+    check(&s->wire);
+    if(s->count + 1 >= s->size) {
+        s->size = s->size ? 2 * s->size : 1024;
+        s->offsets = (size_t *)realloc(s->offsets, s->size * sizeof *s->offsets);
+        if(!s->offsets) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(s->count == 0)
+        s->offsets[0] = 0;
+    s->offsets[++s->count] = s->wire.len;
+}
+
+static void stream_clear(stream_t *s)
+{
+    tws_srv_buffer_reset(&s->wire);
+    s->count = 0;
+}
+
+static void stream_free(stream_t *s)
+{
+    tws_srv_buffer_free(&s->wire);
+    free(s->offsets);
+    memset(s, 0, sizeof *s);
+}
+
+/* synthetic messages: 'i' varies prices and sizes from message to message */
+
+static void gen_tick_price(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    static const tr_tick_type_t types[] = { BID, ASK, LAST };
+
+    tws_srv_encode_tick_price(b, 6, ticker_id, types[i % 3], 100 + (i % 1000) * 0.01, 100 + i % 7 * 100, 1);
+}
+
+static void gen_tick_size(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    static const tr_tick_type_t types[] = { BID_SIZE, ASK_SIZE, VOLUME };
+
+    tws_srv_encode_tick_size(b, 6, ticker_id, types[i % 3], 100 + i % 50 * 100);
+}
+
+static void gen_tick_string(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    char buf[16];
+
+    sprintf(buf, "%d", 1349712000 + i);
+    tws_srv_encode_tick_string(b, 6, ticker_id, LAST_TIMESTAMP, buf);
+}
+
+static void gen_tick_option_computation(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    tws_srv_encode_tick_option_computation(b, 6, ticker_id, (tr_tick_type_t)(BID_OPTION + i % 4),
+                                           0.2 + (i % 100) * 0.001, 0.55 - (i % 100) * 0.001, 2.35 + (i % 100) * 0.01,
+                                           0.12, 0.0473, 0.1134, -0.0217, 101.25 + (i % 100) * 0.01);
+}
+
+static void gen_market_depth(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    tws_srv_encode_market_depth(b, 1, ticker_id, i % 10, 1, i & 1, 100 + (i % 10) * 0.01, 100 + i % 30 * 100);
+}
+
+static void gen_market_depth_l2(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    static const char *const makers[] = { "ISLAND", "ARCA", "NSDQ", "BATS" };
+
+    tws_srv_encode_market_depth_l2(b, 1, ticker_id, i % 10, makers[i % 4], 1, i & 1, 100 + (i % 10) * 0.01, 100 + i % 30 * 100);
+}
+
+static void gen_realtime_bars(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    double p = 630 + (i % 97) * 0.05;
+
+    tws_srv_encode_realtime_bars(b, 1, ticker_id, 1349712000 + 5 * i, p, p + 0.1, p - 0.12, p + 0.03, 1200 + i % 40 * 10,
+                                 p + 0.01, 11 + i % 20);
+}
+
+/* about the shares of a busy market data feed: prices and sizes, some timestamps, a few option computations */
+static void gen_mix(tws_srv_buffer_t *b, int i, int ticker_id)
+{
+    int k = i % 20;
+
+    if(k < 9)
+        gen_tick_price(b, i, ticker_id);
+    else if(k < 17)
+        gen_tick_size(b, i, ticker_id);
+    else if(k < 19)
+        gen_tick_string(b, i, ticker_id);
+    else
+        gen_tick_option_computation(b, i, ticker_id);
+}
+
+static const struct {
+    const char *name;
+    gen_func_t gen;
+} synthetic_types[] = {
+    { "tick_price", gen_tick_price },
+    { "tick_size", gen_tick_size },
+    { "tick_string", gen_tick_string },
+    { "tick_option_computation", gen_tick_option_computation },
+    { "market_depth", gen_market_depth },
+    { "market_depth_l2", gen_market_depth_l2 },
+    { "realtime_bars", gen_realtime_bars },
+    { "mix", gen_mix }
+};
+
+static void build_pattern(server_t *srv, client_t *c)
+{
+    int i;
+
+    stream_clear(&c->pattern);
+    for(i = 0; i < PATTERN_MESSAGES; i++) {
+        srv->gen(&c->pattern.wire, i, c->sub_count ? c->subs[i % c->sub_count] : i % 100);
+        stream_mark(&c->pattern);
+    }
+    c->pattern_dirty = 0;
+}
+
+/* the syntax of tws_decode_msg_util: whitespace separated fields, quoted with ' or " where needed, # comment lines */
+static int load_script(stream_t *s, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[65536];
+    int lineno = 0;
+
+    if(!f) {
+        perror(path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof line, f)) {
+        char *p = line;
+        int fields = 0;
+
+        lineno++;
+        for(;;) {
+            while(*p && isspace((unsigned char)*p))
+                p++;
+            if(!*p || (*p == '#' && fields == 0))
+                break;
+
+            if(*p == '"' || *p == '\'') {
+                char quote = *p++, *dst = p, *start = p;
+
+                while(*p && *p != quote) {
+                    if(*p == '\\' && p[1] == quote)
+                        p++;
+                    *dst++ = *p++;
+                }
+                if(*p != quote) {
+                    fprintf(stderr, "%s:%d: unterminated quote\n", path, lineno);
+                    fclose(f);
+                    return -1;
+                }
+                p++;
+                put_bytes(&s->wire, start, (size_t)(dst - start));
+            } else {
+                char *start = p;
+
+                while(*p && !isspace((unsigned char)*p))
+                    p++;
+                put_bytes(&s->wire, start, (size_t)(p - start));
+            }
+            put_bytes(&s->wire, "", 1);
+            fields++;
+        }
+        if(fields)
+            stream_mark(s);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* the received messages of a capture, handshakes and messages cut off by a dropped connection left out */
+static int load_capture(stream_t *s, tws_capture_t *cap)
+{
+    unsigned long long off = 0;
+    tws_capture_record_t rec;
+    const unsigned char *payload;
+    int err;
+
+    while((err = tws_capture_read(cap, &off, &rec, &payload)) == 0) {
+        if(rec.r_direction != TWS_CAPTURE_RX || (rec.r_flags & (TWS_CAPTURE_HANDSHAKE | TWS_CAPTURE_INCOMPLETE)))
+            continue;
+        put_bytes(&s->wire, payload, rec.r_length);
+        stream_mark(s);
+    }
+    return err < 0 ? -1 : 0;
+}
+
+/* request parsing: a cursor over the received bytes which runs out (returns NULL or -1) when a request is incomplete */
+
+typedef struct fields {
+    const char *pos, *end;
+    const char *field[MAX_RECORDED_FIELDS];     /* the first fields of the request, id and version included */
+    const char *last;
+    int count;
+} fields_t;
+
+static const char *next_field(fields_t *f)
+{
+    const char *s = f->pos;
+    const char *nul = (const char *)memchr(s, 0, (size_t)(f->end - s));
+
+    if(!nul)
+        return NULL;
+    f->pos = nul + 1;
+    if(f->count < MAX_RECORDED_FIELDS)
+        f->field[f->count] = s;
+    f->count++;
+    f->last = s;
+    return s;
+}
+
+static int skip_fields(fields_t *f, int n)
+{
+    while(n-- > 0)
+        if(!next_field(f))
+            return -1;
+    return 0;
+}
+
+/* a count followed by that many groups of 'per_item' fields */
+static int skip_list(fields_t *f, int per_item)
+{
+    const char *s = next_field(f);
+
+    return s ? skip_fields(f, atoi(s) * per_item) : -1;
+}
+
+static int field_int(const fields_t *f, int k)
+{
+    return k < f->count && k < MAX_RECORDED_FIELDS ? atoi(f->field[k]) : 0;
+}
+
+/* the layouts of tws_place_order() etc. at server version MIN_SERVER_VER_TRAILING_PERCENT + 1, after id and version */
+
+static int parse_place_order(fields_t *f)
+{
+    const char *s;
+    int bag;
+
+    /* order id, contract id, symbol, security type */
+    if(skip_fields(f, 3) || !(s = next_field(f)))
+        return -1;
+    bag = !strcasecmp(s, "BAG");
+
+    /* the rest of the contract, then the order up to o_hidden */
+    if(skip_fields(f, 10 + 19))
+        return -1;
+    if(bag && (skip_list(f, 8) || skip_list(f, 1) || skip_list(f, 2)))
+        return -1;
+
+    /* shares allocation .. o_override_percentage_constraints, volatility, its type, the delta neutral order type */
+    if(skip_fields(f, 27 + 2) || !(s = next_field(f)))
+        return -1;
+    if(skip_fields(f, *s ? 5 : 1))
+        return -1;
+
+    /* continuous update .. o_scale_subs_level_size, then the scale price increment */
+    if(skip_fields(f, 6) || !(s = next_field(f)))
+        return -1;
+    if(*s && atof(s) > 0 && skip_fields(f, 7))
+        return -1;
+
+    if(!(s = next_field(f)) || (*s && skip_fields(f, 1)))          /* hedge type and param */
+        return -1;
+    if(skip_fields(f, 4) || !(s = next_field(f)))                   /* .. o_not_held, undercomp flag */
+        return -1;
+    if(atoi(s) && skip_fields(f, 3))
+        return -1;
+    if(!(s = next_field(f)) || (*s && skip_list(f, 2)))             /* algo strategy and params */
+        return -1;
+    return skip_fields(f, 1);                                       /* what-if */
+}
+
+static int parse_req_mkt_data(fields_t *f)
+{
+    const char *s;
+
+    /* ticker id, contract id, symbol, security type */
+    if(skip_fields(f, 3) || !(s = next_field(f)))
+        return -1;
+    if(skip_fields(f, 8) || (!strcasecmp(s, "BAG") && skip_list(f, 4)) || !(s = next_field(f)))
+        return -1;
+    if(atoi(s) && skip_fields(f, 3))
+        return -1;
+    return skip_fields(f, 2);                                       /* generic tick list, snapshot */
+}
+
+static int parse_req_historical_data(fields_t *f)
+{
+    const char *s;
+
+    /* ticker id, symbol, security type */
+    if(skip_fields(f, 2) || !(s = next_field(f)))
+        return -1;
+    if(skip_fields(f, 8 + 7) || (!strcasecmp(s, "BAG") && skip_list(f, 4)))
+        return -1;
+    return 0;
+}
+
+/* replies */
+
+static void reply_next_valid_id(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_next_valid_id(&c->out, 1, c->next_order_id);
+}
+
+static void reply_managed_accts(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_managed_accts(&c->out, 1, "DU0000000");
+}
+
+static void reply_current_time(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_current_time(&c->out, 1, (long)time(NULL));
+}
+
+static void put_order_status(client_t *c, int order_id, const char *status, int remaining)
+{
+    tws_srv_encode_order_status(&c->out, 6, order_id, status, 0, remaining, 0, 1000000 + order_id, 0, 0, 0, "");
+}
+
+static void reply_place_order(server_t *srv, client_t *c, fields_t *f)
+{
+    int order_id = field_int(f, 2);
+
+    if(order_id >= c->next_order_id)
+        c->next_order_id = order_id + 1;
+    /* id, version, order id, 13 contract fields, action, quantity */
+    put_order_status(c, order_id, "Submitted", field_int(f, 17));
+}
+
+static void reply_cancel_order(server_t *srv, client_t *c, fields_t *f)
+{
+    put_order_status(c, field_int(f, 2), "Cancelled", 0);
+}
+
+static void reply_req_mkt_data(server_t *srv, client_t *c, fields_t *f)
+{
+    int ticker_id = field_int(f, 2), j;
+
+    /* the last field is the snapshot flag */
+    if(atoi(f->last)) {
+        tws_srv_encode_tick_price(&c->out, 6, ticker_id, BID, 99.99, 100, 1);
+        tws_srv_encode_tick_price(&c->out, 6, ticker_id, ASK, 100.01, 100, 1);
+        tws_srv_encode_tick_snapshot_end(&c->out, 1, ticker_id);
+        return;
+    }
+
+    for(j = 0; j < c->sub_count; j++)
+        if(c->subs[j] == ticker_id)
+            return;
+    if(c->sub_count == c->sub_size) {
+        c->sub_size = c->sub_size ? 2 * c->sub_size : 16;
+        c->subs = (int *)realloc(c->subs, c->sub_size * sizeof *c->subs);
+        if(!c->subs) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    c->subs[c->sub_count++] = ticker_id;
+    c->pattern_dirty = 1;
+}
+
+static void reply_cancel_mkt_data(server_t *srv, client_t *c, fields_t *f)
+{
+    int ticker_id = field_int(f, 2), j;
+
+    for(j = 0; j < c->sub_count; j++) {
+        if(c->subs[j] == ticker_id) {
+            c->subs[j] = c->subs[--c->sub_count];
+            c->pattern_dirty = 1;
+            break;
+        }
+    }
+}
+
+static void reply_req_historical_data(server_t *srv, client_t *c, fields_t *f)
+{
+    time_t t = 1349712000;
+    char date[16];
+    int j;
+
+    tws_srv_encode_historical_data(&c->out, 3, field_int(f, 2), "20120508  00:00:00", "20121008  00:00:00", HISTORICAL_BARS);
+    for(j = 0; j < HISTORICAL_BARS; j++) {
+        double p = 600 + (j % 37) * 0.75;
+
+        strftime(date, sizeof date, "%Y%m%d", gmtime(&t));
+        t += 86400;
+        tws_srv_encode_historical_bar(&c->out, 3, date, p, p + 4.5, p - 3.25, p + 1.5, 150000 + j * 100, 9000 + j, p + 0.5, 0);
+    }
+}
+
+static void reply_open_order_end(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_open_order_end(&c->out, 1);
+}
+
+static void reply_req_account_data(server_t *srv, client_t *c, fields_t *f)
+{
+    /* subscribe flag, account code */
+    if(!field_int(f, 2))
+        return;
+    tws_srv_encode_acct_download_end(&c->out, 1, f->field[3]);
+}
+
+static void reply_req_executions(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_execution_data_end(&c->out, 1, field_int(f, 2));
+}
+
+static void reply_req_contract_data(server_t *srv, client_t *c, fields_t *f)
+{
+    tws_srv_encode_contract_data_end(&c->out, 1, field_int(f, 2));
+}
+
+typedef struct request_type {
+    tws_outgoing_id_t id;
+    int fields;                                 /* after id and version, when 'parse' is NULL */
+    int (*parse)(fields_t *f);
+    void (*reply)(server_t *srv, client_t *c, fields_t *f);
+} request_type_t;
+
+static const request_type_t request_types[] = {
+    { REQ_MKT_DATA, 0, parse_req_mkt_data, reply_req_mkt_data },
+    { CANCEL_MKT_DATA, 1, NULL, reply_cancel_mkt_data },
+    { PLACE_ORDER, 0, parse_place_order, reply_place_order },
+    { CANCEL_ORDER, 1, NULL, reply_cancel_order },
+    { REQ_OPEN_ORDERS, 0, NULL, reply_open_order_end },
+    { REQ_ACCOUNT_DATA, 2, NULL, reply_req_account_data },
+    { REQ_EXECUTIONS, 8, NULL, reply_req_executions },
+    { REQ_IDS, 1, NULL, reply_next_valid_id },
+    { REQ_CONTRACT_DATA, 14, NULL, reply_req_contract_data },
+    { REQ_MKT_DEPTH, 11, NULL, NULL },
+    { CANCEL_MKT_DEPTH, 1, NULL, NULL },
+    { REQ_NEWS_BULLETINS, 1, NULL, NULL },
+    { CANCEL_NEWS_BULLETINS, 0, NULL, NULL },
+    { SET_SERVER_LOGLEVEL, 1, NULL, NULL },
+    { REQ_AUTO_OPEN_ORDERS, 1, NULL, NULL },
+    { REQ_ALL_OPEN_ORDERS, 0, NULL, reply_open_order_end },
+    { REQ_MANAGED_ACCTS, 0, NULL, reply_managed_accts },
+    { REQ_FA, 1, NULL, NULL },
+    { REPLACE_FA, 2, NULL, NULL },
+    { REQ_HISTORICAL_DATA, 0, parse_req_historical_data, reply_req_historical_data },
+    { EXERCISE_OPTIONS, 14, NULL, NULL },
+    { REQ_SCANNER_SUBSCRIPTION, 22, NULL, NULL },
+    { CANCEL_SCANNER_SUBSCRIPTION, 1, NULL, NULL },
+    { REQ_SCANNER_PARAMETERS, 0, NULL, NULL },
+    { CANCEL_HISTORICAL_DATA, 1, NULL, NULL },
+    { REQ_CURRENT_TIME, 0, NULL, reply_current_time },
+    { REQ_REAL_TIME_BARS, 14, NULL, NULL },
+    { CANCEL_REAL_TIME_BARS, 1, NULL, NULL },
+    { REQ_FUNDAMENTAL_DATA, 8, NULL, NULL },
+    { CANCEL_FUNDAMENTAL_DATA, 1, NULL, NULL },
+    { REQ_CALC_IMPLIED_VOLAT, 14, NULL, NULL },
+    { REQ_CALC_OPTION_PRICE, 14, NULL, NULL },
+    { CANCEL_CALC_IMPLIED_VOLAT, 1, NULL, NULL },
+    { CANCEL_CALC_OPTION_PRICE, 1, NULL, NULL },
+    { REQ_GLOBAL_CANCEL, 0, NULL, NULL },
+    { REQ_MARKET_DATA_TYPE, 1, NULL, NULL }
+};
+
+/* send the handshake reply: server version and connection time */
+static void put_hello(client_t *c)
+{
+    time_t now = time(NULL);
+    char buf[40];
+
+    strftime(buf, sizeof buf, "%Y%m%d %H:%M:%S UTC", gmtime(&now));
+    tws_srv_encode_hello(&c->out, MIN_SERVER_VER_TRAILING_PERCENT + 1, buf);
+}
+
+/* handle what has been received; returns -1 when the connection is to be closed after the pending output */
+static int process_input(server_t *srv, client_t *c)
+{
+    size_t used = 0;
+    int err = 0;
+
+    while(!err && used < c->in.len) {
+        fields_t f;
+        const char *s;
+        const request_type_t *rt = NULL;
+        unsigned int j;
+        int id;
+
+        f.pos = c->in.data + used;
+        f.end = c->in.data + c->in.len;
+        f.count = 0;
+        if(!(s = next_field(&f)))
+            break;
+
+        if(c->state == CL_HELLO) {
+            put_hello(c);
+            c->state = atoi(s) >= 3 ? CL_CLIENT_ID : CL_RUNNING;
+        } else if(c->state == CL_CLIENT_ID) {
+            /* what a real TWS sends right after the connection has been set up */
+            reply_next_valid_id(srv, c, &f);
+            reply_managed_accts(srv, c, &f);
+            c->state = CL_RUNNING;
+            c->start_ns = monotonic_ns();
+        } else {
+            id = atoi(s);
+            for(j = 0; j < sizeof request_types / sizeof request_types[0]; j++)
+                if(request_types[j].id == (tws_outgoing_id_t)id)
+                    rt = &request_types[j];
+
+            if(!rt) {
+                tws_srv_encode_err_msg(&c->out, 2, -1, 505, "Fatal Error: Unknown message id.");
+                fprintf(stderr, "client fd %d: unknown request id %d, closing\n", c->fd, id);
+                err = -1;
+                break;
+            }
+            if(!next_field(&f) || (rt->parse ? rt->parse(&f) : skip_fields(&f, rt->fields)))
+                break;
+            if(rt->reply)
+                rt->reply(srv, c, &f);
+            c->requests++;
+            srv->requests++;
+        }
+        used = (size_t)(f.pos - c->in.data);
+    }
+
+    memmove(c->in.data, c->in.data + used, c->in.len - used);
+    c->in.len -= used;
+    check(&c->out);
+    return err;
+}
+
+/* write pending output; returns -1 when the connection broke */
+static int flush_output(client_t *c)
+{
+    while(c->out_sent < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + c->out_sent, c->out.len - c->out_sent, 0);
+
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        c->out_sent += (size_t)n;
+    }
+
+    if(c->out_sent == c->out.len) {
+        c->out.len = c->out_sent = 0;
+    } else if(c->out_sent > c->out.size / 2) {
+        memmove(c->out.data, c->out.data + c->out_sent, c->out.len - c->out_sent);
+        c->out.len -= c->out_sent;
+        c->out_sent = 0;
+    }
+    return 0;
+}
+
+/* time spent in the 'on' phases of the -w pattern since the stream started */
+static unsigned long long active_ns(const server_t *srv, unsigned long long elapsed)
+{
+    unsigned long long period = srv->on_ns + srv->off_ns, rem;
+
+    if(!srv->off_ns)
+        return elapsed;
+    rem = elapsed % period;
+    return elapsed / period * srv->on_ns + (rem < srv->on_ns ? rem : srv->on_ns);
+}
+
+/* inverse of active_ns(): elapsed time at which 'active' ns of sending will have passed */
+static unsigned long long elapsed_at(const server_t *srv, unsigned long long active)
+{
+    if(!srv->off_ns)
+        return active;
+    return active / srv->on_ns * (srv->on_ns + srv->off_ns) + active % srv->on_ns;
+}
+
+static void emit(client_t *c, const stream_t *s, unsigned int count)
+{
+    while(count) {
+        unsigned int k = c->next % s->count, m = s->count - k;
+
+        if(m > count)
+            m = count;
+        put_bytes(&c->out, s->wire.data + s->offsets[k], s->offsets[k + m] - s->offsets[k]);
+        c->bytes += s->offsets[k + m] - s->offsets[k];
+        c->next += m;
+        c->messages += m;
+        count -= m;
+    }
+}
+
+/*
+append stream messages to the output as the schedule allows; '*timeout_ms' is lowered to when the next ones are due.
+Returns 1 when it stopped because enough output is pending, -1 when the client has had all its messages.
+*/
+static int produce(server_t *srv, client_t *c, unsigned long long now, int *timeout_ms)
+{
+    const stream_t *s;
+    unsigned long long elapsed = now - c->start_ns, active = active_ns(srv, elapsed), wait;
+    int once;
+
+    if(srv->gen) {
+        if(c->pattern_dirty || !c->pattern.count)
+            build_pattern(srv, c);
+        s = &c->pattern;
+    } else if(srv->have_script && srv->script.count) {
+        s = &srv->script;
+    } else {
+        return 0;
+    }
+    once = !srv->gen && !srv->loop;
+
+    for(;;) {
+        unsigned long long left = srv->max_messages ? srv->max_messages - c->messages : ~0ULL;
+        unsigned int n = srv->rate > 0 ? srv->burst : (srv->burst > PATTERN_MESSAGES ? srv->burst : PATTERN_MESSAGES);
+
+        if(once && c->next >= s->count)
+            left = 0;
+        if(!left)
+            return srv->max_messages ? -1 : 0;
+        if(n > left)
+            n = (unsigned int)left;
+        if(once && n > s->count - c->next)
+            n = s->count - c->next;
+
+        if(srv->off_ns && elapsed % (srv->on_ns + srv->off_ns) >= srv->on_ns) {
+            wait = srv->on_ns + srv->off_ns - elapsed % (srv->on_ns + srv->off_ns);
+            break;
+        }
+        if(srv->rate > 0) {
+            unsigned long long due = (unsigned long long)((double)c->messages * 1e9 / srv->rate);
+
+            if(due > active) {
+                wait = elapsed_at(srv, due) - elapsed;
+                break;
+            }
+        }
+
+        if(c->out.len - c->out_sent >= OUT_HIGH_WATER)
+            return 1;
+        emit(c, s, n);
+    }
+
+    wait = (wait + 999999) / 1000000;
+    if(*timeout_ms < 0 || wait < (unsigned long long)*timeout_ms)
+        *timeout_ms = (int)wait;
+    return 0;
+}
+
+static void print_client(const client_t *c, unsigned long long now)
+{
+    double seconds = c->start_ns ? (double)(now - c->start_ns) / 1e9 : 0;
+
+    printf("client fd %d closed: %llu messages, %.1f MB, %llu requests in %.1f s", c->fd, c->messages,
+           (double)c->bytes / 1e6, c->requests, seconds);
+    if(seconds > 0)
+        printf(" (%.0f msgs/s)", (double)c->messages / seconds);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void drop_client(server_t *srv, int k)
+{
+    client_t *c = srv->clients[k];
+
+    if(!srv->quiet)
+        print_client(c, monotonic_ns());
+    close(c->fd);
+    tws_srv_buffer_free(&c->in);
+    tws_srv_buffer_free(&c->out);
+    free(c->subs);
+    stream_free(&c->pattern);
+    free(c);
+    srv->clients[k] = srv->clients[--srv->client_count];
+}
+
+static void accept_clients(server_t *srv)
+{
+    for(;;) {
+        int fd = accept(srv->listen_fd, NULL, NULL), one = 1;
+        client_t *c;
+
+        if(fd < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            return;
+        }
+        if(srv->client_count == MAX_CLIENTS) {
+            fprintf(stderr, "too many clients\n");
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        c = (client_t *)calloc(1, sizeof *c);
+        if(!c) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        tws_srv_buffer_init(&c->out, MIN_SERVER_VER_TRAILING_PERCENT + 1);
+        tws_srv_buffer_init(&c->pattern.wire, MIN_SERVER_VER_TRAILING_PERCENT + 1);
+        c->fd = fd;
+        c->state = CL_HELLO;
+        c->next_order_id = 1;
+        srv->clients[srv->client_count++] = c;
+    }
+}
+
+/* read what is there; returns -1 when the client is gone */
+static int read_input(server_t *srv, client_t *c)
+{
+    for(;;) {
+        ssize_t n;
+
+        reserve(&c->in, 65536);
+        n = recv(c->fd, c->in.data + c->in.len, c->in.size - c->in.len, 0);
+        if(n == 0)
+            return -1;
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        c->in.len += (size_t)n;
+        if(process_input(srv, c)) {
+            c->state = CL_CLOSING;
+            return 0;
+        }
+    }
+}
+
+static int listen_on(int port)
+{
+    struct sockaddr_in sa;
+    int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+
+    if(fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+    memset(&sa, 0, sizeof sa);
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((unsigned short)port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(fd, (struct sockaddr *)&sa, sizeof sa) || listen(fd, 16)) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-p <port>] [-t <message name>|mix] [-s <script or capture>] [-l] [-r <messages/s>] [-b <burst>]\n"
+            "       [-w <on ms>:<off ms>] [-n <messages>] [-q]\n", argv0);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    server_t srv;
+    struct pollfd fds[MAX_CLIENTS + 1];
+    unsigned long long last_stats;
+    const char *script = NULL;
+    int i, port = 7496;
+
+    memset(&srv, 0, sizeof srv);
+    srv.burst = 1;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-p") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "-t") && i + 1 < argc) {
+            unsigned int j;
+
+            i++;
+            for(j = 0; j < sizeof synthetic_types / sizeof synthetic_types[0]; j++)
+                if(!strcasecmp(argv[i], synthetic_types[j].name))
+                    srv.gen = synthetic_types[j].gen;
+            if(!srv.gen) {
+                fprintf(stderr, "unknown message type '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if(!strcmp(argv[i], "-s") && i + 1 < argc) {
+            script = argv[++i];
+        } else if(!strcmp(argv[i], "-l")) {
+            srv.loop = 1;
+        } else if(!strcmp(argv[i], "-r") && i + 1 < argc) {
+            srv.rate = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "-b") && i + 1 < argc) {
+            srv.burst = (unsigned int)atoi(argv[++i]);
+            if(srv.burst < 1)
+                srv.burst = 1;
+        } else if(!strcmp(argv[i], "-w") && i + 1 < argc) {
+            unsigned int on_ms, off_ms;
+
+            if(sscanf(argv[++i], "%u:%u", &on_ms, &off_ms) != 2 || !on_ms)
+                usage(argv[0]);
+            srv.on_ns = on_ms * 1000000ULL;
+            srv.off_ns = off_ms * 1000000ULL;
+        } else if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+            srv.max_messages = strtoull(argv[++i], NULL, 10);
+        } else if(!strcmp(argv[i], "-q")) {
+            srv.quiet = 1;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if(script && srv.gen) {
+        fprintf(stderr, "-t and -s exclude each other\n");
+        return EXIT_FAILURE;
+    }
+    if(script) {
+        tws_capture_t *cap = tws_capture_open(script);
+        int err;
+
+        if(cap) {
+            err = load_capture(&srv.script, cap);
+            tws_capture_close(cap);
+        } else {
+            err = load_script(&srv.script, script);
+        }
+        if(err)
+            return EXIT_FAILURE;
+        srv.have_script = 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    srv.listen_fd = listen_on(port);
+    if(srv.listen_fd < 0)
+        return EXIT_FAILURE;
+    if(!srv.quiet)
+        printf("listening on 127.0.0.1:%d\n", port), fflush(stdout);
+
+    last_stats = monotonic_ns();
+    for(;;) {
+        unsigned long long now = monotonic_ns();
+        int timeout = srv.quiet ? -1 : 1000, n, k;
+
+        for(k = 0; k < srv.client_count; k++) {
+            client_t *c = srv.clients[k];
+            int r = 0;
+
+            if(c->state == CL_RUNNING) {
+                unsigned long long before = c->messages, bytes = c->bytes;
+
+                r = produce(&srv, c, now, &timeout);
+                srv.messages += c->messages - before;
+                srv.bytes += c->bytes - bytes;
+                if(r < 0)
+                    c->state = CL_CLOSING;
+            }
+            if(flush_output(c) || (c->state == CL_CLOSING && c->out.len == 0)) {
+                drop_client(&srv, k--);
+                continue;
+            }
+            /* the socket took it all: go on right away */
+            if(r > 0 && c->out.len == 0)
+                timeout = 0;
+        }
+
+        fds[0].fd = srv.listen_fd;
+        fds[0].events = POLLIN;
+        for(k = 0; k < srv.client_count; k++) {
+            fds[k + 1].fd = srv.clients[k]->fd;
+            fds[k + 1].events = (short)((srv.clients[k]->state != CL_CLOSING ? POLLIN : 0) | (srv.clients[k]->out.len ? POLLOUT : 0));
+            fds[k + 1].revents = 0;
+        }
+        n = srv.client_count;
+
+        if(poll(fds, (nfds_t)n + 1, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+
+        /* backwards, as dropping a client moves the last one into its slot */
+        for(k = n - 1; k >= 0; k--) {
+            client_t *c = srv.clients[k];
+
+            if((fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR)) && c->state != CL_CLOSING && read_input(&srv, c))
+                drop_client(&srv, k);
+            else if((fds[k + 1].revents & POLLERR) && c->state == CL_CLOSING)
+                drop_client(&srv, k);
+        }
+        if(fds[0].revents & POLLIN)
+            accept_clients(&srv);
+
+        now = monotonic_ns();
+        if(now - last_stats >= 1000000000ULL) {
+            double seconds = (double)(now - last_stats) / 1e9;
+
+            if(!srv.quiet && (srv.client_count || srv.messages || srv.requests)) {
+                printf("clients %d  msgs/s %.0f  MB/s %.1f  requests/s %.0f\n", srv.client_count, (double)srv.messages / seconds,
+                       (double)srv.bytes / 1e6 / seconds, (double)srv.requests / seconds);
+                fflush(stdout);
+            }
+            srv.messages = srv.bytes = srv.requests = 0;
+            last_stats = now;
+        }
+    }
+}
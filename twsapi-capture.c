@@ -0,0 +1,341 @@
+#include "twsapi-capture.h"
+
+#ifdef unix
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+struct tws_capture {
+    const unsigned char *base;          /* image of the whole capture */
+    size_t size;
+    char *path;
+    tws_capture_index_entry_t *index;   /* NULL until tws_capture_index() */
+    unsigned int index_count;
+};
+
+
+/* map (unix) or load the whole file; returns NULL on failure, or an empty file */
+static unsigned char *load_file(const char *path, size_t *size)
+{
+#ifdef unix
+    struct stat st;
+    void *p;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+        return NULL;
+    if(fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED)
+        return NULL;
+    *size = (size_t)st.st_size;
+    return (unsigned char *)p;
+#else
+    unsigned char *p = NULL;
+    FILE *f = fopen(path, "rb");
+    long size_;
+
+    if(!f)
+        return NULL;
+    if(fseek(f, 0, SEEK_END) || (size_ = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET)
+       || !(p = (unsigned char *)malloc((size_t)size_))
+       || fread(p, 1, (size_t)size_, f) != (size_t)size_) {
+        fclose(f);
+        free(p);
+        return NULL;
+    }
+    fclose(f);
+    *size = (size_t)size_;
+    return p;
+#endif
+}
+
+static void unload_file(const unsigned char *base, size_t size)
+{
+#ifdef unix
+    munmap((void *)base, size);
+#else
+    (void)size;
+    free((void *)base);
+#endif
+}
+
+tws_capture_t *tws_capture_open(const char *path)
+{
+    tws_capture_t *cap = (tws_capture_t *)calloc(1, sizeof *cap);
+    const tws_capture_file_header_t *h;
+
+    if(!cap)
+        return NULL;
+
+    cap->path = (char *)malloc(strlen(path) + 1);
+    if(!cap->path)
+        goto fail;
+    strcpy(cap->path, path);
+
+    cap->base = load_file(path, &cap->size);
+    if(!cap->base || cap->size < sizeof *h)
+        goto fail;
+
+    /* the header is at offset 0 of a page aligned mapping (or of a malloc'ed block): it can be accessed in place */
+    h = (const tws_capture_file_header_t *)cap->base;
+    if(memcmp(h->f_magic, TWS_CAPTURE_MAGIC, sizeof h->f_magic) || h->f_version != TWS_CAPTURE_VERSION
+       || h->f_header_size < sizeof *h || h->f_header_size > cap->size)
+        goto fail;
+
+    return cap;
+
+fail:
+    if(cap->base)
+        unload_file(cap->base, cap->size);
+    free(cap->path);
+    free(cap);
+    return NULL;
+}
+
+void tws_capture_close(tws_capture_t *cap)
+{
+    if(!cap)
+        return;
+
+    unload_file(cap->base, cap->size);
+    free(cap->index);
+    free(cap->path);
+    free(cap);
+}
+
+const tws_capture_file_header_t *tws_capture_header(tws_capture_t *cap)
+{
+    return (const tws_capture_file_header_t *)cap->base;
+}
+
+int tws_capture_read(tws_capture_t *cap, unsigned long long *offset, tws_capture_record_t *rec, const unsigned char **payload)
+{
+    unsigned long long off = *offset;
+    size_t header_size = tws_capture_header(cap)->f_header_size;
+
+    if(off < header_size)
+        off = header_size;
+    if(off == cap->size)
+        return 1;
+    if(off > cap->size || cap->size - off < sizeof *rec)
+        return -1;
+
+    memcpy(rec, cap->base + off, sizeof *rec);
+    off += sizeof *rec;
+    if(cap->size - off < rec->r_length || rec->r_direction > TWS_CAPTURE_TX)
+        return -1;
+
+    *payload = cap->base + off;
+    *offset = off + rec->r_length;
+    return 0;
+}
+
+/* take "<path>.idx" when it agrees with the capture; returns 0 on success */
+static int load_index(tws_capture_t *cap)
+{
+    tws_capture_index_header_t xh;
+    tws_capture_index_entry_t *e;
+    unsigned char *base;
+    char *path;
+    size_t size, count, i;
+    int err = -1;
+
+    path = (char *)malloc(strlen(cap->path) + 5);
+    if(!path)
+        return -1;
+    sprintf(path, "%s.idx", cap->path);
+    base = load_file(path, &size);
+    free(path);
+    if(!base)
+        return -1;
+
+    if(size < sizeof xh)
+        goto out;
+    memcpy(&xh, base, sizeof xh);
+    if(memcmp(xh.x_magic, TWS_CAPTURE_INDEX_MAGIC, sizeof xh.x_magic) || xh.x_entry_size != sizeof *e || xh.x_interval == 0)
+        goto out;
+
+    count = (size - sizeof xh) / sizeof *e;
+    e = (tws_capture_index_entry_t *)malloc((count ? count : 1) * sizeof *e);
+    if(!e)
+        goto out;
+    memcpy(e, base + sizeof xh, count * sizeof *e);
+
+    /* entries must point at record boundaries inside the capture, in order: a capture rewritten under its index fails this */
+    for(i = 0; i < count; i++) {
+        tws_capture_record_t rec;
+        unsigned long long off = e[i].i_offset;
+        const unsigned char *payload;
+
+        if((i && (e[i].i_seq <= e[i - 1].i_seq || e[i].i_offset <= e[i - 1].i_offset))
+           || tws_capture_read(cap, &off, &rec, &payload) || rec.r_time_ns != e[i].i_time_ns || e[i].i_hello_offset > e[i].i_offset)
+            break;
+    }
+    if(i < count) {
+        free(e);
+        goto out;
+    }
+
+    cap->index = e;
+    cap->index_count = (unsigned int)count;
+    err = 0;
+out:
+    unload_file(base, size);
+    return err;
+}
+
+/* build the index by walking all records; a truncated tail is left out */
+static int scan_index(tws_capture_t *cap)
+{
+    unsigned long long off = 0, seq = 0, hello = 0;
+    unsigned int size = 0;
+
+    for(;;) {
+        tws_capture_record_t rec;
+        const unsigned char *payload;
+        unsigned long long at = off < tws_capture_header(cap)->f_header_size ? tws_capture_header(cap)->f_header_size : off;
+
+        if(tws_capture_read(cap, &off, &rec, &payload))
+            break;
+        if(rec.r_direction == TWS_CAPTURE_RX && (rec.r_flags & TWS_CAPTURE_HANDSHAKE))
+            hello = at;
+
+        if(seq % TWS_CAPTURE_INDEX_INTERVAL == 0) {
+            if(cap->index_count == size) {
+                tws_capture_index_entry_t *e;
+
+                size = size ? 2 * size : 64;
+                e = (tws_capture_index_entry_t *)realloc(cap->index, size * sizeof *e);
+                if(!e)
+                    return -1;
+                cap->index = e;
+            }
+            cap->index[cap->index_count].i_offset = at;
+            cap->index[cap->index_count].i_seq = seq;
+            cap->index[cap->index_count].i_time_ns = rec.r_time_ns;
+            cap->index[cap->index_count].i_hello_offset = hello;
+            cap->index_count++;
+        }
+        seq++;
+    }
+    return 0;
+}
+
+const tws_capture_index_entry_t *tws_capture_index(tws_capture_t *cap, unsigned int *count)
+{
+    if(!cap->index && load_index(cap) && scan_index(cap)) {
+        free(cap->index);
+        cap->index = NULL;
+        cap->index_count = 0;
+    }
+
+    *count = cap->index_count;
+    return cap->index;
+}
+
+unsigned long long tws_capture_seek_time(tws_capture_t *cap, unsigned long long time_ns, unsigned long long *seq)
+{
+    unsigned int count, lo = 0, hi;
+    const tws_capture_index_entry_t *e = tws_capture_index(cap, &count);
+
+    /* find the first entry later than time_ns; record times are monotonic within a capture */
+    hi = count;
+    while(lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if(e[mid].i_time_ns <= time_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo == 0) {
+        if(seq)
+            *seq = 0;
+        return 0;
+    }
+    if(seq)
+        *seq = e[lo - 1].i_seq;
+    return e[lo - 1].i_offset;
+}
+
+int tws_capture_split(tws_capture_t *cap, int count, unsigned long long *offsets)
+{
+    unsigned int n, i;
+    const tws_capture_index_entry_t *e = tws_capture_index(cap, &n);
+    int segments = 0;
+
+    if(!n || count < 1)
+        return 0;
+
+    offsets[0] = e[0].i_offset;
+    for(i = 1; i < (unsigned int)count; i++) {
+        unsigned int j = (unsigned int)((unsigned long long)i * n / count);
+
+        if(e[j].i_offset > offsets[segments])
+            offsets[++segments] = e[j].i_offset;
+    }
+    offsets[++segments] = cap->size;
+    return segments;
+}
+
+unsigned long long tws_capture_hello(tws_capture_t *cap, unsigned long long offset)
+{
+    unsigned int count, lo = 0, hi;
+    const tws_capture_index_entry_t *e = tws_capture_index(cap, &count);
+    unsigned long long off, hello = 0;
+
+    /* last entry at or before offset */
+    hi = count;
+    while(lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if(e[mid].i_offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo) {
+        hello = e[lo - 1].i_hello_offset;
+        off = e[lo - 1].i_offset;
+    } else {
+        off = 0;
+    }
+
+    /* a connection may have started between the entry and offset, or start at offset itself */
+    while(off <= offset) {
+        unsigned long long at = off < tws_capture_header(cap)->f_header_size ? tws_capture_header(cap)->f_header_size : off;
+        tws_capture_record_t rec;
+        const unsigned char *payload;
+
+        if(at > offset || tws_capture_read(cap, &off, &rec, &payload))
+            break;
+        if(!(rec.r_flags & TWS_CAPTURE_HANDSHAKE))
+            continue;
+        if(rec.r_direction == TWS_CAPTURE_RX) {
+            hello = at;
+        } else if(at == offset) {
+            /* the client version, sent before the server's: the handshake received next is this connection's */
+            unsigned long long next = off;
+
+            if(!tws_capture_read(cap, &off, &rec, &payload) && rec.r_direction == TWS_CAPTURE_RX
+               && (rec.r_flags & TWS_CAPTURE_HANDSHAKE))
+                hello = next;
+            break;
+        }
+    }
+    return hello;
+}
@@ -0,0 +1,109 @@
+#ifndef TWSAPI_CAPTURE_H_
+#define TWSAPI_CAPTURE_H_
+
+#include "twsapi.h"
+
+/*
+Binary capture of the raw TWS traffic, as written by tws_start_capture().
+
+A capture file is a tws_capture_file_header_t followed by records; each record is a tws_capture_record_t immediately
+followed by r_length bytes of payload: the exact bytes of one message as they went over the wire (NUL separated fields).
+Records are written back to back without padding, so a reader must not assume any alignment. The first records of each
+connection carry TWS_CAPTURE_HANDSHAKE: the client version sent and the server version (plus connection time) received.
+
+Next to the capture, "<path>.idx" holds a tws_capture_index_header_t and one tws_capture_index_entry_t for every
+TWS_CAPTURE_INDEX_INTERVAL records, which lets readers seek by record number or time without scanning the whole file.
+
+Both files use the host's byte order. A file cut short by a crash loses at most its last (partial) record.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+#define TWS_CAPTURE_MAGIC               "TWSCAP\0\1"
+#define TWS_CAPTURE_INDEX_MAGIC         "TWSCIX\0\1"
+#define TWS_CAPTURE_VERSION             1
+#define TWS_CAPTURE_INDEX_INTERVAL      1024
+
+/* r_direction */
+#define TWS_CAPTURE_RX                  0           /* received from TWS */
+#define TWS_CAPTURE_TX                  1           /* sent to TWS */
+
+/* r_flags */
+#define TWS_CAPTURE_HANDSHAKE           0x01        /* connection setup, r_msg_id is 0 */
+#define TWS_CAPTURE_INCOMPLETE          0x02        /* the connection dropped while the message was being read */
+
+typedef struct tws_capture_file_header {
+    char               f_magic[8];
+    unsigned int       f_version;
+    unsigned int       f_header_size;               /* sizeof(tws_capture_file_header_t) */
+    unsigned long long f_start_wall_ns;             /* wall clock time (ns since 1970-01-01 UTC) at f_start_mono_ns */
+    unsigned long long f_start_mono_ns;             /* monotonic clock when the capture was started */
+} tws_capture_file_header_t;
+
+typedef struct tws_capture_record {
+    unsigned long long r_time_ns;                   /* monotonic clock: when the message id was read, or when the message was flushed; never earlier than the record before it */
+    unsigned int       r_length;                    /* payload bytes following this header */
+    unsigned short     r_msg_id;                    /* tws_incoming_id_t or tws_outgoing_id_t, depending on r_direction */
+    unsigned char      r_direction;
+    unsigned char      r_flags;
+} tws_capture_record_t;
+
+typedef struct tws_capture_index_header {
+    char               x_magic[8];
+    unsigned int       x_interval;                  /* records between index entries */
+    unsigned int       x_entry_size;                /* sizeof(tws_capture_index_entry_t) */
+} tws_capture_index_header_t;
+
+typedef struct tws_capture_index_entry {
+    unsigned long long i_offset;                    /* file offset of the record */
+    unsigned long long i_seq;                       /* record number, 0 being the first record in the file */
+    unsigned long long i_time_ns;                   /* r_time_ns of the record */
+    unsigned long long i_hello_offset;              /* file offset of the received handshake of the record's connection, 0 if not recorded */
+} tws_capture_index_entry_t;
+
+typedef struct tws_capture tws_capture_t;
+
+/* open a capture for reading (memory mapped on unix); returns NULL when the file cannot be read or is not a capture */
+tws_capture_t *tws_capture_open(const char *path);
+void   tws_capture_close(tws_capture_t *cap);
+const tws_capture_file_header_t *tws_capture_header(tws_capture_t *cap);
+
+/*
+read the record at file offset '*offset' (0 stands for the first record) and advance '*offset' to the next one. '*payload' points
+into the capture and stays valid until tws_capture_close(). Returns 0 on success, 1 at the end of the file and -1 when the
+record is truncated or malformed.
+*/
+int    tws_capture_read(tws_capture_t *cap, unsigned long long *offset, tws_capture_record_t *rec, const unsigned char **payload);
+
+/*
+the seek index: loaded from "<path>.idx" when it is present and consistent with the capture, rebuilt by scanning the
+capture otherwise. Returns NULL (and '*count' 0) when the index cannot be built.
+*/
+const tws_capture_index_entry_t *tws_capture_index(tws_capture_t *cap, unsigned int *count);
+
+/* offset of the last indexed record with r_time_ns <= time_ns (0 when there is none); '*seq' (may be NULL) receives its number */
+unsigned long long tws_capture_seek_time(tws_capture_t *cap, unsigned long long time_ns, unsigned long long *seq);
+
+/*
+split the capture at index entries into at most 'count' segments with about the same number of records.
+'offsets' (count + 1 entries) receives the boundaries: segment i spans the file offsets [offsets[i], offsets[i + 1]).
+Returns the number of segments, which is less than 'count' for captures with few index entries.
+*/
+int    tws_capture_split(tws_capture_t *cap, int count, unsigned long long *offsets);
+
+/*
+offset of the received handshake of the connection the record at 'offset' belongs to (0 if the capture lacks it),
+found through the index and a scan of at most TWS_CAPTURE_INDEX_INTERVAL records. That is 'offset' itself when the record
+there is the received handshake, and the record after it when it is the client version that starts a connection.
+*/
+unsigned long long tws_capture_hello(tws_capture_t *cap, unsigned long long offset);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_CAPTURE_H_ */
@@ -0,0 +1,694 @@
+#include "twsapi-contract-db.h"
+
+#ifdef unix
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CDB_MAGIC               "TWSCDB\0\1"
+#define CDB_ALIGN               64
+#define CDB_INITIAL_CAPACITY    1024                /* records; the index has twice as many slots */
+#define CDB_INITIAL_HEAP        (64 * 1024)
+#define CDB_MAX_HEAP            0xffffffffUL        /* string offsets are 32 bit */
+#define ROUND_UP_POW2(num, pow2) (((num) + (pow2)-1) & ~((size_t)(pow2)-1))
+
+#define SUMMARY_FIELD(f)        (offsetof(tr_contract_details_t, d_summary) + offsetof(tr_contract_t, f))
+
+/* the char * members of tr_contract_details_t kept in the store; the tuple key members come first */
+static const size_t cdb_string_fields[] = {
+    SUMMARY_FIELD(c_symbol),
+    SUMMARY_FIELD(c_sectype),
+    SUMMARY_FIELD(c_exchange),
+    SUMMARY_FIELD(c_currency),
+    SUMMARY_FIELD(c_expiry),
+    SUMMARY_FIELD(c_right),
+    SUMMARY_FIELD(c_primary_exch),
+    SUMMARY_FIELD(c_local_symbol),
+    SUMMARY_FIELD(c_multiplier),
+    SUMMARY_FIELD(c_secid_type),
+    SUMMARY_FIELD(c_secid),
+    offsetof(tr_contract_details_t, d_market_name),
+    offsetof(tr_contract_details_t, d_trading_class),
+    offsetof(tr_contract_details_t, d_order_types),
+    offsetof(tr_contract_details_t, d_valid_exchanges),
+    offsetof(tr_contract_details_t, d_cusip),
+    offsetof(tr_contract_details_t, d_maturity),
+    offsetof(tr_contract_details_t, d_issue_date),
+    offsetof(tr_contract_details_t, d_ratings),
+    offsetof(tr_contract_details_t, d_bond_type),
+    offsetof(tr_contract_details_t, d_coupon_type),
+    offsetof(tr_contract_details_t, d_desc_append),
+    offsetof(tr_contract_details_t, d_next_option_date),
+    offsetof(tr_contract_details_t, d_next_option_type),
+    offsetof(tr_contract_details_t, d_notes),
+    offsetof(tr_contract_details_t, d_long_name),
+    offsetof(tr_contract_details_t, d_contract_month),
+    offsetof(tr_contract_details_t, d_industry),
+    offsetof(tr_contract_details_t, d_category),
+    offsetof(tr_contract_details_t, d_subcategory),
+    offsetof(tr_contract_details_t, d_timezone_id),
+    offsetof(tr_contract_details_t, d_trading_hours),
+    offsetof(tr_contract_details_t, d_liquid_hours),
+    offsetof(tr_contract_details_t, d_ev_rule)
+};
+
+#define CDB_STRINGS             (sizeof(cdb_string_fields) / sizeof(cdb_string_fields[0]))
+#define CDB_TUPLE_STRINGS       6                   /* symbol, sectype, exchange, currency, expiry, right */
+
+#define CDB_CONVERTIBLE         0x01
+#define CDB_CALLABLE            0x02
+#define CDB_PUTABLE             0x04
+#define CDB_NEXT_OPTION_PARTIAL 0x08
+
+#define STRING_FIELD(details, i) (*(char **)((char *)(details) + cdb_string_fields[i]))
+
+/* a string in the heap, NUL terminated; offset 0 is the empty string */
+typedef struct cdb_string {
+    unsigned int s_offset;
+    unsigned int s_length;
+} cdb_string_t;
+
+typedef struct cdb_record {
+    long long    r_stored_at;
+    double       r_strike;
+    double       r_mintick;
+    double       r_coupon;
+    double       r_ev_multiplier;
+    int          r_conid;
+    int          r_under_conid;
+    int          r_price_magnifier;
+    unsigned int r_flags;
+    cdb_string_t r_str[CDB_STRINGS];
+} cdb_record_t;
+
+/*
+file layout, each part aligned on CDB_ALIGN bytes:
+header | h_capacity records | conid index | tuple index | string heap (h_heap_size bytes)
+an index is an open addressing hash table of h_index_slots record numbers + 1 (0 marks an empty slot), linear probing
+*/
+typedef struct cdb_header {
+    char               h_magic[8];
+    unsigned int       h_record_size;   /* sizeof(cdb_record_t) of the build that created the file */
+    unsigned int       h_capacity;
+    unsigned int       h_count;
+    unsigned int       h_index_slots;   /* a power of 2, twice h_capacity */
+    unsigned long long h_heap_used;
+    unsigned long long h_heap_size;
+    unsigned long long h_heap_garbage;  /* bytes of h_heap_used no record refers to any more */
+} cdb_header_t;
+
+struct tws_contract_db {
+    unsigned char *base;                /* image of the whole file */
+    size_t size;
+#ifdef unix
+    int fd;
+#else
+    char *path;
+    int dirty;
+#endif
+};
+
+
+static size_t records_offset(void)
+{
+    return ROUND_UP_POW2(sizeof(cdb_header_t), CDB_ALIGN);
+}
+
+static size_t conid_index_offset(unsigned int capacity)
+{
+    return records_offset() + ROUND_UP_POW2((size_t)capacity * sizeof(cdb_record_t), CDB_ALIGN);
+}
+
+static size_t tuple_index_offset(unsigned int capacity)
+{
+    return conid_index_offset(capacity) + ROUND_UP_POW2((size_t)capacity * 2 * sizeof(unsigned int), CDB_ALIGN);
+}
+
+static size_t heap_offset(unsigned int capacity)
+{
+    return tuple_index_offset(capacity) + ROUND_UP_POW2((size_t)capacity * 2 * sizeof(unsigned int), CDB_ALIGN);
+}
+
+#define HEADER(db)       ((cdb_header_t *)(db)->base)
+#define RECORDS(db)      ((cdb_record_t *)((db)->base + records_offset()))
+#define CONID_INDEX(db)  ((unsigned int *)((db)->base + conid_index_offset(HEADER(db)->h_capacity)))
+#define TUPLE_INDEX(db)  ((unsigned int *)((db)->base + tuple_index_offset(HEADER(db)->h_capacity)))
+#define HEAP(db)         ((char *)(db)->base + heap_offset(HEADER(db)->h_capacity))
+
+/* change the size of the file image; newly added bytes are zero. Returns 0 on success, -1 on failure */
+static int resize_image(tws_contract_db_t *db, size_t size)
+{
+#ifdef unix
+    void *p;
+
+    if(db->base && munmap(db->base, db->size))
+        return -1;
+    db->base = NULL;
+    if(ftruncate(db->fd, (off_t)size))
+        return -1;
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, db->fd, 0);
+    if(p == MAP_FAILED)
+        return -1;
+    db->base = (unsigned char *)p;
+#else
+    unsigned char *p = (unsigned char *)realloc(db->base, size);
+
+    if(!p)
+        return -1;
+    if(size > db->size)
+        memset(p + db->size, 0, size - db->size);
+    db->base = p;
+    db->dirty = 1;
+#endif
+    db->size = size;
+    return 0;
+}
+
+static unsigned int hash_conid(int conid)
+{
+    return (unsigned int)conid * 2654435769U;
+}
+
+static unsigned int hash_bytes(unsigned int h, const void *p, size_t len)
+{
+    const unsigned char *s = (const unsigned char *)p;
+
+    while(len--)
+        h = (h ^ *s++) * 16777619U;
+    return h;
+}
+
+static unsigned int hash_tuple(const char *const str[CDB_TUPLE_STRINGS], double strike)
+{
+    unsigned int h = 2166136261U;
+    int i;
+
+    for(i = 0; i < CDB_TUPLE_STRINGS; i++)
+        h = hash_bytes(h, str[i], strlen(str[i]) + 1);
+    return hash_bytes(h, &strike, sizeof strike);
+}
+
+static int tuple_matches(tws_contract_db_t *db, const cdb_record_t *r, const char *const str[CDB_TUPLE_STRINGS], double strike)
+{
+    const char *heap = HEAP(db);
+    int i;
+
+    if(memcmp(&r->r_strike, &strike, sizeof strike))
+        return 0;
+    for(i = 0; i < CDB_TUPLE_STRINGS; i++)
+        if(strcmp(heap + r->r_str[i].s_offset, str[i]))
+            return 0;
+    return 1;
+}
+
+static void tuple_of_contract(const tr_contract_t *c, const char *str[CDB_TUPLE_STRINGS])
+{
+    str[0] = c->c_symbol ? c->c_symbol : "";
+    str[1] = c->c_sectype ? c->c_sectype : "";
+    str[2] = c->c_exchange ? c->c_exchange : "";
+    str[3] = c->c_currency ? c->c_currency : "";
+    str[4] = c->c_expiry ? c->c_expiry : "";
+    str[5] = c->c_right ? c->c_right : "";
+}
+
+/* returns the record number or -1 */
+static int lookup_conid(tws_contract_db_t *db, int conid)
+{
+    unsigned int mask = HEADER(db)->h_index_slots - 1;
+    unsigned int *index = CONID_INDEX(db);
+    cdb_record_t *records = RECORDS(db);
+    unsigned int i;
+
+    for(i = hash_conid(conid) & mask; index[i]; i = (i + 1) & mask)
+        if(records[index[i] - 1].r_conid == conid)
+            return (int)index[i] - 1;
+    return -1;
+}
+
+static void index_conid(tws_contract_db_t *db, unsigned int rec)
+{
+    unsigned int mask = HEADER(db)->h_index_slots - 1;
+    unsigned int *index = CONID_INDEX(db);
+    unsigned int i;
+
+    for(i = hash_conid(RECORDS(db)[rec].r_conid) & mask; index[i]; i = (i + 1) & mask)
+        ;
+    index[i] = rec + 1;
+}
+
+static void tuple_of_record(tws_contract_db_t *db, const cdb_record_t *r, const char *str[CDB_TUPLE_STRINGS])
+{
+    const char *heap = HEAP(db);
+    int i;
+
+    for(i = 0; i < CDB_TUPLE_STRINGS; i++)
+        str[i] = heap + r->r_str[i].s_offset;
+}
+
+/* point the tuple index at 'rec' unless a record with the same tuple was stored later */
+static void index_tuple(tws_contract_db_t *db, unsigned int rec)
+{
+    unsigned int mask = HEADER(db)->h_index_slots - 1;
+    unsigned int *index = TUPLE_INDEX(db);
+    cdb_record_t *records = RECORDS(db);
+    const char *str[CDB_TUPLE_STRINGS];
+    unsigned int i;
+
+    tuple_of_record(db, &records[rec], str);
+    for(i = hash_tuple(str, records[rec].r_strike) & mask; index[i]; i = (i + 1) & mask) {
+        if(index[i] - 1 == rec)
+            return;
+        if(tuple_matches(db, &records[index[i] - 1], str, records[rec].r_strike)) {
+            if(records[index[i] - 1].r_stored_at > records[rec].r_stored_at)
+                return;
+            break;
+        }
+    }
+    index[i] = rec + 1;
+}
+
+/* take 'rec' out of the tuple index, where its tuple still is the one indexed for it */
+static void unindex_tuple(tws_contract_db_t *db, unsigned int rec)
+{
+    unsigned int mask = HEADER(db)->h_index_slots - 1;
+    unsigned int *index = TUPLE_INDEX(db);
+    cdb_record_t *records = RECORDS(db);
+    const char *str[CDB_TUPLE_STRINGS];
+    unsigned int hole, j;
+
+    tuple_of_record(db, &records[rec], str);
+    for(hole = hash_tuple(str, records[rec].r_strike) & mask; index[hole] && index[hole] - 1 != rec; hole = (hole + 1) & mask)
+        ;
+    if(!index[hole])
+        return;
+
+    /* shift the remainder of the probe sequence back so lookups need no tombstones */
+    index[hole] = 0;
+    for(j = (hole + 1) & mask; index[j]; j = (j + 1) & mask) {
+        unsigned int home;
+
+        tuple_of_record(db, &records[index[j] - 1], str);
+        home = hash_tuple(str, records[index[j] - 1].r_strike) & mask;
+        if(((j - home) & mask) >= ((j - hole) & mask)) {
+            index[hole] = index[j];
+            index[j] = 0;
+            hole = j;
+        }
+    }
+}
+
+/* double the record capacity: move the heap up, clear and rebuild both indexes */
+static int grow_records(tws_contract_db_t *db)
+{
+    unsigned int capacity = HEADER(db)->h_capacity, count = HEADER(db)->h_count, rec;
+    size_t heap_size = (size_t)HEADER(db)->h_heap_size;
+    size_t old_heap = heap_offset(capacity), new_heap = heap_offset(capacity * 2);
+    size_t records_end = records_offset() + (size_t)capacity * sizeof(cdb_record_t);
+
+    if(capacity * 2 < capacity || resize_image(db, new_heap + heap_size))
+        return -1;
+
+    memmove(db->base + new_heap, db->base + old_heap, heap_size);
+    memset(db->base + records_end, 0, new_heap - records_end);
+    HEADER(db)->h_capacity = capacity * 2;
+    HEADER(db)->h_index_slots = capacity * 4;
+
+    for(rec = 0; rec < count; rec++) {
+        index_conid(db, rec);
+        index_tuple(db, rec);
+    }
+    return 0;
+}
+
+/* rewrite the heap with the strings the records refer to, in record order; returns 0 on success, -1 on heap alloc failure */
+static int compact_heap(tws_contract_db_t *db)
+{
+    cdb_header_t *h = HEADER(db);
+    cdb_record_t *records = RECORDS(db);
+    char *heap = HEAP(db);
+    char *live = (char *)malloc((size_t)(h->h_heap_used - h->h_heap_garbage));
+    size_t used = 1;
+    unsigned int rec, i;
+
+    if(!live)
+        return -1;
+
+    live[0] = '\0';
+    for(rec = 0; rec < h->h_count; rec++) {
+        for(i = 0; i < CDB_STRINGS; i++) {
+            cdb_string_t *ref = &records[rec].r_str[i];
+
+            if(ref->s_length) {
+                memcpy(live + used, heap + ref->s_offset, ref->s_length + 1);
+                ref->s_offset = (unsigned int)used;
+                used += ref->s_length + 1;
+            }
+        }
+    }
+    memcpy(heap, live, used);
+    free(live);
+    h->h_heap_used = used;
+    h->h_heap_garbage = 0;
+#ifndef unix
+    db->dirty = 1;
+#endif
+    return 0;
+}
+
+/* make room for 'len' more heap bytes, reclaiming dead strings before the heap is grown */
+static int reserve_heap(tws_contract_db_t *db, size_t len)
+{
+    cdb_header_t *h = HEADER(db);
+    unsigned long long size = h->h_heap_size;
+
+    if(h->h_heap_used + len <= size)
+        return 0;
+
+    if(h->h_heap_garbage >= h->h_heap_used / 4 && !compact_heap(db) && h->h_heap_used + len <= size)
+        return 0;
+
+    while(size < h->h_heap_used + len)
+        size *= 2;
+    if(size > CDB_MAX_HEAP)
+        size = CDB_MAX_HEAP;
+    if(h->h_heap_used + len > size || resize_image(db, heap_offset(h->h_capacity) + (size_t)size))
+        return -1;
+
+    HEADER(db)->h_heap_size = size;
+    return 0;
+}
+
+/* heap bytes store_string() needs to replace 'ref' by 's': 0 when 'ref' already refers to an equal string */
+static size_t string_space(tws_contract_db_t *db, const char *s, const cdb_string_t *ref)
+{
+    size_t len = s ? strlen(s) : 0;
+
+    if(!len || (ref->s_length == len && !memcmp(HEAP(db) + ref->s_offset, s, len)))
+        return 0;
+    return len + 1;
+}
+
+/* store 's' in the heap unless 'ref' already refers to an equal string; the room has been reserved */
+static void store_string(tws_contract_db_t *db, const char *s, cdb_string_t *ref)
+{
+    size_t len = s ? strlen(s) : 0;
+    cdb_header_t *h = HEADER(db);
+
+    if(ref->s_length == len && (!len || !memcmp(HEAP(db) + ref->s_offset, s, len)))
+        return;
+
+    if(ref->s_length)
+        h->h_heap_garbage += ref->s_length + 1;
+    if(!len) {
+        ref->s_offset = ref->s_length = 0;
+        return;
+    }
+
+    memcpy(HEAP(db) + h->h_heap_used, s, len + 1);
+    ref->s_offset = (unsigned int)h->h_heap_used;
+    ref->s_length = (unsigned int)len;
+    h->h_heap_used += len + 1;
+}
+
+static int init_image(tws_contract_db_t *db)
+{
+    cdb_header_t *h;
+
+    if(resize_image(db, heap_offset(CDB_INITIAL_CAPACITY) + CDB_INITIAL_HEAP))
+        return -1;
+
+    memset(db->base, 0, db->size);
+    h = HEADER(db);
+    memcpy(h->h_magic, CDB_MAGIC, sizeof h->h_magic);
+    h->h_record_size = sizeof(cdb_record_t);
+    h->h_capacity = CDB_INITIAL_CAPACITY;
+    h->h_index_slots = CDB_INITIAL_CAPACITY * 2;
+    h->h_heap_size = CDB_INITIAL_HEAP;
+    h->h_heap_used = 1; /* the empty string */
+    return 0;
+}
+
+static int valid_image(const tws_contract_db_t *db)
+{
+    const cdb_header_t *h = (const cdb_header_t *)db->base;
+
+    return db->size >= sizeof(cdb_header_t)
+        && !memcmp(h->h_magic, CDB_MAGIC, sizeof h->h_magic)
+        && h->h_record_size == sizeof(cdb_record_t)
+        && h->h_capacity && h->h_count <= h->h_capacity
+        && h->h_index_slots == h->h_capacity * 2
+        && h->h_heap_used && h->h_heap_used <= h->h_heap_size && h->h_heap_garbage < h->h_heap_used
+        && heap_offset(h->h_capacity) + h->h_heap_size <= db->size;
+}
+
+tws_contract_db_t *tws_contract_db_open(const char *path)
+{
+    tws_contract_db_t *db = (tws_contract_db_t *)calloc(1, sizeof *db);
+#ifdef unix
+    struct stat st;
+    void *p;
+
+    if(!db)
+        return NULL;
+
+    db->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(db->fd < 0 || fstat(db->fd, &st))
+        goto fail;
+
+    if(st.st_size == 0) {
+        if(init_image(db))
+            goto fail;
+    } else {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, db->fd, 0);
+        if(p == MAP_FAILED)
+            goto fail;
+        db->base = (unsigned char *)p;
+        db->size = (size_t)st.st_size;
+        if(!valid_image(db))
+            goto fail;
+    }
+    return db;
+
+fail:
+    if(db->base)
+        munmap(db->base, db->size);
+    if(db->fd >= 0)
+        close(db->fd);
+    free(db);
+    return NULL;
+#else
+    FILE *f;
+    long size;
+
+    if(!db)
+        return NULL;
+
+    db->path = (char *)malloc(strlen(path) + 1);
+    if(!db->path)
+        goto fail;
+    strcpy(db->path, path);
+
+    f = fopen(path, "rb");
+    if(!f) {
+        if(init_image(db))
+            goto fail;
+        return db;
+    }
+
+    if(fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET)
+       || !(db->base = (unsigned char *)malloc((size_t)size))
+       || fread(db->base, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        goto fail;
+    }
+    fclose(f);
+    db->size = (size_t)size;
+    if(!valid_image(db))
+        goto fail;
+    return db;
+
+fail:
+    free(db->base);
+    free(db->path);
+    free(db);
+    return NULL;
+#endif
+}
+
+int tws_contract_db_sync(tws_contract_db_t *db)
+{
+#ifdef unix
+    return msync(db->base, db->size, MS_SYNC) ? -1 : 0;
+#else
+    FILE *f;
+    int err;
+
+    if(!db->dirty)
+        return 0;
+
+    f = fopen(db->path, "wb");
+    if(!f)
+        return -1;
+    err = fwrite(db->base, 1, db->size, f) != db->size;
+    err |= fclose(f) != 0;
+    if(!err)
+        db->dirty = 0;
+    return err ? -1 : 0;
+#endif
+}
+
+void tws_contract_db_close(tws_contract_db_t *db)
+{
+    if(!db)
+        return;
+
+    tws_contract_db_sync(db);
+#ifdef unix
+    munmap(db->base, db->size);
+    close(db->fd);
+#else
+    free(db->base);
+    free(db->path);
+#endif
+    free(db);
+}
+
+int tws_contract_db_put(tws_contract_db_t *db, const tr_contract_details_t *details, time_t stored_at)
+{
+    const tr_contract_t *c = &details->d_summary;
+    const char *str[CDB_TUPLE_STRINGS], *old_str[CDB_TUPLE_STRINGS];
+    double old_strike = 0.0;
+    cdb_string_t none = { 0, 0 };
+    cdb_record_t rec;
+    int n = lookup_conid(db, c->c_conid), moved = 0;
+    size_t space = 0;
+    unsigned int i, j;
+
+    if(c->c_conid <= 0)
+        return -1;
+
+    /* reserve the heap space first: growing or compacting it changes the offsets and may move the whole image */
+    for(i = 0; i < CDB_STRINGS; i++)
+        space += string_space(db, STRING_FIELD(details, i), n >= 0 ? &RECORDS(db)[n].r_str[i] : &none);
+    if(reserve_heap(db, space))
+        return -1;
+
+    if(n >= 0) {
+        rec = RECORDS(db)[n];
+        /* a conid that changed its tuple leaves the old tuple to another record stored with it, if any */
+        tuple_of_contract(c, str);
+        if(!tuple_matches(db, &rec, str, c->c_strike)) {
+            tuple_of_record(db, &rec, old_str);
+            old_strike = rec.r_strike;
+            unindex_tuple(db, (unsigned int)n);
+            moved = 1;
+        }
+    } else {
+        memset(&rec, 0, sizeof rec);
+    }
+
+    /* the old strings stay in place until the next compaction, old_str included */
+    for(i = 0; i < CDB_STRINGS; i++)
+        store_string(db, STRING_FIELD(details, i), &rec.r_str[i]);
+
+    rec.r_stored_at = (long long)stored_at;
+    rec.r_strike = c->c_strike;
+    rec.r_mintick = details->d_mintick;
+    rec.r_coupon = details->d_coupon;
+    rec.r_ev_multiplier = details->d_ev_multiplier;
+    rec.r_conid = c->c_conid;
+    rec.r_under_conid = details->d_under_conid;
+    rec.r_price_magnifier = details->d_price_magnifier;
+    rec.r_flags = (details->d_convertible ? CDB_CONVERTIBLE : 0) | (details->d_callable ? CDB_CALLABLE : 0)
+                | (details->d_putable ? CDB_PUTABLE : 0) | (details->d_next_option_partial ? CDB_NEXT_OPTION_PARTIAL : 0);
+
+    if(n < 0) {
+        if(HEADER(db)->h_count == HEADER(db)->h_capacity && grow_records(db))
+            return -1;
+        n = (int)HEADER(db)->h_count++;
+        RECORDS(db)[n] = rec;
+        index_conid(db, (unsigned int)n);
+    } else {
+        RECORDS(db)[n] = rec;
+    }
+    index_tuple(db, (unsigned int)n);
+
+    if(moved) {
+        for(j = 0; j < HEADER(db)->h_count; j++)
+            if(tuple_matches(db, &RECORDS(db)[j], old_str, old_strike))
+                index_tuple(db, j);
+    }
+
+#ifndef unix
+    db->dirty = 1;
+#endif
+    return 0;
+}
+
+static void load_record(tws_contract_db_t *db, const cdb_record_t *r, tr_contract_details_t *details, time_t *stored_at)
+{
+    char *heap = HEAP(db);
+    unsigned int i;
+
+    memset(details, 0, sizeof *details);
+    for(i = 0; i < CDB_STRINGS; i++)
+        STRING_FIELD(details, i) = heap + r->r_str[i].s_offset;
+
+    details->d_summary.c_strike = r->r_strike;
+    details->d_summary.c_conid = r->r_conid;
+    details->d_mintick = r->r_mintick;
+    details->d_coupon = r->r_coupon;
+    details->d_ev_multiplier = r->r_ev_multiplier;
+    details->d_under_conid = r->r_under_conid;
+    details->d_price_magnifier = r->r_price_magnifier;
+    details->d_convertible = !!(r->r_flags & CDB_CONVERTIBLE);
+    details->d_callable = !!(r->r_flags & CDB_CALLABLE);
+    details->d_putable = !!(r->r_flags & CDB_PUTABLE);
+    details->d_next_option_partial = !!(r->r_flags & CDB_NEXT_OPTION_PARTIAL);
+
+    if(stored_at)
+        *stored_at = (time_t)r->r_stored_at;
+}
+
+int tws_contract_db_find_conid(tws_contract_db_t *db, int conid, tr_contract_details_t *details, time_t *stored_at)
+{
+    int n = lookup_conid(db, conid);
+
+    if(n < 0)
+        return -1;
+
+    load_record(db, &RECORDS(db)[n], details, stored_at);
+    return 0;
+}
+
+int tws_contract_db_find_contract(tws_contract_db_t *db, const tr_contract_t *key, tr_contract_details_t *details, time_t *stored_at)
+{
+    unsigned int mask = HEADER(db)->h_index_slots - 1;
+    unsigned int *index = TUPLE_INDEX(db);
+    cdb_record_t *records = RECORDS(db);
+    const char *str[CDB_TUPLE_STRINGS];
+    unsigned int i;
+
+    tuple_of_contract(key, str);
+
+    for(i = hash_tuple(str, key->c_strike) & mask; index[i]; i = (i + 1) & mask) {
+        if(tuple_matches(db, &records[index[i] - 1], str, key->c_strike)) {
+            load_record(db, &records[index[i] - 1], details, stored_at);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int tws_contract_db_count(tws_contract_db_t *db)
+{
+    return (int)HEADER(db)->h_count;
+}
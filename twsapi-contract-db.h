@@ -0,0 +1,59 @@
+#ifndef TWSAPI_CONTRACT_DB_H_
+#define TWSAPI_CONTRACT_DB_H_
+
+#include "twsapi.h"
+
+#include <time.h>
+
+/*
+Persistent contract details store: a single file holding fixed-size records, a hash index by conid, a hash index by
+the (symbol, sectype, exchange, currency, expiry, strike, right) tuple and a string heap. On unix the file is memory
+mapped so opening it costs no parsing at all; elsewhere it is read into memory and written back by sync/close.
+
+Typical use: open the store at startup and resolve contracts from it; call tws_contract_db_put() from event_contract_details()
+and event_bond_contract_details() so replies are recorded as they arrive. Each record carries the time it was stored:
+callers revalidate lazily by re-requesting the details of records older than they care for and putting the fresh reply.
+
+The file uses the host's byte order and struct layout and must not be shared between processes while open.
+d_sec_id_list, c_undercomp and combo legs are not stored.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_contract_db tws_contract_db_t;
+
+/* open or create the store at 'path'; returns NULL when the file cannot be opened or is not a valid store */
+tws_contract_db_t *tws_contract_db_open(const char *path);
+/* write pending changes to disk and release the store */
+void   tws_contract_db_close(tws_contract_db_t *db);
+/* write pending changes to disk; returns 0 on success, -1 on I/O error */
+int    tws_contract_db_sync(tws_contract_db_t *db);
+
+/*
+record the contract details (keyed by d_summary.c_conid) with timestamp 'stored_at'. A conid already present is overwritten
+in place, and strings it no longer refers to are reclaimed when the heap fills up; for equal tuples the contract with the
+latest 'stored_at' wins. Returns 0 on success, -1 on failure.
+*/
+int    tws_contract_db_put(tws_contract_db_t *db, const tr_contract_details_t *details, time_t stored_at);
+
+/*
+look up a contract by conid or by the (c_symbol, c_sectype, c_exchange, c_currency, c_expiry, c_strike, c_right) fields
+of 'key' (NULL strings match empty ones). On success 'details' is filled in with strings pointing into the store: treat them
+as read only, valid until the next put, sync or close. '*stored_at' (may be NULL) receives the time the record was stored.
+Both return 0 on success, -1 when not found.
+*/
+int    tws_contract_db_find_conid(tws_contract_db_t *db, int conid, tr_contract_details_t *details, time_t *stored_at);
+int    tws_contract_db_find_contract(tws_contract_db_t *db, const tr_contract_t *key, tr_contract_details_t *details, time_t *stored_at);
+
+/* number of contracts in the store */
+int    tws_contract_db_count(tws_contract_db_t *db);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_CONTRACT_DB_H_ */
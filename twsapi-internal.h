@@ -0,0 +1,19 @@
+#ifndef TWSAPI_INTERNAL_H_
+#define TWSAPI_INTERNAL_H_
+
+/*
+Helpers shared by the library's source files. Not part of the API: applications do not include this header.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* days since 1970-01-01 for the given proleptic Gregorian date (twsapi.c) */
+long   tws_days_from_civil(int year, int month, int day);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TWSAPI_INTERNAL_H_ */
@@ -0,0 +1,510 @@
+#include "twsapi-loop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WHEEL_MASK      (TWS_LOOP_WHEEL_SLOTS - 1)
+#define FIRING          TWS_LOOP_WHEEL_SLOTS    /* list head of the timers being fired */
+#define MAX_EVENTS      256                     /* per epoll_wait(); level triggered, so the rest come next turn */
+
+typedef struct loop_entry {
+    tws_loop_t *loop;
+    tws_instance_t *ti;
+    int fd;
+    tws_loop_closed_func_t *closed;
+    void *arg;
+    int removed;                        /* off the loop, freed at the end of the turn */
+    int ready;                          /* on this turn's ready list */
+    int closing;                        /* tws_disconnect() took the socket off epoll; reaped at the end of the turn */
+    struct loop_entry *next;            /* all entries, or the removed ones */
+    struct loop_entry *prev;
+    struct loop_entry *next_ready;
+    struct loop_entry *next_dead;
+} loop_entry_t;
+
+typedef struct loop_timer {
+    tws_loop_timer_func_t *func;
+    void *arg;
+    unsigned long long due;             /* in ms of the loop clock */
+    unsigned int gen;                   /* bumped when freed, so stale handles do not match */
+    int slot;                           /* -1 when free */
+    int prev, next;                     /* within the slot, or the free list */
+} loop_timer_t;
+
+struct tws_loop {
+    int epfd;
+    int wakefd;                         /* eventfd for tws_loop_stop() */
+    int stopped;
+    unsigned int batch;
+    int count;
+    loop_entry_t *entries;
+    loop_entry_t *removed;
+    loop_entry_t *carry;                /* instances with data left over from the last turn */
+
+    loop_timer_t *timers;
+    int timers_size;
+    int timers_free;                    /* head of the free list */
+    int timers_active;
+    unsigned long long tick;            /* last ms the wheel has been run for */
+    int wheel[TWS_LOOP_WHEEL_SLOTS + 1];
+};
+
+
+static unsigned long long now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000 + (unsigned long long)ts.tv_nsec / 1000000;
+}
+
+tws_loop_t *tws_loop_create(void)
+{
+    struct epoll_event ev;
+    tws_loop_t *loop = (tws_loop_t *)calloc(1, sizeof *loop);
+    int j;
+
+    if(!loop)
+        return NULL;
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    memset(&ev, 0, sizeof ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;                 /* entries are never NULL */
+    if(loop->epfd < 0 || loop->wakefd < 0 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev)) {
+        if(loop->epfd >= 0)
+            close(loop->epfd);
+        if(loop->wakefd >= 0)
+            close(loop->wakefd);
+        free(loop);
+        return NULL;
+    }
+
+    loop->batch = TWS_LOOP_DEFAULT_BATCH;
+    loop->timers_free = -1;
+    loop->tick = now_ms();
+    for(j = 0; j <= TWS_LOOP_WHEEL_SLOTS; j++)
+        loop->wheel[j] = -1;
+    return loop;
+}
+
+static void free_list(loop_entry_t *e)
+{
+    loop_entry_t *next;
+
+    for(; e; e = next) {
+        next = e->next;
+        free(e);
+    }
+}
+
+void tws_loop_destroy(tws_loop_t *loop)
+{
+    loop_entry_t *e;
+
+    if(!loop)
+        return;
+    for(e = loop->entries; e; e = e->next)
+        if(!e->closing)
+            tws_set_disconnect_hook(e->ti, NULL, NULL);
+    free_list(loop->entries);
+    free_list(loop->removed);
+    free(loop->timers);
+    close(loop->epfd);
+    close(loop->wakefd);
+    free(loop);
+}
+
+/* off the loop; the memory stays until the end of the turn, the ready lists may point to it */
+static void remove_entry(tws_loop_t *loop, loop_entry_t *e)
+{
+    if(!e->closing) {                   /* otherwise off epoll already, and the number may be another socket's by now */
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, e->fd, NULL);
+        tws_set_disconnect_hook(e->ti, NULL, NULL);
+    }
+
+    if(e->prev)
+        e->prev->next = e->next;
+    else
+        loop->entries = e->next;
+    if(e->next)
+        e->next->prev = e->prev;
+
+    e->removed = 1;
+    e->prev = NULL;
+    e->next = loop->removed;
+    loop->removed = e;
+    loop->count--;
+}
+
+/* tws_disconnect() of a registered instance, wherever it is called: the socket leaves epoll while its number is still its own */
+static void entry_disconnect(tws_instance_t *ti, void *arg)
+{
+    loop_entry_t *e = (loop_entry_t *)arg;
+
+    epoll_ctl(e->loop->epfd, EPOLL_CTL_DEL, e->fd, NULL);
+    tws_set_disconnect_hook(ti, NULL, NULL);
+    e->closing = 1;
+}
+
+int tws_loop_add(tws_loop_t *loop, tws_instance_t *ti, int fd, tws_loop_closed_func_t *closed, void *arg)
+{
+    struct epoll_event ev;
+    loop_entry_t *e;
+
+    for(e = loop->entries; e; e = e->next)
+        if(e->ti == ti) {
+            if(!e->closing)
+                return -1;
+            remove_entry(loop, e);      /* reconnected before it was reaped: the caller knows, no 'closed' call */
+            break;
+        }
+
+    e = (loop_entry_t *)calloc(1, sizeof *e);
+    if(!e)
+        return -1;
+    e->loop = loop;
+    e->ti = ti;
+    e->fd = fd;
+    e->closed = closed;
+    e->arg = arg;
+
+    memset(&ev, 0, sizeof ev);
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = e;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        free(e);
+        return -1;
+    }
+    tws_set_disconnect_hook(ti, entry_disconnect, e);
+
+    e->next = loop->entries;
+    if(e->next)
+        e->next->prev = e;
+    loop->entries = e;
+    loop->count++;
+    return 0;
+}
+
+int tws_loop_remove(tws_loop_t *loop, tws_instance_t *ti)
+{
+    loop_entry_t *e;
+
+    for(e = loop->entries; e; e = e->next)
+        if(e->ti == ti) {
+            remove_entry(loop, e);
+            return 0;
+        }
+    return -1;
+}
+
+int tws_loop_count(tws_loop_t *loop)
+{
+    return loop->count;
+}
+
+void tws_loop_set_batch(tws_loop_t *loop, unsigned int messages)
+{
+    loop->batch = messages ? messages : 1;
+}
+
+static void timer_link(tws_loop_t *loop, int idx, int slot)
+{
+    loop_timer_t *t = &loop->timers[idx];
+
+    t->slot = slot;
+    t->prev = -1;
+    t->next = loop->wheel[slot];
+    if(t->next >= 0)
+        loop->timers[t->next].prev = idx;
+    loop->wheel[slot] = idx;
+}
+
+static void timer_unlink(tws_loop_t *loop, int idx)
+{
+    loop_timer_t *t = &loop->timers[idx];
+
+    if(t->prev >= 0)
+        loop->timers[t->prev].next = t->next;
+    else
+        loop->wheel[t->slot] = t->next;
+    if(t->next >= 0)
+        loop->timers[t->next].prev = t->prev;
+}
+
+/* back on the free list; the handle of the timer is void from here */
+static void timer_free(tws_loop_t *loop, int idx)
+{
+    loop_timer_t *t = &loop->timers[idx];
+
+    t->slot = -1;
+    t->gen++;
+    t->next = loop->timers_free;
+    loop->timers_free = idx;
+    loop->timers_active--;
+}
+
+unsigned long long tws_loop_timer_add(tws_loop_t *loop, unsigned int delay_ms, tws_loop_timer_func_t *func, void *arg)
+{
+    loop_timer_t *t;
+    int idx;
+
+    if(loop->timers_free < 0) {
+        int size = loop->timers_size ? 2 * loop->timers_size : 64, j;
+        loop_timer_t *timers = (loop_timer_t *)realloc(loop->timers, size * sizeof *timers);
+
+        if(!timers)
+            return 0;
+        for(j = size - 1; j >= loop->timers_size; j--) {
+            timers[j].gen = 1;
+            timers[j].slot = -1;
+            timers[j].next = loop->timers_free;
+            loop->timers_free = j;
+        }
+        loop->timers = timers;
+        loop->timers_size = size;
+    }
+
+    idx = loop->timers_free;
+    t = &loop->timers[idx];
+    loop->timers_free = t->next;
+    loop->timers_active++;
+
+    t->func = func;
+    t->arg = arg;
+    t->due = now_ms() + delay_ms;
+    if(t->due <= loop->tick)            /* that ms has been run already */
+        t->due = loop->tick + 1;
+    timer_link(loop, idx, (int)(t->due & WHEEL_MASK));
+
+    return (unsigned long long)t->gen << 32 | (unsigned int)idx;
+}
+
+int tws_loop_timer_cancel(tws_loop_t *loop, unsigned long long timer)
+{
+    int idx = (int)(timer & 0xffffffffu);
+    loop_timer_t *t;
+
+    if(idx < 0 || idx >= loop->timers_size)
+        return -1;
+    t = &loop->timers[idx];
+    if(t->slot < 0 || t->gen != (unsigned int)(timer >> 32))
+        return -1;
+
+    timer_unlink(loop, idx);
+    timer_free(loop, idx);
+    return 0;
+}
+
+/* ms from the last run of the wheel to the next due timer, -1 if there is none */
+static long long timer_next(tws_loop_t *loop)
+{
+    unsigned long long min_due = ~0ULL;
+    int j, idx;
+
+    if(!loop->timers_active)
+        return -1;
+
+    for(j = 1; j <= TWS_LOOP_WHEEL_SLOTS; j++) {
+        unsigned long long at = loop->tick + j;
+
+        for(idx = loop->wheel[at & WHEEL_MASK]; idx >= 0; idx = loop->timers[idx].next) {
+            if(loop->timers[idx].due == at)
+                return j;
+            if(loop->timers[idx].due < min_due)
+                min_due = loop->timers[idx].due;
+        }
+    }
+    return (long long)(min_due - loop->tick); /* all of them a rotation or more away */
+}
+
+static void timer_run(tws_loop_t *loop)
+{
+    unsigned long long now = now_ms(), last = loop->tick;
+    unsigned long long n = now - last, j;
+
+    if(now <= last)
+        return;
+    if(n > TWS_LOOP_WHEEL_SLOTS)
+        n = TWS_LOOP_WHEEL_SLOTS;
+    loop->tick = now;                   /* timers added from callbacks are due next turn at the earliest */
+
+    for(j = 1; j <= n; j++) {
+        int slot = (int)((last + j) & WHEEL_MASK), idx;
+
+        /* move the slot to the FIRING list, so that callbacks can cancel and add timers while it is walked */
+        while((idx = loop->wheel[slot]) >= 0) {
+            timer_unlink(loop, idx);
+            timer_link(loop, idx, FIRING);
+        }
+
+        while((idx = loop->wheel[FIRING]) >= 0) {
+            loop_timer_t *t = &loop->timers[idx];
+
+            timer_unlink(loop, idx);
+            if(t->due > now) {
+                timer_link(loop, idx, slot); /* a later rotation */
+            } else {
+                tws_loop_timer_func_t *func = t->func;
+                void *arg = t->arg;
+
+                timer_free(loop, idx);
+                func(loop, arg);
+            }
+        }
+    }
+}
+
+/* drain one instance for at most a batch; returns the messages processed */
+static int process_entry(tws_loop_t *loop, loop_entry_t *e)
+{
+    unsigned int n = 0;
+
+    do {
+        tws_event_process(e->ti);
+        n++;
+        if(e->removed)                  /* by a callback */
+            break;
+        if(e->closing || !tws_connected(e->ti)) {
+            remove_entry(loop, e);
+            if(e->closed)
+                e->closed(loop, e->ti, e->arg);
+            break;
+        }
+    } while(n < loop->batch && tws_rx_pending(e->ti) > 0);
+
+    return (int)n;
+}
+
+/*
+instances disconnected outside process_entry(): by a timer, or from the callback of another instance. Their sockets left
+epoll when they were closed, so no event would ever report them. Collected first, as 'closed' may add and remove entries.
+*/
+static void reap_entries(tws_loop_t *loop)
+{
+    loop_entry_t *dead = NULL, *e, *next;
+
+    for(e = loop->entries; e; e = e->next)
+        if(e->closing || !tws_connected(e->ti)) {
+            e->next_dead = dead;
+            dead = e;
+        }
+
+    for(e = dead; e; e = next) {
+        next = e->next_dead;
+        if(e->removed)                  /* by an earlier 'closed' */
+            continue;
+        remove_entry(loop, e);
+        if(e->closed)
+            e->closed(loop, e->ti, e->arg);
+    }
+}
+
+int tws_loop_run_once(tws_loop_t *loop, int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    loop_entry_t *ready = NULL, **tail = &ready, *e, *next;
+    long long next_timer;
+    int nev, j, processed = 0;
+
+    /* what was left over last turn goes first; tws_loop_remove() may have taken some of it off since */
+    for(e = loop->carry; e; e = next) {
+        next = e->next_ready;
+        if(e->removed) {
+            e->ready = 0;
+        } else {
+            *tail = e;
+            tail = &e->next_ready;
+        }
+    }
+    *tail = NULL;
+    loop->carry = NULL;
+
+    if(ready) {
+        timeout_ms = 0;
+    } else if((next_timer = timer_next(loop)) >= 0) {
+        unsigned long long now = now_ms(), due = loop->tick + (unsigned long long)next_timer;
+        long long wait = due > now ? (long long)(due - now) : 0;
+
+        if(timeout_ms < 0 || wait < timeout_ms)
+            timeout_ms = (int)wait;
+    }
+
+    nev = epoll_wait(loop->epfd, events, MAX_EVENTS, timeout_ms);
+    if(nev < 0) {
+        if(errno != EINTR)
+            return -1;
+        nev = 0;
+    }
+
+    for(j = 0; j < nev; j++) {
+        e = (loop_entry_t *)events[j].data.ptr;
+        if(!e) {
+            uint64_t v;
+
+            if(read(loop->wakefd, &v, sizeof v) == (ssize_t)sizeof v)
+                loop->stopped = 1;
+            continue;
+        }
+        if(!e->ready) {
+            e->ready = 1;
+            *tail = e;
+            tail = &e->next_ready;
+        }
+    }
+    *tail = NULL;
+
+    tail = &loop->carry;
+    for(e = ready; e; e = next) {
+        next = e->next_ready;
+        if(!e->removed && !e->closing)
+            processed += process_entry(loop, e);
+        if(!e->removed && !e->closing && tws_rx_pending(e->ti) > 0) {
+            *tail = e;
+            tail = &e->next_ready;
+        } else {
+            e->ready = 0;
+        }
+    }
+    *tail = NULL;
+
+    timer_run(loop);
+    reap_entries(loop);
+
+    /* nothing points to removed entries any more, but the carry list, which was filtered above */
+    for(e = loop->removed, loop->removed = NULL; e; e = next) {
+        next = e->next;
+        if(e->ready) {                  /* taken off by a timer after it made the carry list */
+            e->next = loop->removed;
+            loop->removed = e;
+        } else {
+            free(e);
+        }
+    }
+
+    return processed;
+}
+
+int tws_loop_run(tws_loop_t *loop)
+{
+    loop->stopped = 0;
+    while(!loop->stopped)
+        if(tws_loop_run_once(loop, -1) < 0)
+            return -1;
+    return 0;
+}
+
+void tws_loop_stop(tws_loop_t *loop)
+{
+    uint64_t one = 1;
+    ssize_t r = write(loop->wakefd, &one, sizeof one);
+
+    (void)r;
+}
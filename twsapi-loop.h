@@ -0,0 +1,83 @@
+#ifndef TWSAPI_LOOP_H_
+#define TWSAPI_LOOP_H_
+
+#include "twsapi.h"
+
+/*
+Event loop for many instances in one thread (linux, epoll).
+
+Instead of a reader thread per instance blocking in tws_event_process(), the sockets of any number of connected instances
+are registered with one loop, which waits for all of them at once and calls tws_event_process() for those with data.
+Each ready instance is drained in batches: up to tws_loop_set_batch() messages per turn, so that a busy market data
+connection cannot hold up the others; what is left of its buffered data is picked up again in the next turn without
+waiting. A timer wheel runs in the same thread, for heartbeats, request pacing, timeouts and the like.
+
+The instances keep the transport they were created with. The loop calls tws_event_process() only when the socket is
+readable or the instance still holds received data (tws_rx_pending()), so receive() never has to wait for the start of a
+message. It may still be called in the middle of a message whose rest is in transit, and must then wait for it: on a
+blocking socket recv() does, on a non-blocking one receive() has to poll() for it. Either way a peer that stops in the
+middle of a message holds up the whole loop; an SO_RCVTIMEO on the socket bounds that.
+
+Everything about a loop and its instances - requests, tws_disconnect(), the functions below - happens in the thread
+that runs it, from callbacks or timers; only tws_loop_stop() may be called from elsewhere. Several loops may run in
+several threads, each with its own instances.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_loop tws_loop_t;
+
+/* an instance has been found disconnected and was taken off the loop; it may be destroyed or reconnected and added again */
+typedef void tws_loop_closed_func_t(tws_loop_t *loop, tws_instance_t *tws, void *arg);
+typedef void tws_loop_timer_func_t(tws_loop_t *loop, void *arg);
+
+#define TWS_LOOP_DEFAULT_BATCH      64          /* messages per instance and turn */
+#define TWS_LOOP_WHEEL_SLOTS        1024        /* timer wheel slots of 1 ms; later timers go round more than once */
+
+/* returns NULL when epoll or memory is not available */
+tws_loop_t *tws_loop_create(void);
+/* the instances are not disconnected, only forgotten */
+void   tws_loop_destroy(tws_loop_t *loop);
+
+/*
+register a connected instance and the socket its receive() reads; 'closed' (may be NULL) is called with 'arg' within the
+turn in which the instance got disconnected, whether the decoder found the connection lost or tws_disconnect() was called
+from a callback or timer (e.g. by a failed request). The loop sets the instance's disconnect hook
+(tws_set_disconnect_hook()) to stop watching the socket before it is closed. An instance that was disconnected and
+connected again within a turn may be added again right away: that replaces its old entry, without a 'closed' call.
+Returns 0, or -1 when the socket cannot be watched or the instance is registered already.
+*/
+int    tws_loop_add(tws_loop_t *loop, tws_instance_t *tws, int fd, tws_loop_closed_func_t *closed, void *arg);
+/* take an instance off the loop, e.g. before tws_destroy() of an instance still registered; no 'closed' call */
+int    tws_loop_remove(tws_loop_t *loop, tws_instance_t *tws);
+/* number of registered instances */
+int    tws_loop_count(tws_loop_t *loop);
+void   tws_loop_set_batch(tws_loop_t *loop, unsigned int messages);
+
+/*
+call 'func' once, 'delay_ms' from now (with the resolution of the wheel, 1 ms, and not before). A periodic timer adds
+itself again. Returns a handle for tws_loop_timer_cancel(), 0 when out of memory.
+*/
+unsigned long long tws_loop_timer_add(tws_loop_t *loop, unsigned int delay_ms, tws_loop_timer_func_t *func, void *arg);
+/* returns 0, or -1 when the timer has fired or been cancelled already */
+int    tws_loop_timer_cancel(tws_loop_t *loop, unsigned long long timer);
+
+/*
+one turn: wait up to 'timeout_ms' (-1: no limit) for data or the next timer, then process the ready instances and the
+due timers. Returns the number of messages processed, or -1 when epoll failed.
+*/
+int    tws_loop_run_once(tws_loop_t *loop, int timeout_ms);
+/* turn until tws_loop_stop(); returns 0, or -1 when epoll failed */
+int    tws_loop_run(tws_loop_t *loop);
+/* make tws_loop_run() return after the current turn; safe from any thread and from signal handlers */
+void   tws_loop_stop(tws_loop_t *loop);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_LOOP_H_ */
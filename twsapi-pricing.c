@@ -0,0 +1,268 @@
+#include "twsapi-pricing.h"
+#include "twsapi-internal.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define PRICING_BLOCK          64       /* options per inner loop; keeps the per block scratch arrays on the stack */
+#define MIN_STD_DEV            1e-12    /* floor for vol * sqrt(t): expired or zero vol options price at intrinsic value */
+#define MIN_YEARS              1e-12
+#define DAYS_PER_YEAR          365.0
+
+#define IV_MIN                 1e-4
+#define IV_MAX                 10.0
+#define IV_MAX_ITERATIONS      100
+#define IV_VOL_TOLERANCE       1e-9     /* price error over vega: how far the volatility can be off */
+#define IV_PRICE_EPSILONS      4.0      /* ... or the price error relative to the price, in units of DBL_EPSILON */
+
+#define DBL_NOTMAX(d) (fabs((d) - DBL_MAX) > DBL_EPSILON)
+
+#define SQRT_2PI               2.5066282746310002
+
+
+/*
+standard normal cumulative distribution: Hart (1968) algorithm 5666 as published by G. West, "Better approximations
+to cumulative normal functions" (2005); accurate to double precision. Both branches are evaluated and the result is
+selected so the function can be inlined into vectorized loops.
+*/
+static double norm_cdf(double x)
+{
+    double z = fabs(x);
+    double e = exp(-0.5 * z * z);
+    double num, den, cf, p;
+
+    num = ((((((3.52624965998911e-02 * z + 0.700383064443688) * z + 6.37396220353165) * z + 33.912866078383) * z
+           + 112.079291497871) * z + 221.213596169931) * z + 220.206867912376);
+    den = (((((((8.83883476483184e-02 * z + 1.75566716318264) * z + 16.064177579207) * z + 86.7807322029461) * z
+           + 296.564248779674) * z + 637.333633378831) * z + 793.826512519948) * z + 440.413735824752);
+    cf = z + 1.0 / (z + 2.0 / (z + 3.0 / (z + 4.0 / (z + 0.65))));
+
+    p = z < 7.07106781186547 ? e * num / den : e / (SQRT_2PI * cf);
+    p = z > 37.0 ? 0.0 : p;
+    return x > 0.0 ? 1.0 - p : p;
+}
+
+/*
+price one block of options. All outputs are mandatory; vega is per 1.00 of volatility and theta per year here,
+the public functions convert to the TWS conventions.
+*/
+static void price_block(tws_pricing_model_t model, int n, const double *s, const double *k, const double *t, const double *vol,
+                        const unsigned char *is_call, double rate, double dividend_yield,
+                        double *price, double *delta, double *gamma, double *vega, double *theta)
+{
+    double carry = (model == TWS_BLACK_76 ? 0.0 : rate - dividend_yield);
+    int i;
+
+    for(i = 0; i < n; i++) {
+        double years = t[i] > MIN_YEARS ? t[i] : MIN_YEARS;
+        double sqrt_t = sqrt(years);
+        double sd = vol[i] * sqrt_t;
+        double df = exp(-rate * years);
+        double fs = exp(carry * years);             /* d forward / d underlying */
+        double f = s[i] * fs;
+        double w = is_call[i] ? 1.0 : -1.0;
+        double d1, d2, nd1, nd2, pdf;
+
+        sd = sd > MIN_STD_DEV ? sd : MIN_STD_DEV;
+        d1 = log(f / k[i]) / sd + 0.5 * sd;
+        d2 = d1 - sd;
+        nd1 = norm_cdf(w * d1);
+        nd2 = norm_cdf(w * d2);
+        pdf = exp(-0.5 * d1 * d1) / SQRT_2PI;
+
+        price[i] = w * df * (f * nd1 - k[i] * nd2);
+        delta[i] = w * df * fs * nd1;
+        gamma[i] = df * fs * pdf / (s[i] * sd);
+        vega[i] = df * f * pdf * sqrt_t;
+        theta[i] = -df * f * pdf * sd / (2.0 * years) - w * (carry - rate) * df * f * nd1 - w * rate * k[i] * df * nd2;
+    }
+}
+
+void tws_price_options(tws_pricing_model_t model, int count, const double *underlying, const double *strike, const double *years,
+                       const double *volatility, const unsigned char *is_call, double rate, double dividend_yield,
+                       double *price, double *delta, double *gamma, double *vega, double *theta)
+{
+    double p[PRICING_BLOCK], d[PRICING_BLOCK], g[PRICING_BLOCK], v[PRICING_BLOCK], th[PRICING_BLOCK];
+    int base, i, n;
+
+    for(base = 0; base < count; base += n) {
+        n = count - base < PRICING_BLOCK ? count - base : PRICING_BLOCK;
+
+        price_block(model, n, underlying + base, strike + base, years + base, volatility + base, is_call + base,
+                    rate, dividend_yield, p, d, g, v, th);
+
+        if(price)
+            memcpy(price + base, p, n * sizeof(double));
+        if(delta)
+            memcpy(delta + base, d, n * sizeof(double));
+        if(gamma)
+            memcpy(gamma + base, g, n * sizeof(double));
+        if(vega)
+            for(i = 0; i < n; i++)
+                vega[base + i] = v[i] * 0.01;
+        if(theta)
+            for(i = 0; i < n; i++)
+                theta[base + i] = th[i] / DAYS_PER_YEAR;
+    }
+}
+
+int tws_implied_volatilities(tws_pricing_model_t model, int count, const double *underlying, const double *strike, const double *years,
+                             const double *option_price, const unsigned char *is_call, double rate, double dividend_yield,
+                             double *volatility)
+{
+    double vol[PRICING_BLOCK], lo[PRICING_BLOCK], hi[PRICING_BLOCK];
+    double p[PRICING_BLOCK], d[PRICING_BLOCK], g[PRICING_BLOCK], v[PRICING_BLOCK], th[PRICING_BLOCK];
+    unsigned char done[PRICING_BLOCK], valid[PRICING_BLOCK];
+    double carry = (model == TWS_BLACK_76 ? 0.0 : rate - dividend_yield);
+    int base, i, n, iter, solved = 0;
+
+    for(base = 0; base < count; base += n) {
+        const double *s = underlying + base, *k = strike + base, *t = years + base, *target = option_price + base;
+        const unsigned char *c = is_call + base;
+        int pending;
+
+        n = count - base < PRICING_BLOCK ? count - base : PRICING_BLOCK;
+
+        /* no-arbitrage bounds and the initial guess: the inflection point of price(vol), from which Newton converges
+           monotonically (Manaster & Koehler), or the Brenner & Subrahmanyam at-the-money approximation */
+        for(i = 0; i < n; i++) {
+            double df = exp(-rate * t[i]);
+            double f = s[i] * exp(carry * t[i]);
+            double w = c[i] ? 1.0 : -1.0;
+            double intrinsic = df * w * (f - k[i]);
+            double upper = c[i] ? df * f : df * k[i];
+            double guess;
+
+            intrinsic = intrinsic > 0.0 ? intrinsic : 0.0;
+            valid[i] = (s[i] > 0.0 && k[i] > 0.0 && t[i] > 0.0 && target[i] > intrinsic && target[i] < upper);
+
+            guess = sqrt(2.0 * fabs(log(f / k[i])) / (t[i] > MIN_YEARS ? t[i] : MIN_YEARS));
+            if(guess < IV_MIN || guess > IV_MAX || isnan(guess))
+                guess = SQRT_2PI / sqrt(t[i] > MIN_YEARS ? t[i] : MIN_YEARS) * target[i] / (df * f);
+
+            vol[i] = guess > IV_MIN && guess < IV_MAX ? guess : 0.5;
+            lo[i] = IV_MIN;
+            hi[i] = IV_MAX;
+            done[i] = !valid[i];
+        }
+
+        for(iter = 0; iter < IV_MAX_ITERATIONS; iter++) {
+            price_block(model, n, s, k, t, vol, c, rate, dividend_yield, p, d, g, v, th);
+
+            pending = 0;
+            for(i = 0; i < n; i++) {
+                double diff = p[i] - target[i];
+                double step, next;
+                /* in volatility, or relative to the price down to rounding: where vega vanishes, e.g. far out of the
+                   money, a price within some absolute distance of the target says nothing about the volatility */
+                int converged = (fabs(diff) <= IV_VOL_TOLERANCE * v[i] || fabs(diff) <= IV_PRICE_EPSILONS * DBL_EPSILON * target[i]);
+
+                hi[i] = diff > 0.0 ? vol[i] : hi[i];
+                lo[i] = diff > 0.0 ? lo[i] : vol[i];
+                step = vol[i] - diff / (v[i] > 0.0 ? v[i] : 1.0);
+                next = (v[i] > 0.0 && step > lo[i] && step < hi[i]) ? step : 0.5 * (lo[i] + hi[i]);
+
+                done[i] = done[i] | converged;
+                vol[i] = done[i] ? vol[i] : next;
+                pending += !done[i];
+            }
+            if(!pending)
+                break;
+        }
+
+        /* a last check: converged and not stuck at a bracket end */
+        price_block(model, n, s, k, t, vol, c, rate, dividend_yield, p, d, g, v, th);
+        for(i = 0; i < n; i++) {
+            double diff = fabs(p[i] - target[i]);
+            int ok = valid[i] && (diff <= IV_VOL_TOLERANCE * v[i] || diff <= IV_PRICE_EPSILONS * DBL_EPSILON * target[i]);
+
+            volatility[base + i] = ok ? vol[i] : DBL_MAX;
+            solved += ok;
+        }
+    }
+
+    return solved;
+}
+
+double tws_contract_years_to_expiry(const tr_contract_t *contract, time_t now)
+{
+    const char *e = contract->c_expiry;
+    int i, y, m, d;
+
+    if(!e)
+        return -1;
+    for(i = 0; i < 8; i++)
+        if(e[i] < '0' || e[i] > '9')
+            return -1;
+
+    y = (e[0] - '0') * 1000 + (e[1] - '0') * 100 + (e[2] - '0') * 10 + (e[3] - '0');
+    m = (e[4] - '0') * 10 + (e[5] - '0');
+    d = (e[6] - '0') * 10 + (e[7] - '0');
+    if(m < 1 || m > 12 || d < 1 || d > 31)
+        return -1;
+
+    return ((tws_days_from_civil(y, m, d) + 1) * 86400.0 - (double)now) / (DAYS_PER_YEAR * 86400.0);
+}
+
+/* returns 0 when the contract describes an unexpired put or call */
+static int contract_option(const tr_contract_t *contract, time_t now, tws_pricing_model_t *model, unsigned char *is_call, double *years)
+{
+    if(!contract->c_right || contract->c_strike <= 0.0 || !DBL_NOTMAX(contract->c_strike))
+        return -1;
+
+    switch(contract->c_right[0]) {
+    case 'C': case 'c': *is_call = 1; break;
+    case 'P': case 'p': *is_call = 0; break;
+    default: return -1;
+    }
+
+    *years = tws_contract_years_to_expiry(contract, now);
+    if(*years <= 0.0)
+        return -1;
+
+    *model = (contract->c_sectype && !strcmp(contract->c_sectype, "FOP")) ? TWS_BLACK_76 : TWS_BLACK_SCHOLES;
+    return 0;
+}
+
+static void fill_greeks(tws_pricing_model_t model, double under_price, double strike, double years, double vol, unsigned char is_call,
+                        double rate, double dividend_yield, double greeks[GREEK_COUNT])
+{
+    tws_price_options(model, 1, &under_price, &strike, &years, &vol, &is_call, rate, dividend_yield,
+                      &greeks[GREEK_OPT_PRICE], &greeks[GREEK_DELTA], &greeks[GREEK_GAMMA], &greeks[GREEK_VEGA], &greeks[GREEK_THETA]);
+
+    greeks[GREEK_IMPLIED_VOL] = vol;
+    greeks[GREEK_PV_DIVIDEND] = model == TWS_BLACK_76 ? 0.0 : under_price * (1.0 - exp(-dividend_yield * years));
+    greeks[GREEK_UND_PRICE] = under_price;
+}
+
+int tws_local_option_price(const tr_contract_t *contract, double volatility, double under_price, double rate, double dividend_yield,
+                           time_t now, double greeks[GREEK_COUNT])
+{
+    tws_pricing_model_t model;
+    unsigned char is_call;
+    double years;
+
+    if(contract_option(contract, now, &model, &is_call, &years) || under_price <= 0.0 || volatility <= 0.0)
+        return -1;
+
+    fill_greeks(model, under_price, contract->c_strike, years, volatility, is_call, rate, dividend_yield, greeks);
+    return 0;
+}
+
+int tws_local_implied_volatility(const tr_contract_t *contract, double option_price, double under_price, double rate, double dividend_yield,
+                                 time_t now, double greeks[GREEK_COUNT])
+{
+    tws_pricing_model_t model;
+    unsigned char is_call;
+    double years, vol;
+
+    if(contract_option(contract, now, &model, &is_call, &years) || under_price <= 0.0)
+        return -1;
+
+    if(!tws_implied_volatilities(model, 1, &under_price, &contract->c_strike, &years, &option_price, &is_call, rate, dividend_yield, &vol))
+        return -1;
+
+    fill_greeks(model, under_price, contract->c_strike, years, vol, is_call, rate, dividend_yield, greeks);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef TWSAPI_PRICING_H_
+#define TWSAPI_PRICING_H_
+
+#include "twsapi.h"
+
+#include <time.h>
+
+/*
+Local European option pricing: the same inputs as tws_calculate_option_price() and tws_calculate_implied_volatility()
+but computed in-process, without a round trip to TWS and without pacing. Results use the TICK_OPTION_COMPUTATION conventions
+so they can be compared with what TWS reports: vega per 0.01 change of the volatility, theta per calendar day.
+
+The batch functions work on whole option chains held in separate arrays (one entry per option); their inner loops are
+branch free and written so the compiler can vectorize them (e.g. gcc -O3 -ffast-math, which uses the vector math library
+for exp/log).
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef enum tws_pricing_model
+{
+    TWS_BLACK_SCHOLES = 0,      /* options on spot (STK, IND, CASH): Black-Scholes-Merton with a continuous dividend yield */
+    TWS_BLACK_76 = 1            /* options on futures (FOP): Black-76, the underlying price is the futures price */
+} tws_pricing_model_t;
+
+/*
+price 'count' options; 'is_call' holds 1 for calls and 0 for puts, 'years' the time to expiry in years (ACT/365).
+'rate' and 'dividend_yield' are continuously compounded and apply to the whole batch (dividend_yield is ignored for Black-76).
+Any of the output arrays may be NULL.
+*/
+void   tws_price_options(tws_pricing_model_t model, int count, const double *underlying, const double *strike, const double *years,
+                         const double *volatility, const unsigned char *is_call, double rate, double dividend_yield,
+                         double *price, double *delta, double *gamma, double *vega, double *theta);
+
+/*
+solve the implied volatility of 'count' options from their prices with a safeguarded Newton iteration (Newton steps on vega,
+falling back to bisection whenever a step leaves the bracket). Options whose price lies outside the no-arbitrage bounds get
+DBL_MAX, as do options that did not converge. Convergence is judged on the volatility (the price error over vega) or on
+the price relative to itself, never on an absolute price distance, so that a far out of the money option priced near zero,
+whose volatility the price hardly determines, is not reported solved at an arbitrary volatility. Returns the number of
+solved options.
+*/
+int    tws_implied_volatilities(tws_pricing_model_t model, int count, const double *underlying, const double *strike, const double *years,
+                                const double *option_price, const unsigned char *is_call, double rate, double dividend_yield,
+                                double *volatility);
+
+/* time from 'now' until the end (24:00 UTC) of the contract's c_expiry date (YYYYMMDD) in years (ACT/365); -1 when c_expiry is not a valid date */
+double tws_contract_years_to_expiry(const tr_contract_t *contract, time_t now);
+
+/*
+single contract counterparts of tws_calculate_option_price() and tws_calculate_implied_volatility(): the model is picked
+from c_sectype (Black-76 for "FOP", Black-Scholes otherwise), the option type from c_right and the time to expiry from c_expiry.
+'greeks' (indexed by tr_greek_t, as in the greeks store) receives implied vol, delta, option price, pv dividend, gamma, vega,
+theta and underlying price. Both return 0 on success, -1 on invalid input or when no volatility matches the option price.
+*/
+int    tws_local_option_price(const tr_contract_t *contract, double volatility, double under_price, double rate, double dividend_yield,
+                              time_t now, double greeks[GREEK_COUNT]);
+int    tws_local_implied_volatility(const tr_contract_t *contract, double option_price, double under_price, double rate, double dividend_yield,
+                                    time_t now, double greeks[GREEK_COUNT]);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_PRICING_H_ */
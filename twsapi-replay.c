@@ -0,0 +1,244 @@
+#include "twsapi-replay.h"
+
+#ifdef unix
+#include <errno.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+struct tws_replay {
+    tws_capture_t *cap;
+    unsigned long long offset;          /* of the next record to look at */
+    unsigned long long end;             /* tws_replay_set_range(); 0: the end of the capture */
+    unsigned long long hello_offset;    /* handshake to deliver before offset, 0 if none */
+    tws_capture_record_t rec;           /* the message being delivered */
+    const unsigned char *payload;
+    unsigned int delivered;             /* bytes of it handed out so far */
+    int in_record;
+    int in_session;                     /* the handshake of the current connection has been delivered */
+    int session_end;                    /* the current connection has been played out */
+    int at_end;                         /* the capture has been played out */
+    double speed;
+    int paced;                          /* first_time and start_clock are set */
+    unsigned long long first_time;      /* recorded time of the first paced message */
+    unsigned long long start_clock;     /* monotonic clock when it was delivered */
+    unsigned long long time_ns;         /* recorded time of the message being delivered */
+    unsigned long long messages;
+    char hello[80];                     /* synthesized handshake */
+};
+
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+#ifdef unix
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* hold the message with recorded time 't' back until its turn has come */
+static void pace(tws_replay_t *rp, unsigned long long t)
+{
+    unsigned long long due, now;
+
+    if(rp->speed <= 0)
+        return;
+
+    if(!rp->paced || t < rp->first_time) {
+        rp->paced = 1;
+        rp->first_time = t;
+        rp->start_clock = monotonic_ns();
+        return;
+    }
+
+    due = rp->start_clock + (unsigned long long)((double)(t - rp->first_time) / rp->speed);
+    while((now = monotonic_ns()) < due) {
+#ifdef unix
+        struct timespec ts;
+
+        ts.tv_sec = (time_t)((due - now) / 1000000000ULL);
+        ts.tv_nsec = (long)((due - now) % 1000000000ULL);
+        while(nanosleep(&ts, &ts) && errno == EINTR)
+            ;
+#else
+        /* no portable sleep below a second: spin */
+#endif
+    }
+}
+
+/* make the handshake of a connection recorded without one */
+static void synthesize_hello(tws_replay_t *rp, const tws_capture_record_t *next)
+{
+    time_t now = (time_t)(next->r_time_ns / 1000000000ULL);
+    struct tm tm;
+    int len;
+
+    /* replays may run in several threads at once */
+#ifdef unix
+    gmtime_r(&now, &tm);
+#else
+    gmtime_s(&tm, &now);
+#endif
+    len = sprintf(rp->hello, "%d", MIN_SERVER_VER_TRAILING_PERCENT + 1) + 1;
+    len += (int)strftime(rp->hello + len, sizeof rp->hello - len, "%Y%m%d %H:%M:%S UTC", &tm) + 1;
+
+    memset(&rp->rec, 0, sizeof rp->rec);
+    rp->rec.r_time_ns = next->r_time_ns;
+    rp->rec.r_length = (unsigned int)len;
+    rp->rec.r_flags = TWS_CAPTURE_HANDSHAKE;
+    rp->payload = (const unsigned char *)rp->hello;
+}
+
+/* move on to the next incoming message of the current connection; returns -1 when there is none */
+static int next_message(tws_replay_t *rp)
+{
+    const tws_capture_file_header_t *h = tws_capture_header(rp->cap);
+
+    if(rp->session_end || rp->at_end)
+        return -1;
+
+    for(;;) {
+        unsigned long long off = rp->offset;
+        const unsigned char *payload;
+        tws_capture_record_t rec;
+
+        if(!rp->in_session && rp->hello_offset) {
+            /* the segment starts in the middle of a connection */
+            off = rp->hello_offset;
+            rp->hello_offset = 0;
+            if(tws_capture_read(rp->cap, &off, &rec, &payload) == 0) {
+                rp->rec = rec;
+                rp->payload = payload;
+                break;
+            }
+            continue;
+        }
+
+        if((rp->end && off >= rp->end) || tws_capture_read(rp->cap, &off, &rec, &payload)) {
+            rp->at_end = 1;
+            return -1;
+        }
+        if(rec.r_direction != TWS_CAPTURE_RX) {
+            rp->offset = off;
+            continue;
+        }
+
+        if(!rp->in_session && !(rec.r_flags & TWS_CAPTURE_HANDSHAKE)) {
+            /* leave the record for the next call */
+            synthesize_hello(rp, &rec);
+        } else if(rp->in_session && (rec.r_flags & TWS_CAPTURE_HANDSHAKE)) {
+            /* a new connection starts here: the decoder must see the end of this one first */
+            rp->session_end = 1;
+            return -1;
+        } else {
+            rp->offset = off;
+            rp->rec = rec;
+            rp->payload = payload;
+        }
+        break;
+    }
+
+    pace(rp, rp->rec.r_time_ns);
+    rp->time_ns = h->f_start_wall_ns + (rp->rec.r_time_ns - h->f_start_mono_ns);
+    rp->in_session = 1;
+    rp->delivered = 0;
+    rp->in_record = 1;
+    if(!(rp->rec.r_flags & TWS_CAPTURE_HANDSHAKE))
+        rp->messages++;
+    return 0;
+}
+
+tws_replay_t *tws_replay_open(const char *path, double speed)
+{
+    tws_replay_t *rp = (tws_replay_t *)calloc(1, sizeof *rp);
+
+    if(!rp)
+        return NULL;
+
+    rp->cap = tws_capture_open(path);
+    if(!rp->cap) {
+        free(rp);
+        return NULL;
+    }
+    rp->speed = speed;
+    return rp;
+}
+
+void tws_replay_close(tws_replay_t *rp)
+{
+    if(!rp)
+        return;
+
+    tws_capture_close(rp->cap);
+    free(rp);
+}
+
+int tws_replay_set_range(tws_replay_t *rp, unsigned long long begin, unsigned long long end)
+{
+    unsigned long long hello = tws_capture_hello(rp->cap, begin);
+
+    rp->offset = begin;
+    rp->end = end;
+    rp->hello_offset = hello < begin ? hello : 0;
+    rp->in_record = rp->in_session = rp->session_end = rp->at_end = 0;
+    return 0;
+}
+
+int tws_replay_receive(tws_replay_t *rp, void *buf, unsigned int max_bufsize)
+{
+    unsigned int n;
+
+    if(!rp->in_record && next_message(rp))
+        return 0;
+
+    n = rp->rec.r_length - rp->delivered;
+    if(n > max_bufsize)
+        n = max_bufsize;
+    memcpy(buf, rp->payload + rp->delivered, n);
+    rp->delivered += n;
+
+    if(rp->delivered == rp->rec.r_length) {
+        rp->in_record = 0;
+        /* the recorded connection broke off in this message: so does the replayed one */
+        if(rp->rec.r_flags & TWS_CAPTURE_INCOMPLETE)
+            rp->session_end = 1;
+    }
+    return (int)n;
+}
+
+int tws_replay_run(tws_replay_t *rp, tws_instance_t *ti, int client_id)
+{
+    int err;
+
+    while(!rp->at_end) {
+        rp->in_session = 0;
+        rp->session_end = 0;
+        rp->in_record = 0;
+
+        err = tws_connect(ti, client_id);
+        if(err)
+            return rp->at_end ? 0 : err;
+
+        /* runs until tws_replay_receive() signals the end of the connection, which makes the decoder disconnect */
+        while(tws_connected(ti))
+            tws_event_process(ti);
+    }
+    return 0;
+}
+
+unsigned long long tws_replay_time(tws_replay_t *rp)
+{
+    return rp->time_ns;
+}
+
+unsigned long long tws_replay_messages(tws_replay_t *rp)
+{
+    return rp->messages;
+}
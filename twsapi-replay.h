@@ -0,0 +1,64 @@
+#ifndef TWSAPI_REPLAY_H_
+#define TWSAPI_REPLAY_H_
+
+#include "twsapi-capture.h"
+
+/*
+Replay of a binary capture (see tws_start_capture()) through the real decoder.
+
+The replay stands in for the network: the receive function passed to tws_create() forwards to tws_replay_receive(),
+which hands out the recorded incoming messages one at a time, and tws_replay_run() drives tws_connect() and
+tws_event_process() over them. Recorded outgoing messages are skipped; what the instance transmits is ignored.
+
+Messages are delivered as fast as the decoder takes them, or paced by their recorded timestamps, optionally scaled.
+Either way tws_replay_time() reports the recorded arrival time of the message being decoded, so callbacks see the
+same clock on every run regardless of the speed.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_replay tws_replay_t;
+
+/*
+open the capture at 'path'. 'speed' 0 replays as fast as possible, 1 in real time and N at N times real time.
+Returns NULL when the file is not a readable capture.
+*/
+tws_replay_t *tws_replay_open(const char *path, double speed);
+void   tws_replay_close(tws_replay_t *rp);
+
+/*
+restrict the replay to the records in the file offsets [begin, end), e.g. a segment from tws_capture_split(); end 0 means
+up to the end of the capture. When 'begin' lies inside a recorded connection the replay starts with that connection's
+handshake, so the segments of a capture can be decoded independently, one instance (and thread) each. Optional decoder
+features that keep state across messages (tws_set_scanner_diff(), the greeks store, bar aggregation) only see their segment.
+Call before tws_replay_run(); returns 0.
+*/
+int    tws_replay_set_range(tws_replay_t *rp, unsigned long long begin, unsigned long long end);
+
+/*
+the receive side of the replay transport, to be called from the tws_receive_func_t of the instance. Delivers the next
+incoming message (or the part of it that fits); returns 0 once the current recorded connection has been played out.
+A connection recorded without its handshake is given a synthesized one claiming server version MIN_SERVER_VER_TRAILING_PERCENT + 1.
+*/
+int    tws_replay_receive(tws_replay_t *rp, void *buf, unsigned int max_bufsize);
+
+/*
+play the whole capture into 'tws': tws_connect() for every recorded connection, then tws_event_process() until that
+connection's messages are used up. Returns 0 when the end of the capture was reached, otherwise the tws_connect() error.
+*/
+int    tws_replay_run(tws_replay_t *rp, tws_instance_t *tws, int client_id);
+
+/* recorded arrival time of the message being delivered, in ns since 1970-01-01 UTC; 0 before the first message */
+unsigned long long tws_replay_time(tws_replay_t *rp);
+/* number of incoming messages delivered so far, handshakes excluded */
+unsigned long long tws_replay_messages(tws_replay_t *rp);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_REPLAY_H_ */
@@ -0,0 +1,259 @@
+#include "twsapi-socket.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0                       /* SO_NOSIGPIPE instead */
+#endif
+#ifndef MSG_MORE
+#define MSG_MORE        0
+#endif
+
+#define COLLECT_SIZE    (64 * 1024)             /* requests collected before flush() or as a part of a larger one */
+
+struct tws_socket {
+    tws_socket_options_t opt;
+    char *host;
+    void *user;
+    int fd;
+    int corked;
+    unsigned int out_len;
+    char out[COLLECT_SIZE];
+};
+
+
+void tws_socket_init_options(tws_socket_options_t *opt)
+{
+    memset(opt, 0, sizeof *opt);
+    opt->host = "127.0.0.1";
+    opt->port = 7496;
+    opt->connect_timeout_ms = 5000;
+}
+
+tws_socket_t *tws_socket_create(const tws_socket_options_t *opt, void *user)
+{
+    tws_socket_t *s = (tws_socket_t *)malloc(sizeof *s);
+
+    if(!s)
+        return NULL;
+    s->opt = *opt;
+    s->host = (char *)malloc(strlen(opt->host) + 1);
+    if(!s->host) {
+        free(s);
+        return NULL;
+    }
+    strcpy(s->host, opt->host);
+    s->opt.host = s->host;
+    s->user = user;
+    s->fd = -1;
+    s->corked = 0;
+    s->out_len = 0;
+    return s;
+}
+
+void tws_socket_destroy(tws_socket_t *s)
+{
+    if(!s)
+        return;
+    tws_socket_close(s);
+    free(s->host);
+    free(s);
+}
+
+void *tws_socket_user(tws_socket_t *s)
+{
+    return s->user;
+}
+
+int tws_socket_fd(tws_socket_t *s)
+{
+    return s->fd;
+}
+
+/* wait for 'events' on 'fd'; returns 1 when there, 0 on timeout (errno ETIMEDOUT), -1 on failure */
+static int wait_fd(int fd, short events, int timeout_ms)
+{
+    struct pollfd pfd;
+    int r;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    do {
+        r = poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : -1);
+    } while(r < 0 && errno == EINTR);
+    if(r == 0)
+        errno = ETIMEDOUT;
+    return r;
+}
+
+static void set_options(const tws_socket_t *s, int fd)
+{
+    int one = 1;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+    /* the buffer sizes before connect(), for the window scale to match */
+    if(s->opt.rcvbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &s->opt.rcvbuf, sizeof s->opt.rcvbuf);
+    if(s->opt.sndbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &s->opt.sndbuf, sizeof s->opt.sndbuf);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+#ifdef SO_BUSY_POLL
+    if(s->opt.busy_poll_us > 0)
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &s->opt.busy_poll_us, sizeof s->opt.busy_poll_us);
+#endif
+}
+
+/* a connected socket, or -1 */
+static int connect_to(const tws_socket_t *s, const struct addrinfo *ai)
+{
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol), err = 0;
+    socklen_t len = sizeof err;
+
+    if(fd < 0)
+        return -1;
+    set_options(s, fd);
+
+    if(connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+        if(errno != EINPROGRESS
+           || wait_fd(fd, POLLOUT, s->opt.connect_timeout_ms) <= 0
+           || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) || err) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int tws_socket_open(void *arg)
+{
+    tws_socket_t *s = (tws_socket_t *)arg;
+    struct addrinfo hints, *res, *ai;
+    char port[8];
+    int fd = -1;
+
+    if(s->fd >= 0)
+        tws_socket_close(s);
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    sprintf(port, "%u", (unsigned int)s->opt.port);
+    if(getaddrinfo(s->host, port, &hints, &res))
+        return CONNECT_FAIL;
+    for(ai = res; ai && fd < 0; ai = ai->ai_next)
+        fd = connect_to(s, ai);
+    freeaddrinfo(res);
+    if(fd < 0)
+        return CONNECT_FAIL;
+
+    s->fd = fd;
+    s->out_len = 0;
+    return 0;
+}
+
+int tws_socket_close(void *arg)
+{
+    tws_socket_t *s = (tws_socket_t *)arg;
+
+    if(s->fd >= 0)
+        close(s->fd);
+    s->fd = -1;
+    s->out_len = 0;
+    return 0;
+}
+
+/* send what has been collected; 'flags' MSG_MORE while the request goes on */
+static int send_out(tws_socket_t *s, int flags)
+{
+    unsigned int off = 0;
+
+    while(off < s->out_len) {
+        ssize_t n = send(s->fd, s->out + off, s->out_len - off, flags | MSG_NOSIGNAL);
+
+        if(n > 0)
+            off += (unsigned int)n;
+        else if(n < 0 && errno == EINTR)
+            continue;
+        else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(s->fd, POLLOUT, s->opt.io_timeout_ms) > 0)
+            continue;
+        else
+            return -1;
+    }
+    s->out_len = 0;
+    return 0;
+}
+
+int tws_socket_transmit(void *arg, const void *buf, unsigned int buflen)
+{
+    tws_socket_t *s = (tws_socket_t *)arg;
+    const char *p = (const char *)buf;
+    unsigned int left = buflen;
+
+    if(s->fd < 0)
+        return -1;
+    while(left) {
+        unsigned int n = COLLECT_SIZE - s->out_len;
+
+        if(!n) {
+            if(send_out(s, MSG_MORE))
+                return -1;
+            n = COLLECT_SIZE;
+        }
+        if(n > left)
+            n = left;
+        memcpy(s->out + s->out_len, p, n);
+        s->out_len += n;
+        p += n;
+        left -= n;
+    }
+    return (int)buflen;
+}
+
+int tws_socket_flush(void *arg)
+{
+    tws_socket_t *s = (tws_socket_t *)arg;
+
+    if(s->fd < 0)
+        return -1;
+    return s->corked ? 0 : send_out(s, 0);
+}
+
+int tws_socket_cork(tws_socket_t *s, int on)
+{
+    s->corked = on;
+    return on || s->fd < 0 ? 0 : send_out(s, 0);
+}
+
+int tws_socket_receive(void *arg, void *buf, unsigned int max_bufsize)
+{
+    tws_socket_t *s = (tws_socket_t *)arg;
+
+    if(s->fd < 0)
+        return -1;
+    for(;;) {
+        ssize_t n = recv(s->fd, buf, max_bufsize, 0);
+
+        if(n >= 0)
+            return (int)n;
+        if(errno == EINTR)
+            continue;
+        if((errno != EAGAIN && errno != EWOULDBLOCK) || wait_fd(s->fd, POLLIN, s->opt.io_timeout_ms) <= 0)
+            return -1;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef TWSAPI_SOCKET_H_
+#define TWSAPI_SOCKET_H_
+
+#include "twsapi.h"
+
+/*
+TCP transport (unix): the transmit(), receive(), flush(), open() and close() callbacks for tws_create(), set up the way
+a trading connection wants them, so that not every program has to write its own.
+
+open() resolves the host, connects without blocking for longer than the connect timeout (trying each address in turn),
+and sets the socket up: non-blocking, TCP_NODELAY, the buffer sizes given, and on linux SO_BUSY_POLL if asked for.
+
+The requests of the library come in pieces of at most 512 bytes; transmit() collects them and flush(), at the end of each
+request, sends the request in one send(). Only a request larger than the collecting buffer goes out in several, all but
+the last with MSG_MORE, so that no partial request leaves as a segment of its own. tws_socket_cork() holds the flushes
+back, to send a burst of requests (e.g. a few hundred market data subscriptions) in as few segments as possible.
+
+receive() returns what recv() has; when there is nothing, as in the middle of a message whose rest is in transit, it
+waits for it in poll(), for at most the I/O timeout. Together with tws_socket_fd() the socket fits an event loop (see
+twsapi-loop.h), which calls tws_event_process() only once there is something to read.
+
+SO_BUSY_POLL spins in recv() and, the socket being non-blocking, in poll() only while the net.core.busy_poll sysctl is
+set as well.
+
+Usage:
+
+    tws_socket_options_t opt;
+
+    tws_socket_init_options(&opt);
+    opt.host = "10.0.0.5";
+    s = tws_socket_create(&opt, my_data);
+    ti = tws_create(s, tws_socket_transmit, tws_socket_receive, tws_socket_flush, tws_socket_open, tws_socket_close, NULL, NULL);
+    tws_connect(ti, client_id);
+
+The callbacks are then called with 's' as their 'opaque'; tws_socket_user(s) gives 'my_data'.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_socket_options {
+    const char *host;                           /* name or address; "127.0.0.1" */
+    unsigned short port;                        /* 7496 */
+    int connect_timeout_ms;                     /* per address; 5000 */
+    int io_timeout_ms;                          /* longest wait in receive(), transmit() and flush(), 0: none; 0 */
+    int rcvbuf;                                 /* SO_RCVBUF, 0: the system's; 0 */
+    int sndbuf;                                 /* SO_SNDBUF, 0: the system's; 0 */
+    int busy_poll_us;                           /* SO_BUSY_POLL (linux), 0: off; 0 */
+} tws_socket_options_t;
+
+typedef struct tws_socket tws_socket_t;
+
+/* the defaults noted above */
+void   tws_socket_init_options(tws_socket_options_t *opt);
+/* the options are copied, 'host' as well. Returns NULL when out of memory */
+tws_socket_t *tws_socket_create(const tws_socket_options_t *opt, void *user);
+/* closes the socket if it is still open */
+void   tws_socket_destroy(tws_socket_t *s);
+void  *tws_socket_user(tws_socket_t *s);
+/* -1 while not connected */
+int    tws_socket_fd(tws_socket_t *s);
+
+/* on: flush() keeps collecting; off: send what has been collected. Returns 0, or -1 when that send failed */
+int    tws_socket_cork(tws_socket_t *s, int on);
+
+/* the transport; 's' is the tws_socket_t. open() returns 0 or CONNECT_FAIL */
+int    tws_socket_open(void *s);
+int    tws_socket_close(void *s);
+int    tws_socket_transmit(void *s, const void *buf, unsigned int buflen);
+int    tws_socket_receive(void *s, void *buf, unsigned int max_bufsize);
+int    tws_socket_flush(void *s);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_SOCKET_H_ */
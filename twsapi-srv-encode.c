@@ -0,0 +1,1018 @@
+#include "twsapi-srv-encode.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+
+#if defined(_MSC_VER)
+#define strcasecmp(x,y) _stricmp(x,y)
+#else
+#include <strings.h>
+#endif
+
+#define IS_EMPTY(str) (!(str) || !*(str))
+#define DBL_NOTMAX(d) (fabs((d) - DBL_MAX) > DBL_EPSILON)
+
+/* the messages go out in order, every field NUL terminated; a failed append leaves the buffer as it was and sets 'error' */
+static int put(tws_srv_buffer_t *b, const void *data, size_t len)
+{
+    if(b->len + len > b->size) {
+        size_t size = b->size ? 2 * b->size : 4096;
+        char *p;
+
+        while(size < b->len + len)
+            size *= 2;
+        p = (char *)realloc(b->data, size);
+        if(!p) {
+            b->error = 1;
+            return -1;
+        }
+        b->data = p;
+        b->size = size;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+void tws_srv_buffer_init(tws_srv_buffer_t *b, int server_version)
+{
+    memset(b, 0, sizeof *b);
+    b->server_version = server_version ? server_version : MIN_SERVER_VER_TRAILING_PERCENT + 1;
+}
+
+void tws_srv_buffer_free(tws_srv_buffer_t *b)
+{
+    free(b->data);
+    b->data = NULL;
+    b->len = b->size = 0;
+}
+
+void tws_srv_buffer_reset(tws_srv_buffer_t *b)
+{
+    b->len = 0;
+    b->error = 0;
+}
+
+int tws_srv_msg_version(tws_incoming_id_t id)
+{
+    switch(id) {
+    case TICK_PRICE: case TICK_SIZE: case ORDER_STATUS: case TICK_OPTION_COMPUTATION:
+    case TICK_GENERIC: case TICK_STRING: case TICK_EFP: case BOND_CONTRACT_DATA:
+        return 6;
+    case OPEN_ORDER: return 30;
+    case PORTFOLIO_VALUE: return 7;
+    case CONTRACT_DATA: return 8;
+    case EXECUTION_DATA: return 9;
+    case HISTORICAL_DATA: case SCANNER_DATA: return 3;
+    case ERR_MSG: case ACCT_VALUE: return 2;
+    case ACCT_UPDATE_TIME: case NEXT_VALID_ID: case MARKET_DEPTH: case MARKET_DEPTH_L2:
+    case NEWS_BULLETINS: case MANAGED_ACCTS: case RECEIVE_FA: case SCANNER_PARAMETERS:
+    case CURRENT_TIME: case REAL_TIME_BARS: case FUNDAMENTAL_DATA: case CONTRACT_DATA_END:
+    case OPEN_ORDER_END: case ACCT_DOWNLOAD_END: case EXECUTION_DATA_END: case DELTA_NEUTRAL_VALIDATION:
+    case TICK_SNAPSHOT_END: case MARKET_DATA_TYPE: case COMMISSION_REPORT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int tws_srv_put_bytes(tws_srv_buffer_t *b, const void *data, size_t len)
+{
+    return put(b, data, len);
+}
+
+int tws_srv_put_str(tws_srv_buffer_t *b, const char str[])
+{
+    if(!str)
+        str = "";
+    return put(b, str, strlen(str) + 1);
+}
+
+int tws_srv_put_int(tws_srv_buffer_t *b, long val)
+{
+    char buf[24];
+
+    return put(b, buf, (size_t)sprintf(buf, "%ld", val) + 1);
+}
+
+int tws_srv_put_int_max(tws_srv_buffer_t *b, int val)
+{
+    return val != INT_MAX ? tws_srv_put_int(b, val) : tws_srv_put_str(b, "");
+}
+
+int tws_srv_put_double(tws_srv_buffer_t *b, double val)
+{
+    char buf[32];
+    int len = sprintf(buf, "%.15g", val);
+    double back = strtod(buf, NULL);
+
+    /* most prices have a short exact form; the others need all 17 digits to read back the same bits */
+    if(memcmp(&back, &val, sizeof val))
+        len = sprintf(buf, "%.17g", val);
+    return put(b, buf, (size_t)len + 1);
+}
+
+int tws_srv_put_double_max(tws_srv_buffer_t *b, double val)
+{
+    return DBL_NOTMAX(val) ? tws_srv_put_double(b, val) : tws_srv_put_str(b, "");
+}
+
+/* short names for the encoders below: they only look at the error flag at the end */
+#define put_str(s)          tws_srv_put_str(b, s)
+#define put_int(v)          tws_srv_put_int(b, v)
+#define put_int_max(v)      tws_srv_put_int_max(b, v)
+#define put_double(v)       tws_srv_put_double(b, v)
+#define put_double_max(v)   tws_srv_put_double_max(b, v)
+
+/* a message written while 'error' is set is taken back, so the buffer always holds whole messages */
+static int finish(tws_srv_buffer_t *b, size_t start)
+{
+    if(b->error) {
+        b->len = start;
+        return -1;
+    }
+    return 0;
+}
+
+static void put_tag_values(tws_srv_buffer_t *b, const tr_tag_value_t *list, int count)
+{
+    int j;
+
+    put_int(list ? count : 0);
+    for(j = 0; list && j < count; j++) {
+        put_str(list[j].t_tag);
+        put_str(list[j].t_val);
+    }
+}
+
+int tws_srv_encode_hello(tws_srv_buffer_t *b, int server_version, const char connect_time[])
+{
+    size_t start = b->len;
+
+    put_int(server_version);
+    if(server_version >= 20)
+        put_str(connect_time);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_price(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double price, int size, int can_auto_execute)
+{
+    size_t start = b->len;
+
+    put_int(TICK_PRICE);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_double(price);
+    if(version >= 2)
+        put_int(size);
+    if(version >= 3)
+        put_int(can_auto_execute);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_size(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, int size)
+{
+    size_t start = b->len;
+
+    put_int(TICK_SIZE);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_int(size);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_option_computation(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double implied_vol, double delta, double opt_price, double pv_dividend, double gamma, double vega, double theta, double und_price)
+{
+    size_t start = b->len;
+
+    /* "not computed" goes over the wire as -1 for values that cannot be negative, as -2 for the others */
+    put_int(TICK_OPTION_COMPUTATION);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_double(DBL_NOTMAX(implied_vol) ? implied_vol : -1);
+    put_double(DBL_NOTMAX(delta) ? delta : -2);
+    if(version >= 6 || tick_type == MODEL_OPTION) {
+        put_double(DBL_NOTMAX(opt_price) ? opt_price : -1);
+        put_double(DBL_NOTMAX(pv_dividend) ? pv_dividend : -1);
+    }
+    if(version >= 6) {
+        put_double(DBL_NOTMAX(gamma) ? gamma : -2);
+        put_double(DBL_NOTMAX(vega) ? vega : -2);
+        put_double(DBL_NOTMAX(theta) ? theta : -2);
+        put_double(DBL_NOTMAX(und_price) ? und_price : -1);
+    }
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_generic(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double value)
+{
+    size_t start = b->len;
+
+    put_int(TICK_GENERIC);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_double(value);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_string(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, const char value[])
+{
+    size_t start = b->len;
+
+    put_int(TICK_STRING);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_str(value);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_efp(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double basis_points, const char formatted_basis_points[], double implied_futures_price, int hold_days, const char future_expiry[], double dividend_impact, double dividends_to_expiry)
+{
+    size_t start = b->len;
+
+    put_int(TICK_EFP);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(tick_type);
+    put_double(basis_points);
+    put_str(formatted_basis_points);
+    put_double(implied_futures_price);
+    put_int(hold_days);
+    put_str(future_expiry);
+    put_double(dividend_impact);
+    put_double(dividends_to_expiry);
+    return finish(b, start);
+}
+
+int tws_srv_encode_order_status(tws_srv_buffer_t *b, int version, int order_id, const char status[], int filled, int remaining, double avg_fill_price, int perm_id, int parent_id, double last_fill_price, int client_id, const char why_held[])
+{
+    size_t start = b->len;
+
+    put_int(ORDER_STATUS);
+    put_int(version);
+    put_int(order_id);
+    put_str(status);
+    put_int(filled);
+    put_int(remaining);
+    put_double(avg_fill_price);
+    if(version >= 2)
+        put_int(perm_id);
+    if(version >= 3)
+        put_int(parent_id);
+    if(version >= 4)
+        put_double(last_fill_price);
+    if(version >= 5)
+        put_int(client_id);
+    if(version >= 6)
+        put_str(why_held);
+    return finish(b, start);
+}
+
+int tws_srv_encode_acct_value(tws_srv_buffer_t *b, int version, const char key[], const char val[], const char currency[], const char account_name[])
+{
+    size_t start = b->len;
+
+    put_int(ACCT_VALUE);
+    put_int(version);
+    put_str(key);
+    put_str(val);
+    put_str(currency);
+    if(version >= 2)
+        put_str(account_name);
+    return finish(b, start);
+}
+
+int tws_srv_encode_portfolio_value(tws_srv_buffer_t *b, int version, const tr_contract_t *contract, int position, double mkt_price, double mkt_value, double average_cost, double unrealized_pnl, double realized_pnl, const char account_name[])
+{
+    size_t start = b->len;
+
+    put_int(PORTFOLIO_VALUE);
+    put_int(version);
+    if(version >= 6)
+        put_int(contract->c_conid);
+    put_str(contract->c_symbol);
+    put_str(contract->c_sectype);
+    put_str(contract->c_expiry);
+    put_double(contract->c_strike);
+    put_str(contract->c_right);
+    if(version >= 7) {
+        put_str(contract->c_multiplier);
+        put_str(contract->c_primary_exch);
+    }
+    put_str(contract->c_currency);
+    if(version >= 2)
+        put_str(contract->c_local_symbol);
+    put_int(position);
+    put_double(mkt_price);
+    put_double(mkt_value);
+    if(version >= 3) {
+        put_double(average_cost);
+        put_double(unrealized_pnl);
+        put_double(realized_pnl);
+    }
+    if(version >= 4)
+        put_str(account_name);
+    if(version == 6 && b->server_version == 39)
+        put_str(contract->c_primary_exch);
+    return finish(b, start);
+}
+
+int tws_srv_encode_acct_update_time(tws_srv_buffer_t *b, int version, const char time_stamp[])
+{
+    size_t start = b->len;
+
+    put_int(ACCT_UPDATE_TIME);
+    put_int(version);
+    put_str(time_stamp);
+    return finish(b, start);
+}
+
+int tws_srv_encode_err_msg(tws_srv_buffer_t *b, int version, int id, int error_code, const char error_string[])
+{
+    size_t start = b->len;
+
+    put_int(ERR_MSG);
+    put_int(version);
+    if(version >= 2) {
+        put_int(id);
+        put_int(error_code);
+    }
+    put_str(error_string);
+    return finish(b, start);
+}
+
+int tws_srv_encode_open_order(tws_srv_buffer_t *b, int version, int order_id, const tr_contract_t *contract, const tr_order_t *order, const tr_order_status_t *ost)
+{
+    size_t start = b->len;
+    int j;
+
+    put_int(OPEN_ORDER);
+    put_int(version);
+    put_int(order_id);
+    if(version >= 17)
+        put_int(contract->c_conid);
+
+    put_str(contract->c_symbol);
+    put_str(contract->c_sectype);
+    put_str(contract->c_expiry);
+    put_double(contract->c_strike);
+    put_str(contract->c_right);
+    put_str(contract->c_exchange);
+    put_str(contract->c_currency);
+    if(version >= 2)
+        put_str(contract->c_local_symbol);
+
+    put_str(order->o_action);
+    put_int(order->o_total_quantity);
+    put_str(order->o_order_type);
+    if(version < 29)
+        put_double(order->o_lmt_price);
+    else
+        put_double_max(order->o_lmt_price);
+    if(version < 30)
+        put_double(order->o_aux_price);
+    else
+        put_double_max(order->o_aux_price);
+    put_str(order->o_tif);
+    put_str(order->o_oca_group);
+    put_str(order->o_account);
+    put_str(order->o_open_close);
+    put_int(order->o_origin);
+    put_str(order->o_orderref);
+
+    if(version >= 3)
+        put_int(order->o_clientid);
+
+    if(version >= 4) {
+        put_int(order->o_permid);
+        put_int(version >= 18 ? order->o_outside_rth : 0);     /* the decoder skips the ignore rth flag of older versions */
+        put_int(order->o_hidden);
+        put_double(order->o_discretionary_amt);
+    }
+
+    if(version >= 5)
+        put_str(order->o_good_after_time);
+
+    if(version >= 6)
+        put_str(""); /* deprecated: shares allocation */
+
+    if(version >= 7) {
+        put_str(order->o_fagroup);
+        put_str(order->o_famethod);
+        put_str(order->o_fapercentage);
+        put_str(order->o_faprofile);
+    }
+
+    if(version >= 8)
+        put_str(order->o_good_till_date);
+
+    if(version >= 9) {
+        put_str(order->o_rule80a);
+        put_double_max(order->o_percent_offset);
+        put_str(order->o_settling_firm);
+        put_int(order->o_short_sale_slot);
+        put_str(order->o_designated_location);
+        if(b->server_version == 51 || version >= 23)
+            put_int(order->o_exempt_code);
+        put_int(order->o_auction_strategy);
+        put_double_max(order->o_starting_price);
+        put_double_max(order->o_stock_ref_price);
+        put_double_max(order->o_delta);
+        put_double_max(order->o_stock_range_lower);
+        put_double_max(order->o_stock_range_upper);
+        put_int(order->o_display_size);
+        if(version < 18)
+            put_int(0); /* deprecated: rth only */
+        put_int(order->o_block_order);
+        put_int(order->o_sweep_to_fill);
+        put_int(order->o_all_or_none);
+        put_int_max(order->o_min_qty);
+        put_int(order->o_oca_type);
+        put_int(order->o_etrade_only);
+        put_int(order->o_firm_quote_only);
+        put_double_max(order->o_nbbo_price_cap);
+    }
+
+    if(version >= 10) {
+        put_int(order->o_parentid);
+        put_int(order->o_trigger_method);
+    }
+
+    if(version >= 11) {
+        put_double_max(order->o_volatility);
+        put_int(order->o_volatility_type);
+        if(version == 11) {
+            /* only a flag: the decoder makes "MKT" or "NONE" of it */
+            put_int(!IS_EMPTY(order->o_delta_neutral_order_type) && !strcasecmp(order->o_delta_neutral_order_type, "MKT"));
+        } else {
+            put_str(order->o_delta_neutral_order_type);
+            put_double_max(order->o_delta_neutral_aux_price);
+            if(version >= 27 && !IS_EMPTY(order->o_delta_neutral_order_type)) {
+                put_int(order->o_delta_neutral_con_id);
+                put_str(order->o_delta_neutral_settling_firm);
+                put_str(order->o_delta_neutral_clearing_account);
+                put_str(order->o_delta_neutral_clearing_intent);
+            }
+        }
+        put_int(order->o_continuous_update);
+        if(b->server_version == 26) {
+            put_double(order->o_stock_range_lower);
+            put_double(order->o_stock_range_upper);
+        }
+        put_int(order->o_reference_price_type);
+    }
+
+    if(version >= 13)
+        put_double_max(order->o_trail_stop_price);
+
+    if(version >= 30)
+        put_double_max(order->o_trailing_percent);
+
+    if(version >= 14) {
+        put_double_max(order->o_basis_points);
+        put_int_max(order->o_basis_points_type);
+        put_str(contract->c_combolegs_descrip);
+    }
+
+    if(version >= 29) {
+        int legs = contract->c_comboleg ? contract->c_num_combolegs : 0;
+
+        put_int(legs);
+        for(j = 0; j < legs; j++) {
+            const tr_comboleg_t *leg = &contract->c_comboleg[j];
+
+            put_int(leg->co_conid);
+            put_int(leg->co_ratio);
+            put_str(leg->co_action);
+            put_str(leg->co_exchange);
+            put_int(leg->co_open_close);
+            put_int(leg->co_short_sale_slot);
+            put_str(leg->co_designated_location);
+            put_int(leg->co_exempt_code);
+        }
+
+        legs = order->o_combo_legs ? order->o_combo_legs_count : 0;
+        put_int(legs);
+        for(j = 0; j < legs; j++)
+            put_double_max(order->o_combo_legs[j].cl_price);
+    }
+
+    if(version >= 26)
+        put_tag_values(b, order->o_smart_combo_routing_params, order->o_smart_combo_routing_params_count);
+
+    if(version >= 15) {
+        if(version >= 20) {
+            put_int_max(order->o_scale_init_level_size);
+            put_int_max(order->o_scale_subs_level_size);
+        } else {
+            put_str("");
+            put_int_max(order->o_scale_init_level_size);
+        }
+        put_double_max(order->o_scale_price_increment);
+    }
+
+    if(version >= 28 && order->o_scale_price_increment > 0.0 && DBL_NOTMAX(order->o_scale_price_increment)) {
+        put_double_max(order->o_scale_price_adjust_value);
+        put_int_max(order->o_scale_price_adjust_interval);
+        put_double_max(order->o_scale_profit_offset);
+        put_int(order->o_scale_auto_reset);
+        put_int_max(order->o_scale_init_position);
+        put_int_max(order->o_scale_init_fill_qty);
+        put_int(order->o_scale_random_percent);
+    }
+
+    if(version >= 24) {
+        put_str(order->o_hedge_type);
+        if(!IS_EMPTY(order->o_hedge_type))
+            put_str(order->o_hedge_param);
+    }
+
+    if(version >= 25)
+        put_int(order->o_opt_out_smart_routing);
+
+    if(version >= 19) {
+        put_str(order->o_clearing_account);
+        put_str(order->o_clearing_intent);
+    }
+
+    if(version >= 22)
+        put_int(order->o_not_held);
+
+    if(version >= 20) {
+        if(contract->c_undercomp) {
+            put_int(1);
+            put_int(contract->c_undercomp->u_conid);
+            put_double(contract->c_undercomp->u_delta);
+            put_double(contract->c_undercomp->u_price);
+        } else {
+            put_int(0);
+        }
+    }
+
+    if(version >= 21) {
+        put_str(order->o_algo_strategy);
+        if(!IS_EMPTY(order->o_algo_strategy))
+            put_tag_values(b, order->o_algo_params, order->o_algo_params_count);
+    }
+
+    if(version >= 16) {
+        put_int(order->o_whatif);
+        put_str(ost ? ost->ost_status : "");
+        put_str(ost ? ost->ost_init_margin : "");
+        put_str(ost ? ost->ost_maint_margin : "");
+        put_str(ost ? ost->ost_equity_with_loan : "");
+        put_double_max(ost ? ost->ost_commission : DBL_MAX);
+        put_double_max(ost ? ost->ost_min_commission : DBL_MAX);
+        put_double_max(ost ? ost->ost_max_commission : DBL_MAX);
+        put_str(ost ? ost->ost_commission_currency : "");
+        put_str(ost ? ost->ost_warning_text : "");
+    }
+    return finish(b, start);
+}
+
+int tws_srv_encode_next_valid_id(tws_srv_buffer_t *b, int version, int order_id)
+{
+    size_t start = b->len;
+
+    put_int(NEXT_VALID_ID);
+    put_int(version);
+    put_int(order_id);
+    return finish(b, start);
+}
+
+int tws_srv_encode_contract_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_details_t *cd)
+{
+    const tr_contract_t *c = &cd->d_summary;
+    size_t start = b->len;
+
+    put_int(CONTRACT_DATA);
+    put_int(version);
+    if(version >= 3)
+        put_int(req_id);
+    put_str(c->c_symbol);
+    put_str(c->c_sectype);
+    put_str(c->c_expiry);
+    put_double(c->c_strike);
+    put_str(c->c_right);
+    put_str(c->c_exchange);
+    put_str(c->c_currency);
+    put_str(c->c_local_symbol);
+    put_str(cd->d_market_name);
+    put_str(cd->d_trading_class);
+    put_int(c->c_conid);
+    put_double(cd->d_mintick);
+    put_str(c->c_multiplier);
+    put_str(cd->d_order_types);
+    put_str(cd->d_valid_exchanges);
+    if(version >= 2)
+        put_int(cd->d_price_magnifier);
+    if(version >= 4)
+        put_int(cd->d_under_conid);
+    if(version >= 5) {
+        put_str(cd->d_long_name);
+        put_str(c->c_primary_exch);
+    }
+    if(version >= 6) {
+        put_str(cd->d_contract_month);
+        put_str(cd->d_industry);
+        put_str(cd->d_category);
+        put_str(cd->d_subcategory);
+        put_str(cd->d_timezone_id);
+        put_str(cd->d_trading_hours);
+        put_str(cd->d_liquid_hours);
+    }
+    /* the decoder's order: the ev fields (version 8) come before the security id list (version 7) */
+    if(version >= 8) {
+        put_str(cd->d_ev_rule);
+        put_double(cd->d_ev_multiplier);
+    }
+    if(version >= 7)
+        put_tag_values(b, cd->d_sec_id_list, cd->d_sec_id_list_count);
+    return finish(b, start);
+}
+
+int tws_srv_encode_bond_contract_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_details_t *cd)
+{
+    const tr_contract_t *c = &cd->d_summary;
+    size_t start = b->len;
+
+    put_int(BOND_CONTRACT_DATA);
+    put_int(version);
+    if(version >= 3)
+        put_int(req_id);
+    put_str(c->c_symbol);
+    put_str(c->c_sectype);
+    put_str(cd->d_cusip);
+    put_double(cd->d_coupon);
+    put_str(cd->d_maturity);
+    put_str(cd->d_issue_date);
+    put_str(cd->d_ratings);
+    put_str(cd->d_bond_type);
+    put_str(cd->d_coupon_type);
+    put_int(cd->d_convertible);
+    put_int(cd->d_callable);
+    put_int(cd->d_putable);
+    put_str(cd->d_desc_append);
+    put_str(c->c_exchange);
+    put_str(c->c_currency);
+    put_str(cd->d_market_name);
+    put_str(cd->d_trading_class);
+    put_int(c->c_conid);
+    put_double(cd->d_mintick);
+    put_str(cd->d_order_types);
+    put_str(cd->d_valid_exchanges);
+    if(version >= 2) {
+        put_str(cd->d_next_option_date);
+        put_str(cd->d_next_option_type);
+        put_int(cd->d_next_option_partial);
+        put_str(cd->d_notes);
+    }
+    if(version >= 4)
+        put_str(cd->d_long_name);
+    if(version >= 6) {
+        put_str(cd->d_ev_rule);
+        put_double(cd->d_ev_multiplier);
+    }
+    if(version >= 5)
+        put_tag_values(b, cd->d_sec_id_list, cd->d_sec_id_list_count);
+    return finish(b, start);
+}
+
+int tws_srv_encode_execution_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_t *contract, const tr_execution_t *execution)
+{
+    size_t start = b->len;
+
+    put_int(EXECUTION_DATA);
+    put_int(version);
+    if(version >= 7)
+        put_int(req_id);
+    put_int(execution->e_orderid);
+    if(version >= 5)
+        put_int(contract->c_conid);
+    put_str(contract->c_symbol);
+    put_str(contract->c_sectype);
+    put_str(contract->c_expiry);
+    put_double(contract->c_strike);
+    put_str(contract->c_right);
+    if(version >= 9)
+        put_str(contract->c_multiplier);
+    put_str(contract->c_exchange);
+    put_str(contract->c_currency);
+    put_str(contract->c_local_symbol);
+
+    put_str(execution->e_execid);
+    put_str(execution->e_time);
+    put_str(execution->e_acct_number);
+    put_str(execution->e_exchange);
+    put_str(execution->e_side);
+    put_int(execution->e_shares);
+    put_double(execution->e_price);
+    if(version >= 2)
+        put_int(execution->e_permid);
+    if(version >= 3)
+        put_int(execution->e_clientid);
+    if(version >= 4)
+        put_int(execution->e_liquidation);
+    if(version >= 6) {
+        put_int(execution->e_cum_qty);
+        put_double(execution->e_avg_price);
+    }
+    if(version >= 8)
+        put_str(execution->e_orderref);
+    if(version >= 9) {
+        put_str(execution->e_ev_rule);
+        put_double(execution->e_ev_multiplier);
+    }
+    return finish(b, start);
+}
+
+int tws_srv_encode_market_depth(tws_srv_buffer_t *b, int version, int ticker_id, int position, int operation, int side, double price, int size)
+{
+    size_t start = b->len;
+
+    put_int(MARKET_DEPTH);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(position);
+    put_int(operation);
+    put_int(side);
+    put_double(price);
+    put_int(size);
+    return finish(b, start);
+}
+
+int tws_srv_encode_market_depth_l2(tws_srv_buffer_t *b, int version, int ticker_id, int position, const char market_maker[], int operation, int side, double price, int size)
+{
+    size_t start = b->len;
+
+    put_int(MARKET_DEPTH_L2);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(position);
+    put_str(market_maker);
+    put_int(operation);
+    put_int(side);
+    put_double(price);
+    put_int(size);
+    return finish(b, start);
+}
+
+int tws_srv_encode_news_bulletins(tws_srv_buffer_t *b, int version, int msgid, int msg_type, const char news_msg[], const char origin_exch[])
+{
+    size_t start = b->len;
+
+    put_int(NEWS_BULLETINS);
+    put_int(version);
+    put_int(msgid);
+    put_int(msg_type);
+    put_str(news_msg);
+    put_str(origin_exch);
+    return finish(b, start);
+}
+
+int tws_srv_encode_managed_accts(tws_srv_buffer_t *b, int version, const char accounts_list[])
+{
+    size_t start = b->len;
+
+    put_int(MANAGED_ACCTS);
+    put_int(version);
+    put_str(accounts_list);
+    return finish(b, start);
+}
+
+int tws_srv_encode_receive_fa(tws_srv_buffer_t *b, int version, tr_fa_msg_type_t fa_data_type, const char cxml[])
+{
+    size_t start = b->len;
+
+    put_int(RECEIVE_FA);
+    put_int(version);
+    put_int(fa_data_type);
+    put_str(cxml);
+    return finish(b, start);
+}
+
+int tws_srv_encode_historical_data(tws_srv_buffer_t *b, int version, int req_id, const char completion_from[], const char completion_to[], int bar_count)
+{
+    size_t start = b->len;
+
+    put_int(HISTORICAL_DATA);
+    put_int(version);
+    put_int(req_id);
+    if(version >= 2) {
+        put_str(completion_from);
+        put_str(completion_to);
+    }
+    put_int(bar_count);
+    return finish(b, start);
+}
+
+int tws_srv_encode_historical_bar(tws_srv_buffer_t *b, int version, const char date[], double open, double high, double low, double close, long volume, int bar_count, double wap, int has_gaps)
+{
+    size_t start = b->len;
+
+    put_str(date);
+    put_double(open);
+    put_double(high);
+    put_double(low);
+    put_double(close);
+    put_int(volume);
+    put_double(wap);
+    put_str(has_gaps ? "true" : "false");
+    if(version >= 3)
+        put_int(bar_count);
+    return finish(b, start);
+}
+
+int tws_srv_encode_scanner_parameters(tws_srv_buffer_t *b, int version, const char xml[])
+{
+    size_t start = b->len;
+
+    put_int(SCANNER_PARAMETERS);
+    put_int(version);
+    put_str(xml);
+    return finish(b, start);
+}
+
+int tws_srv_encode_scanner_data(tws_srv_buffer_t *b, int version, int ticker_id, int num_elements)
+{
+    size_t start = b->len;
+
+    put_int(SCANNER_DATA);
+    put_int(version);
+    put_int(ticker_id);
+    put_int(num_elements);
+    return finish(b, start);
+}
+
+int tws_srv_encode_scanner_row(tws_srv_buffer_t *b, int version, int rank, const tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[])
+{
+    const tr_contract_t *c = &cd->d_summary;
+    size_t start = b->len;
+
+    put_int(rank);
+    if(version >= 3)
+        put_int(c->c_conid);
+    put_str(c->c_symbol);
+    put_str(c->c_sectype);
+    put_str(c->c_expiry);
+    put_double(c->c_strike);
+    put_str(c->c_right);
+    put_str(c->c_exchange);
+    put_str(c->c_currency);
+    put_str(c->c_local_symbol);
+    put_str(cd->d_market_name);
+    put_str(cd->d_trading_class);
+    put_str(distance);
+    put_str(benchmark);
+    put_str(projection);
+    if(version >= 2)
+        put_str(legs_str);
+    return finish(b, start);
+}
+
+int tws_srv_encode_current_time(tws_srv_buffer_t *b, int version, long time)
+{
+    size_t start = b->len;
+
+    put_int(CURRENT_TIME);
+    put_int(version);
+    put_int(time);
+    return finish(b, start);
+}
+
+int tws_srv_encode_realtime_bars(tws_srv_buffer_t *b, int version, int req_id, long time, double open, double high, double low, double close, long volume, double wap, int count)
+{
+    size_t start = b->len;
+
+    put_int(REAL_TIME_BARS);
+    put_int(version);
+    put_int(req_id);
+    put_int(time);
+    put_double(open);
+    put_double(high);
+    put_double(low);
+    put_double(close);
+    put_int(volume);
+    put_double(wap);
+    put_int(count);
+    return finish(b, start);
+}
+
+int tws_srv_encode_fundamental_data(tws_srv_buffer_t *b, int version, int req_id, const char data[])
+{
+    size_t start = b->len;
+
+    put_int(FUNDAMENTAL_DATA);
+    put_int(version);
+    put_int(req_id);
+    put_str(data);
+    return finish(b, start);
+}
+
+int tws_srv_encode_contract_data_end(tws_srv_buffer_t *b, int version, int req_id)
+{
+    size_t start = b->len;
+
+    put_int(CONTRACT_DATA_END);
+    put_int(version);
+    put_int(req_id);
+    return finish(b, start);
+}
+
+int tws_srv_encode_open_order_end(tws_srv_buffer_t *b, int version)
+{
+    size_t start = b->len;
+
+    put_int(OPEN_ORDER_END);
+    put_int(version);
+    return finish(b, start);
+}
+
+int tws_srv_encode_acct_download_end(tws_srv_buffer_t *b, int version, const char acct_name[])
+{
+    size_t start = b->len;
+
+    put_int(ACCT_DOWNLOAD_END);
+    put_int(version);
+    put_str(acct_name);
+    return finish(b, start);
+}
+
+int tws_srv_encode_execution_data_end(tws_srv_buffer_t *b, int version, int req_id)
+{
+    size_t start = b->len;
+
+    put_int(EXECUTION_DATA_END);
+    put_int(version);
+    put_int(req_id);
+    return finish(b, start);
+}
+
+int tws_srv_encode_delta_neutral_validation(tws_srv_buffer_t *b, int version, int req_id, const under_comp_t *und)
+{
+    size_t start = b->len;
+
+    put_int(DELTA_NEUTRAL_VALIDATION);
+    put_int(version);
+    put_int(req_id);
+    put_int(und->u_conid);
+    put_double(und->u_delta);
+    put_double(und->u_price);
+    return finish(b, start);
+}
+
+int tws_srv_encode_tick_snapshot_end(tws_srv_buffer_t *b, int version, int req_id)
+{
+    size_t start = b->len;
+
+    put_int(TICK_SNAPSHOT_END);
+    put_int(version);
+    put_int(req_id);
+    return finish(b, start);
+}
+
+int tws_srv_encode_market_data_type(tws_srv_buffer_t *b, int version, int req_id, market_data_type_t data_type)
+{
+    size_t start = b->len;
+
+    put_int(MARKET_DATA_TYPE);
+    put_int(version);
+    put_int(req_id);
+    put_int(data_type);
+    return finish(b, start);
+}
+
+int tws_srv_encode_commission_report(tws_srv_buffer_t *b, int version, const tr_commission_report_t *report)
+{
+    size_t start = b->len;
+
+    put_int(COMMISSION_REPORT);
+    put_int(version);
+    put_str(report->cr_exec_id);
+    put_double(report->cr_commission);
+    put_str(report->cr_currency);
+    put_double(report->cr_realized_pnl);
+    put_double(report->cr_yield);
+    put_int(report->cr_yield_redemption_date);
+    return finish(b, start);
+}
+
+char *tws_srv_format_rt_volume(char *buf, size_t size, const tr_rt_volume_t *rv)
+{
+    char price[32] = "";
+
+    if(DBL_NOTMAX(rv->rv_price))
+        sprintf(price, "%.15g", rv->rv_price);
+    snprintf(buf, size, "%s;%ld;%lld;%ld;%.15g;%s", price, rv->rv_size, rv->rv_time, rv->rv_total_volume, rv->rv_vwap,
+             rv->rv_single_trade ? "true" : "false");
+    return buf;
+}
@@ -0,0 +1,125 @@
+#ifndef TWSAPI_SRV_ENCODE_H_
+#define TWSAPI_SRV_ENCODE_H_
+
+#include "twsapi.h"
+
+#include <stddef.h>
+
+/*
+Encoders for the server side of the protocol: each tws_srv_encode_*() appends one incoming message (see tws_incoming_id_t)
+to a buffer, the way TWS puts it on the wire, for fake servers, fuzzers and benchmarks.
+
+Every encoder mirrors the receive_*() decoder of its message in twsapi.c. It takes the arguments of the event_*() callback
+the decoder calls (plus the few fields the callback does not carry), and the message version to write, which decides the
+fields present exactly as it does in the decoder; tws_srv_msg_version() gives the version current TWS versions send. Where
+the decoder depends on the server version, the encoder uses the one the buffer was set up with.
+
+Decoding an encoded message calls its callback with the same arguments, field by field, with these exceptions:
+doubles go over the wire as the shortest decimal that reads back as the same value (NaN does not survive);
+tws_srv_encode_tick_option_computation() writes DBL_MAX (not computed) as the -1/-2 markers TWS uses; and the decoder turns
+missing pointers (an absent under_comp_t, a NULL string) into empty ones. Strings must not contain NUL characters.
+
+Usage: tws_srv_buffer_init(), any number of encoders, then send data[0 .. len), tws_srv_buffer_reset() to reuse the buffer.
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_srv_buffer {
+    char  *data;
+    size_t len;                                     /* bytes encoded so far */
+    size_t size;                                    /* allocated */
+    int    server_version;                          /* the version the client was told in the handshake */
+    int    error;                                   /* set when the buffer could not grow: messages are missing, the encoders fail until reset */
+} tws_srv_buffer_t;
+
+/* set up an empty buffer; 'server_version' 0 stands for MIN_SERVER_VER_TRAILING_PERCENT + 1, what the encoders are written against */
+void   tws_srv_buffer_init(tws_srv_buffer_t *b, int server_version);
+void   tws_srv_buffer_free(tws_srv_buffer_t *b);
+/* drop the content, keep the memory; clears 'error' */
+void   tws_srv_buffer_reset(tws_srv_buffer_t *b);
+
+/* the message version TWS sends for 'id' and the decoder reads in full; 0 for ids unknown to the decoder */
+int    tws_srv_msg_version(tws_incoming_id_t id);
+
+/*
+single fields, for messages the encoders do not cover (e.g. malformed ones). The _max variants write an empty field for
+INT_MAX / DBL_MAX, as the client does; tws_srv_put_bytes() appends raw bytes, e.g. a scripted message.
+All encoders and field writers return 0 on success and -1 when the buffer could not grow; an encoder also returns -1, and
+writes nothing, while 'error' is set.
+*/
+int    tws_srv_put_bytes(tws_srv_buffer_t *b, const void *data, size_t len);
+int    tws_srv_put_str(tws_srv_buffer_t *b, const char str[]);
+int    tws_srv_put_int(tws_srv_buffer_t *b, long val);
+int    tws_srv_put_int_max(tws_srv_buffer_t *b, int val);
+int    tws_srv_put_double(tws_srv_buffer_t *b, double val);
+int    tws_srv_put_double_max(tws_srv_buffer_t *b, double val);
+
+/* the server's half of the handshake: its version and, from version 20 on, the connection time, e.g. "20121008 10:00:00 EST" */
+int    tws_srv_encode_hello(tws_srv_buffer_t *b, int server_version, const char connect_time[]);
+
+/* 'size' is the size of the matching BID_SIZE, ASK_SIZE or LAST_SIZE tick which version 2 and up deliver as well */
+int    tws_srv_encode_tick_price(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double price, int size, int can_auto_execute);
+int    tws_srv_encode_tick_size(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, int size);
+int    tws_srv_encode_tick_option_computation(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double implied_vol, double delta, double opt_price, double pv_dividend, double gamma, double vega, double theta, double und_price);
+int    tws_srv_encode_tick_generic(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double value);
+/* also RT_VOLUME ticks; tws_srv_format_rt_volume() makes their value */
+int    tws_srv_encode_tick_string(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, const char value[]);
+int    tws_srv_encode_tick_efp(tws_srv_buffer_t *b, int version, int ticker_id, tr_tick_type_t tick_type, double basis_points, const char formatted_basis_points[], double implied_futures_price, int hold_days, const char future_expiry[], double dividend_impact, double dividends_to_expiry);
+int    tws_srv_encode_order_status(tws_srv_buffer_t *b, int version, int order_id, const char status[], int filled, int remaining, double avg_fill_price, int perm_id, int parent_id, double last_fill_price, int client_id, const char why_held[]);
+int    tws_srv_encode_acct_value(tws_srv_buffer_t *b, int version, const char key[], const char val[], const char currency[], const char account_name[]);
+int    tws_srv_encode_portfolio_value(tws_srv_buffer_t *b, int version, const tr_contract_t *contract, int position, double mkt_price, double mkt_value, double average_cost, double unrealized_pnl, double realized_pnl, const char account_name[]);
+int    tws_srv_encode_acct_update_time(tws_srv_buffer_t *b, int version, const char time_stamp[]);
+int    tws_srv_encode_err_msg(tws_srv_buffer_t *b, int version, int id, int error_code, const char error_string[]);
+/* the order id goes over the wire once: order->o_orderid is not used; 'ost' may be NULL below version 16 */
+int    tws_srv_encode_open_order(tws_srv_buffer_t *b, int version, int order_id, const tr_contract_t *contract, const tr_order_t *order, const tr_order_status_t *ost);
+int    tws_srv_encode_next_valid_id(tws_srv_buffer_t *b, int version, int order_id);
+int    tws_srv_encode_contract_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_details_t *cd);
+int    tws_srv_encode_bond_contract_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_details_t *cd);
+/* the order id is execution->e_orderid */
+int    tws_srv_encode_execution_data(tws_srv_buffer_t *b, int version, int req_id, const tr_contract_t *contract, const tr_execution_t *execution);
+int    tws_srv_encode_market_depth(tws_srv_buffer_t *b, int version, int ticker_id, int position, int operation, int side, double price, int size);
+int    tws_srv_encode_market_depth_l2(tws_srv_buffer_t *b, int version, int ticker_id, int position, const char market_maker[], int operation, int side, double price, int size);
+int    tws_srv_encode_news_bulletins(tws_srv_buffer_t *b, int version, int msgid, int msg_type, const char news_msg[], const char origin_exch[]);
+int    tws_srv_encode_managed_accts(tws_srv_buffer_t *b, int version, const char accounts_list[]);
+int    tws_srv_encode_receive_fa(tws_srv_buffer_t *b, int version, tr_fa_msg_type_t fa_data_type, const char cxml[]);
+
+/*
+historical data: the header with the number of bars that follow, then that many bars; the decoder reports the end of the
+data set after the last one. 'has_gaps' is sent as "true" / "false", 'bar_count' from version 3 on.
+*/
+int    tws_srv_encode_historical_data(tws_srv_buffer_t *b, int version, int req_id, const char completion_from[], const char completion_to[], int bar_count);
+int    tws_srv_encode_historical_bar(tws_srv_buffer_t *b, int version, const char date[], double open, double high, double low, double close, long volume, int bar_count, double wap, int has_gaps);
+
+int    tws_srv_encode_scanner_parameters(tws_srv_buffer_t *b, int version, const char xml[]);
+
+/* scanner data: the header with the number of rows that follow, then that many rows */
+int    tws_srv_encode_scanner_data(tws_srv_buffer_t *b, int version, int ticker_id, int num_elements);
+int    tws_srv_encode_scanner_row(tws_srv_buffer_t *b, int version, int rank, const tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[]);
+
+int    tws_srv_encode_current_time(tws_srv_buffer_t *b, int version, long time);
+int    tws_srv_encode_realtime_bars(tws_srv_buffer_t *b, int version, int req_id, long time, double open, double high, double low, double close, long volume, double wap, int count);
+int    tws_srv_encode_fundamental_data(tws_srv_buffer_t *b, int version, int req_id, const char data[]);
+int    tws_srv_encode_contract_data_end(tws_srv_buffer_t *b, int version, int req_id);
+int    tws_srv_encode_open_order_end(tws_srv_buffer_t *b, int version);
+int    tws_srv_encode_acct_download_end(tws_srv_buffer_t *b, int version, const char acct_name[]);
+int    tws_srv_encode_execution_data_end(tws_srv_buffer_t *b, int version, int req_id);
+int    tws_srv_encode_delta_neutral_validation(tws_srv_buffer_t *b, int version, int req_id, const under_comp_t *und);
+int    tws_srv_encode_tick_snapshot_end(tws_srv_buffer_t *b, int version, int req_id);
+int    tws_srv_encode_market_data_type(tws_srv_buffer_t *b, int version, int req_id, market_data_type_t data_type);
+int    tws_srv_encode_commission_report(tws_srv_buffer_t *b, int version, const tr_commission_report_t *report);
+
+/*
+the value of an RT_VOLUME tick string: "price;size;time;total volume;vwap;single trade flag", time in ms since the epoch.
+A price of DBL_MAX is left empty (no trade). Writes at most 'size' bytes including the terminating NUL and returns 'buf'.
+*/
+char  *tws_srv_format_rt_volume(char *buf, size_t size, const tr_rt_volume_t *rv);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_SRV_ENCODE_H_ */
@@ -0,0 +1,818 @@
+#include "twsapi-uring.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_GROUP    0
+#define OP_RECV         1
+#define OP_SEND         2
+#define OP_CANCEL       3
+#define GEN_MASK        0xffffffu
+
+/* completions carry the connection's slot, its generation (stale ones are of a closed socket) and the operation */
+#define USER_DATA(conn, op) ((unsigned long long)(op) << 56 | (unsigned long long)((conn)->gen & GEN_MASK) << 32 | (conn)->slot)
+
+typedef struct tx_buffer {
+    char *data;
+    unsigned int len, size;
+} tx_buffer_t;
+
+struct tws_uring_conn {
+    tws_uring_t *ring;
+    void *user;
+    int fd;                             /* -1 while not attached */
+    unsigned int slot;
+    unsigned int gen;                   /* bumped by attach and close */
+    int inflight;                       /* operations the kernel is not done with: the memory has to stay */
+    int recv_armed;
+    int paused;                         /* recv stopped, the queue holds its share of the buffers */
+    int send_busy;
+    int rearm;                          /* recv ended for want of buffers, to be armed again when some come back */
+    int eof, error;                     /* of the attached socket, reported once the queue has been taken */
+    int destroyed;
+    int ready;                          /* on a ready list */
+    int carry;                          /* tws_uring_requeue(): its instance holds data, whether or not any is queued */
+    tws_uring_conn_t *next_ready;
+    int q_head, q_tail;                 /* received buffers, linked through ring->buf_next; -1: none */
+    unsigned int q_off;                 /* taken of the head buffer */
+    unsigned int queued;                /* bytes */
+    unsigned int q_count;               /* buffers */
+    tx_buffer_t staged;                 /* transmitted, not yet sent */
+    tx_buffer_t sending;                /* in the kernel's hands */
+    unsigned int sent;                  /* of 'sending' */
+};
+
+struct tws_uring {
+    int fd;
+    void *ring_map;
+    size_t ring_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned int *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+    unsigned int sq_local_tail;
+    unsigned int to_submit;
+    unsigned int *cq_head, *cq_tail, cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *br;       /* provided buffer ring */
+    size_t br_size;
+    unsigned short br_tail;
+    unsigned int buffers, buffer_size;
+    char *buf_mem;
+    int *buf_next;                      /* per buffer: the next one in its connection's queue */
+    unsigned int *buf_len;              /* per buffer: bytes received into it */
+    unsigned int held;                  /* buffers out of the kernel's reach: queued, or being returned */
+    int multishot;                      /* cleared when the kernel rejects multishot recv */
+    int starved;                        /* some connections wait for buffers */
+    unsigned int rearm_from;            /* slot whose recv goes first when they are armed again */
+
+    tws_uring_conn_t **conns;           /* by slot */
+    unsigned int conns_size;
+    unsigned int attached;
+    tws_uring_conn_t *ready_head, *ready_tail;  /* this round of tws_uring_next_ready() */
+    tws_uring_conn_t *next_head, *next_tail;    /* the next round, which tws_uring_wait() starts */
+};
+
+
+static int uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* hand buffer 'bid' (back) to the kernel */
+static void buf_add(tws_uring_t *u, unsigned int bid)
+{
+    struct io_uring_buf *b = &u->br->bufs[u->br_tail & (u->buffers - 1)];
+
+    /* field by field: the ring's tail overlays the 'resv' of the first entry */
+    b->addr = (unsigned long long)(uintptr_t)(u->buf_mem + (size_t)bid * u->buffer_size);
+    b->len = u->buffer_size;
+    b->bid = (unsigned short)bid;
+    u->held--;
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+tws_uring_t *tws_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size)
+{
+    struct io_uring_params p;
+    struct io_uring_buf_reg reg;
+    tws_uring_t *u;
+    char *map;
+    size_t sq_size, cq_size;
+    unsigned int j;
+    int err;
+
+    entries = entries ? entries : TWS_URING_DEFAULT_ENTRIES;
+    buffers = buffers ? buffers : TWS_URING_DEFAULT_BUFFERS;
+    buffer_size = buffer_size ? buffer_size : TWS_URING_DEFAULT_BUFFER_SIZE;
+    if((buffers & (buffers - 1)) || buffers > 32768) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    u = (tws_uring_t *)calloc(1, sizeof *u);
+    if(!u)
+        return NULL;
+    u->fd = -1;
+    u->buffers = buffers;
+    u->buffer_size = buffer_size;
+    u->multishot = 1;
+
+    memset(&p, 0, sizeof p);
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = 4 * entries;
+    u->fd = uring_setup(entries, &p);
+    if(u->fd < 0 && errno == EINVAL) {  /* before 5.19 */
+        memset(&p, 0, sizeof p);
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = 4 * entries;
+        u->fd = uring_setup(entries, &p);
+    }
+    if(u->fd < 0)
+        goto fail;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        errno = ENOSYS;
+        goto fail;
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ring_map_size = sq_size > cq_size ? sq_size : cq_size;
+    u->ring_map = mmap(NULL, u->ring_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if(u->ring_map == MAP_FAILED) {
+        u->ring_map = NULL;
+        goto fail;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if(u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto fail;
+    }
+
+    map = u->ring_map;
+    u->sq_head = (unsigned int *)(map + p.sq_off.head);
+    u->sq_tail = (unsigned int *)(map + p.sq_off.tail);
+    u->sq_array = (unsigned int *)(map + p.sq_off.array);
+    u->sq_mask = *(unsigned int *)(map + p.sq_off.ring_mask);
+    u->sq_entries = p.sq_entries;
+    u->sq_local_tail = *u->sq_tail;
+    u->cq_head = (unsigned int *)(map + p.cq_off.head);
+    u->cq_tail = (unsigned int *)(map + p.cq_off.tail);
+    u->cq_mask = *(unsigned int *)(map + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(map + p.cq_off.cqes);
+
+    /* the buffer ring has to be page aligned: a mapping of its own */
+    u->br_size = buffers * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(u->br == MAP_FAILED) {
+        u->br = NULL;
+        goto fail;
+    }
+    u->buf_mem = (char *)malloc((size_t)buffers * buffer_size);
+    u->buf_next = (int *)malloc(buffers * sizeof *u->buf_next);
+    u->buf_len = (unsigned int *)malloc(buffers * sizeof *u->buf_len);
+    if(!u->buf_mem || !u->buf_next || !u->buf_len) {
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    memset(&reg, 0, sizeof reg);
+    reg.ring_addr = (unsigned long long)(uintptr_t)u->br;
+    reg.ring_entries = buffers;
+    reg.bgid = BUFFER_GROUP;
+    if(uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+        goto fail;
+    u->held = buffers;
+    for(j = 0; j < buffers; j++)
+        buf_add(u, j);
+
+    return u;
+
+fail:
+    err = errno;
+    tws_uring_destroy(u);
+    errno = err;
+    return NULL;
+}
+
+static void free_conn(tws_uring_conn_t *c)
+{
+    c->ring->conns[c->slot] = NULL;
+    free(c->staged.data);
+    free(c->sending.data);
+    free(c);
+}
+
+void tws_uring_destroy(tws_uring_t *u)
+{
+    unsigned int j;
+
+    if(!u)
+        return;
+    /* closing the ring cancels what is still in flight */
+    if(u->fd >= 0)
+        close(u->fd);
+    for(j = 0; j < u->conns_size; j++)
+        if(u->conns[j])
+            free_conn(u->conns[j]);
+    free(u->conns);
+    if(u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if(u->ring_map)
+        munmap(u->ring_map, u->ring_map_size);
+    if(u->br)
+        munmap(u->br, u->br_size);
+    free(u->buf_mem);
+    free(u->buf_next);
+    free(u->buf_len);
+    free(u);
+}
+
+/* a free submission queue entry, cleared; NULL when the queue is full and cannot be submitted */
+static struct io_uring_sqe *get_sqe(tws_uring_t *u)
+{
+    struct io_uring_sqe *sqe;
+    unsigned int idx;
+
+    if(u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if(tws_uring_submit(u) < 0)
+            return NULL;
+        if(u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
+            return NULL;
+    }
+    idx = u->sq_local_tail & u->sq_mask;
+    sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    u->sq_array[idx] = idx;
+    return sqe;
+}
+
+/* make the entry get_sqe() returned visible to the kernel, for the next io_uring_enter() */
+static void push_sqe(tws_uring_t *u)
+{
+    u->sq_local_tail++;
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    u->to_submit++;
+}
+
+static int arm_recv(tws_uring_conn_t *c)
+{
+    struct io_uring_sqe *sqe = get_sqe(c->ring);
+
+    if(!sqe) {
+        c->error = EBUSY;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    if(c->ring->multishot)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    else
+        sqe->len = c->ring->buffer_size;
+    sqe->user_data = USER_DATA(c, OP_RECV);
+    push_sqe(c->ring);
+    c->inflight++;
+    c->recv_armed = 1;
+    return 0;
+}
+
+/* end a multishot recv; its last completion comes without IORING_CQE_F_MORE */
+static void cancel_recv(tws_uring_conn_t *c)
+{
+    struct io_uring_sqe *sqe = get_sqe(c->ring);
+
+    if(!sqe)
+        return;                         /* it goes on then, until the buffers run out */
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = USER_DATA(c, OP_RECV);
+    sqe->user_data = USER_DATA(c, OP_CANCEL);
+    push_sqe(c->ring);
+}
+
+/*
+buffers a connection may hold before its recv is stopped, so that connections which are not being read, while another
+waits for its data in receive(), do not take them all. A recv lands what the socket holds before the stop takes effect,
+so that is no hard limit: a connection which runs out all the same reads its socket directly (direct_recv()).
+*/
+static unsigned int queue_limit(tws_uring_t *u)
+{
+    unsigned int limit = u->buffers / (2 * (u->attached + 1));
+
+    return limit > 2 ? limit : 2;
+}
+
+/* can the recv of the connection be armed (again)? */
+static int can_arm(tws_uring_conn_t *c)
+{
+    return c->fd >= 0 && !c->destroyed && !c->recv_armed && !c->paused && !c->rearm && !c->eof && !c->error;
+}
+
+/* send what is left of 'sending' */
+static int send_rest(tws_uring_conn_t *c)
+{
+    struct io_uring_sqe *sqe = get_sqe(c->ring);
+
+    if(!sqe) {
+        c->error = EBUSY;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->fd;
+    sqe->addr = (unsigned long long)(uintptr_t)(c->sending.data + c->sent);
+    sqe->len = c->sending.len - c->sent;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = USER_DATA(c, OP_SEND);
+    push_sqe(c->ring);
+    c->inflight++;
+    c->send_busy = 1;
+    return 0;
+}
+
+/* 'staged' becomes 'sending': what was transmitted since the last send goes out as one */
+static int start_send(tws_uring_conn_t *c)
+{
+    tx_buffer_t t = c->sending;
+
+    c->sending = c->staged;
+    c->staged = t;
+    c->staged.len = 0;
+    c->sent = 0;
+    return send_rest(c);
+}
+
+/* on the next round: a connection comes round once per round, however much it is given meanwhile */
+static void make_ready(tws_uring_conn_t *c)
+{
+    tws_uring_t *u = c->ring;
+
+    if(c->ready)
+        return;
+    c->ready = 1;
+    c->next_ready = NULL;
+    if(u->next_tail)
+        u->next_tail->next_ready = c;
+    else
+        u->next_head = c;
+    u->next_tail = c;
+}
+
+/* take 'c' off the list 'head' .. 'tail' if it is on it */
+static void unlink_ready(tws_uring_conn_t **head, tws_uring_conn_t **tail, tws_uring_conn_t *c)
+{
+    tws_uring_conn_t **p, *prev = NULL;
+
+    for(p = head; *p && *p != c; p = &(*p)->next_ready)
+        prev = *p;
+    if(!*p)
+        return;
+    *p = c->next_ready;
+    if(*tail == c)
+        *tail = prev;
+}
+
+static void buf_return(tws_uring_t *u, unsigned int bid)
+{
+    unsigned int j;
+
+    buf_add(u, bid);
+    /* not at the first one: the connections would take it and run out again straight away */
+    if(u->starved && u->held <= u->buffers - u->buffers / 4) {
+        u->starved = 0;
+        /* the recvs armed first take the buffers: each time another connection goes first */
+        if(++u->rearm_from >= u->conns_size)
+            u->rearm_from = 0;
+        for(j = 0; j < u->conns_size; j++) {
+            tws_uring_conn_t *c = u->conns[(u->rearm_from + j) % u->conns_size];
+
+            if(c && c->rearm) {
+                c->rearm = 0;
+                if(can_arm(c))
+                    arm_recv(c);
+            }
+        }
+    }
+}
+
+static void drop_queue(tws_uring_conn_t *c)
+{
+    while(c->q_head >= 0) {
+        int bid = c->q_head;
+
+        c->q_head = c->ring->buf_next[bid];
+        buf_return(c->ring, (unsigned int)bid);
+    }
+    c->q_tail = -1;
+    c->q_off = 0;
+    c->queued = 0;
+    c->q_count = 0;
+}
+
+static void complete(tws_uring_t *u, unsigned long long user_data, int res, unsigned int flags)
+{
+    unsigned int slot = (unsigned int)user_data, gen = (unsigned int)(user_data >> 32) & GEN_MASK;
+    int op = (int)(user_data >> 56);
+    int bid = flags & IORING_CQE_F_BUFFER ? (int)(flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    tws_uring_conn_t *c = slot < u->conns_size ? u->conns[slot] : NULL;
+    int current;
+
+    if(bid >= 0)
+        u->held++;
+    if(op == OP_CANCEL)
+        return;
+    if(!c) {
+        if(bid >= 0)
+            buf_add(u, (unsigned int)bid);
+        return;
+    }
+    current = gen == (c->gen & GEN_MASK) && c->fd >= 0 && !c->destroyed;
+
+    if(op == OP_RECV) {
+        int more = (flags & IORING_CQE_F_MORE) != 0;
+
+        if(!more) {
+            c->inflight--;
+            if(gen == (c->gen & GEN_MASK))
+                c->recv_armed = 0;
+        }
+        if(!current) {
+            if(bid >= 0)
+                buf_return(u, (unsigned int)bid);
+        } else if(res > 0 && bid >= 0) {
+            u->buf_len[bid] = (unsigned int)res;
+            u->buf_next[bid] = -1;
+            if(c->q_tail >= 0)
+                u->buf_next[c->q_tail] = bid;
+            else
+                c->q_head = bid;
+            c->q_tail = bid;
+            c->queued += (unsigned int)res;
+            c->q_count++;
+            make_ready(c);
+            if(!c->paused && c->q_count >= queue_limit(u)) {
+                c->paused = 1;
+                if(more)
+                    cancel_recv(c);
+            }
+        } else if(res == 0) {
+            c->eof = 1;
+            make_ready(c);
+        } else if(res == -ENOBUFS) {
+            if(u->held > u->buffers - u->buffers / 4) {
+                c->rearm = 1;
+                u->starved = 1;
+            }                               /* else enough have come back meanwhile */
+        } else if(res == -ECANCELED) {
+            ;                               /* cancel_recv() */
+        } else if(res == -EINVAL && u->multishot) {
+            u->multishot = 0;               /* before 6.0: one recv per buffer */
+        } else if(res < 0) {
+            c->error = -res;
+            make_ready(c);
+        }
+        if(!more && current && can_arm(c))
+            arm_recv(c);
+    } else if(op == OP_SEND) {
+        c->inflight--;
+        c->send_busy = 0;
+        if(current) {
+            if(res <= 0) {
+                c->error = res < 0 ? -res : EPIPE;
+                make_ready(c);
+            } else if((c->sent += (unsigned int)res) < c->sending.len) {
+                send_rest(c);
+                return;
+            }
+        }
+        c->sending.len = 0;
+        c->sent = 0;
+        if(c->fd >= 0 && !c->destroyed && !c->error && c->staged.len)
+            start_send(c);
+    }
+
+    if(c->destroyed && !c->inflight)
+        free_conn(c);
+}
+
+static int reap(tws_uring_t *u)
+{
+    unsigned int head = *u->cq_head, tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+
+    for(; head != tail; head++, n++) {
+        struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+
+        complete(u, cqe->user_data, cqe->res, cqe->flags);
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+int tws_uring_submit(tws_uring_t *u)
+{
+    int r;
+
+    if(!u->to_submit)
+        return 0;
+    r = uring_enter(u->fd, u->to_submit, 0, 0, NULL, 0);
+    if(r < 0)
+        return -1;
+    u->to_submit -= (unsigned int)r;
+    return r;
+}
+
+/* tws_uring_wait() without starting a round: receive() waits for data of its own, in the middle of one */
+static int wait_reap(tws_uring_t *u, int timeout_ms)
+{
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    unsigned int min_complete = 1, flags = IORING_ENTER_GETEVENTS;
+    int r;
+
+    if(timeout_ms == 0 || *u->cq_head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+        min_complete = 0;
+        flags = 0;
+    }
+
+    if(flags && timeout_ms > 0) {
+        memset(&arg, 0, sizeof arg);
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        arg.ts = (unsigned long long)(uintptr_t)&ts;
+        r = uring_enter(u->fd, u->to_submit, min_complete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+    } else if(flags || u->to_submit) {
+        r = uring_enter(u->fd, u->to_submit, min_complete, flags, NULL, 0);
+    } else {
+        r = 0;
+    }
+    if(r < 0 && errno != ETIME)
+        return -1;
+    if(r > 0)
+        u->to_submit -= (unsigned int)r;
+
+    return reap(u);
+}
+
+int tws_uring_wait(tws_uring_t *u, int timeout_ms)
+{
+    int r;
+
+    /* connections which are ready already are not kept waiting */
+    r = wait_reap(u, u->ready_head || u->next_head ? 0 : timeout_ms);
+
+    /* what is left of this round goes first */
+    if(u->next_head) {
+        if(u->ready_tail)
+            u->ready_tail->next_ready = u->next_head;
+        else
+            u->ready_head = u->next_head;
+        u->ready_tail = u->next_tail;
+        u->next_head = u->next_tail = NULL;
+    }
+    return r;
+}
+
+tws_uring_conn_t *tws_uring_next_ready(tws_uring_t *u)
+{
+    tws_uring_conn_t *c;
+
+    while((c = u->ready_head) != NULL) {
+        int carry = c->carry;
+
+        u->ready_head = c->next_ready;
+        if(!u->ready_head)
+            u->ready_tail = NULL;
+        c->ready = 0;
+        c->carry = 0;
+        if(c->fd >= 0 && (c->q_head >= 0 || c->eof || c->error || carry)) {
+            /* a batch need not get to the end of the queue: the rest comes round again in the next round */
+            make_ready(c);
+            return c;
+        }
+    }
+    return NULL;
+}
+
+void tws_uring_requeue(tws_uring_conn_t *c)
+{
+    if(c->fd < 0 || c->destroyed)
+        return;
+    c->carry = 1;
+    make_ready(c);
+}
+
+tws_uring_conn_t *tws_uring_conn_create(tws_uring_t *u, void *user)
+{
+    tws_uring_conn_t *c;
+    unsigned int slot;
+
+    for(slot = 0; slot < u->conns_size; slot++)
+        if(!u->conns[slot])
+            break;
+    if(slot == u->conns_size) {
+        unsigned int size = u->conns_size ? 2 * u->conns_size : 16;
+        tws_uring_conn_t **conns = (tws_uring_conn_t **)realloc(u->conns, size * sizeof *conns);
+
+        if(!conns)
+            return NULL;
+        memset(conns + u->conns_size, 0, (size - u->conns_size) * sizeof *conns);
+        u->conns = conns;
+        u->conns_size = size;
+    }
+
+    c = (tws_uring_conn_t *)calloc(1, sizeof *c);
+    if(!c)
+        return NULL;
+    c->ring = u;
+    c->user = user;
+    c->fd = -1;
+    c->slot = slot;
+    c->q_head = c->q_tail = -1;
+    u->conns[slot] = c;
+    return c;
+}
+
+void tws_uring_conn_destroy(tws_uring_conn_t *c)
+{
+    tws_uring_t *u;
+
+    if(!c)
+        return;
+    u = c->ring;
+    tws_uring_close(c);
+    if(c->ready) {
+        unlink_ready(&u->ready_head, &u->ready_tail, c);
+        unlink_ready(&u->next_head, &u->next_tail, c);
+        c->ready = 0;
+    }
+    c->destroyed = 1;
+    if(!c->inflight)
+        free_conn(c);
+}
+
+void *tws_uring_conn_user(tws_uring_conn_t *c)
+{
+    return c->user;
+}
+
+int tws_uring_attach(tws_uring_conn_t *c, int fd)
+{
+    if(c->fd >= 0 || fd < 0)
+        return -1;
+    c->fd = fd;
+    c->gen++;
+    c->eof = c->error = c->rearm = c->paused = c->recv_armed = c->carry = 0;
+    c->staged.len = 0;
+    c->ring->attached++;
+    return arm_recv(c);
+}
+
+unsigned int tws_uring_pending(tws_uring_conn_t *c)
+{
+    return c->queued;
+}
+
+int tws_uring_transmit(void *conn, const void *buf, unsigned int buflen)
+{
+    tws_uring_conn_t *c = (tws_uring_conn_t *)conn;
+    tx_buffer_t *t = &c->staged;
+
+    if(c->fd < 0 || c->error)
+        return -1;
+    if(t->len + buflen > t->size) {
+        unsigned int size = t->size ? t->size : 4096;
+        char *data;
+
+        while(size < t->len + buflen)
+            size *= 2;
+        data = (char *)realloc(t->data, size);
+        if(!data)
+            return -1;
+        t->data = data;
+        t->size = size;
+    }
+    memcpy(t->data + t->len, buf, buflen);
+    t->len += buflen;
+    return (int)buflen;
+}
+
+int tws_uring_flush(void *conn)
+{
+    tws_uring_conn_t *c = (tws_uring_conn_t *)conn;
+
+    if(c->fd < 0 || c->error)
+        return -1;
+    if(!c->send_busy && c->staged.len)
+        return start_send(c);
+    return 0;
+}
+
+/*
+read the socket itself: the connection's recv has run out of buffers, and they are all queued for connections which are
+not being read while this one waits (e.g. in tws_connect()). Nothing of it is in flight then, so the order holds.
+*/
+static int direct_recv(tws_uring_conn_t *c, void *buf, unsigned int max_bufsize)
+{
+    struct pollfd pfd;
+    ssize_t n;
+
+    if(tws_uring_submit(c->ring) < 0)
+        return -1;
+    for(;;) {
+        n = recv(c->fd, buf, max_bufsize, MSG_DONTWAIT);
+        if(n >= 0)
+            return (int)n;
+        if(errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+        pfd.fd = c->fd;
+        pfd.events = POLLIN;
+        if(poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
+int tws_uring_receive(void *conn, void *buf, unsigned int max_bufsize)
+{
+    tws_uring_conn_t *c = (tws_uring_conn_t *)conn;
+    tws_uring_t *u = c->ring;
+
+    for(;;) {
+        if(c->q_head >= 0) {
+            unsigned int bid = (unsigned int)c->q_head, n = u->buf_len[bid] - c->q_off;
+
+            if(n > max_bufsize)
+                n = max_bufsize;
+            memcpy(buf, u->buf_mem + (size_t)bid * u->buffer_size + c->q_off, n);
+            c->q_off += n;
+            c->queued -= n;
+            if(c->q_off == u->buf_len[bid]) {
+                c->q_head = u->buf_next[bid];
+                if(c->q_head < 0)
+                    c->q_tail = -1;
+                c->q_off = 0;
+                c->q_count--;
+                buf_return(u, bid);
+                if(c->paused && c->q_count <= queue_limit(u) / 2) {
+                    c->paused = 0;
+                    /* while others wait for buffers it waits with them, or it takes those that come back first */
+                    if(u->starved && !c->recv_armed)
+                        c->rearm = 1;
+                    else if(can_arm(c))
+                        arm_recv(c);
+                }
+            }
+            return (int)n;
+        }
+        if(c->error) {
+            errno = c->error;
+            return -1;
+        }
+        if(c->eof)
+            return 0;
+        if(c->fd < 0)
+            return -1;
+        if(c->rearm && !c->recv_armed)
+            return direct_recv(c, buf, max_bufsize);
+        if(wait_reap(u, -1) < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
+int tws_uring_close(void *conn)
+{
+    tws_uring_conn_t *c = (tws_uring_conn_t *)conn;
+
+    if(c->fd >= 0) {
+        /* ends the recv and any send in flight; their completions are of an old generation then */
+        shutdown(c->fd, SHUT_RDWR);
+        close(c->fd);
+        c->fd = -1;
+        c->ring->attached--;
+    }
+    c->gen++;
+    drop_queue(c);
+    c->eof = c->error = c->rearm = c->paused = c->recv_armed = c->carry = 0;
+    c->staged.len = 0;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef TWSAPI_URING_H_
+#define TWSAPI_URING_H_
+
+#include "twsapi.h"
+
+/*
+io_uring transport (linux 5.19 and up, multishot recv from 6.0): transmit(), receive() and flush() callbacks for
+tws_create() that share one ring among any number of instances, so that the traffic of all of them goes in and out of
+the kernel in a few system calls.
+
+Receiving: each connection has a multishot recv armed that lands data in buffers of a provided buffer ring shared by
+all connections; the kernel keeps receiving without being asked again, and the completions of every connection are
+reaped in one go. tws_uring_receive() hands the queued data to the decoder and returns each buffer to the ring once it
+has been used up. It only waits, in io_uring_enter(), when the decoder is in the middle of a message whose rest has not
+arrived yet, or when it is called with nothing queued (tws_connect(), or tws_event_process() outside a dispatch loop).
+A connection that holds its share of the buffers has its recv stopped until it has been read; one that waits in
+receive() while the others hold them all reads its socket directly.
+
+Sending: tws_uring_transmit() collects the bytes of a request and tws_uring_flush() queues them as one send, or, while
+the previous send of the connection is still in flight, leaves them to go out with the next one. Queued sends reach the
+kernel together with the next tws_uring_submit() or tws_uring_wait() - of whichever instance - so requests made in a
+burst for many instances cost one system call.
+
+Usage: one ring per thread, tws_uring_conn_create() per instance, which becomes the instance's 'opaque':
+
+    c = tws_uring_conn_create(ring, my_data);
+    ti = tws_create(c, tws_uring_transmit, tws_uring_receive, tws_uring_flush, my_open, tws_uring_close, NULL, NULL);
+
+where my_open() connects a socket (tws_uring_conn_user(c) gives 'my_data') and hands it over with tws_uring_attach().
+Then, in the thread that owns the ring:
+
+    for(;;) {
+        tws_uring_wait(ring, timeout_ms);
+        while((c = tws_uring_next_ready(ring)) != NULL) {
+            ti = instance of c;
+            n = 0;
+            do tws_event_process(ti); while(++n < 64 && tws_rx_pending(ti) > 0);
+            if(tws_rx_pending(ti) > 0)
+                tws_uring_requeue(c);
+        }
+    }
+
+The inner loop is one round: tws_uring_next_ready() returns each connection with something to deliver once, and each
+gets a batch of at most 64 messages, so that a busy connection cannot hold up the others. Connections which still have
+data queued after their batch, or which receive some meanwhile, come round again in the next round, which
+tws_uring_wait() starts without waiting. A batch may also end with data left in the instance alone: a message that runs
+past the end of a receive buffer makes tws_event_process() take the next one from the queue, and the rest of that one
+is no longer queued. tws_uring_requeue() puts such a connection on the next round all the same; without it the data
+would wait for more to arrive on the connection.
+
+A ring and its connections belong to one thread, including tws_uring_close() through tws_disconnect().
+*/
+
+#ifdef __cplusplus
+namespace tws {
+	extern "C" {
+#endif
+
+typedef struct tws_uring tws_uring_t;
+typedef struct tws_uring_conn tws_uring_conn_t;
+
+#define TWS_URING_DEFAULT_ENTRIES       256     /* submission queue entries; the completion queue gets four times as many */
+#define TWS_URING_DEFAULT_BUFFERS       1024    /* receive buffers shared by all connections, a power of 2 */
+#define TWS_URING_DEFAULT_BUFFER_SIZE   4096
+
+/*
+set up a ring; 0 for any argument takes its default. Returns NULL when the kernel lacks io_uring or provided buffer rings,
+with errno set, so that the caller can fall back to plain sockets.
+*/
+tws_uring_t *tws_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size);
+/* the connections have to be destroyed before */
+void   tws_uring_destroy(tws_uring_t *ring);
+
+/* 'user' is the caller's, e.g. what its open callback needs to connect */
+tws_uring_conn_t *tws_uring_conn_create(tws_uring_t *ring, void *user);
+/* closes the socket if it is still attached; memory the kernel may still write to is released when it is done with it */
+void   tws_uring_conn_destroy(tws_uring_conn_t *conn);
+void  *tws_uring_conn_user(tws_uring_conn_t *conn);
+
+/* from the open callback: start receiving on a connected socket, which the connection owns from now on; returns 0 or -1 */
+int    tws_uring_attach(tws_uring_conn_t *conn, int fd);
+/* bytes received for the connection and not yet taken by receive() */
+unsigned int tws_uring_pending(tws_uring_conn_t *conn);
+
+/* the transport; 'conn' is the tws_uring_conn_t */
+int    tws_uring_transmit(void *conn, const void *buf, unsigned int buflen);
+int    tws_uring_receive(void *conn, void *buf, unsigned int max_bufsize);
+int    tws_uring_flush(void *conn);
+int    tws_uring_close(void *conn);
+
+/* hand the queued sends of all connections to the kernel; returns the number submitted or -1 */
+int    tws_uring_submit(tws_uring_t *ring);
+/*
+submit, then wait up to 'timeout_ms' (-1: no limit, 0: do not wait) for completions and sort them out to their
+connections, and start the next round of tws_uring_next_ready(); it does not wait when that round has connections
+already. Returns the number of completions reaped, or -1 on failure of io_uring_enter() (errno), EINTR included.
+*/
+int    tws_uring_wait(tws_uring_t *ring, int timeout_ms);
+/* the next connection of this round with received data or an end of stream to deliver; NULL at the end of the round */
+tws_uring_conn_t *tws_uring_next_ready(tws_uring_t *ring);
+/* have tws_uring_next_ready() return the connection in the next round, queued data or not: its instance holds some */
+void   tws_uring_requeue(tws_uring_conn_t *conn);
+
+#ifdef __cplusplus
+	}
+}
+#endif
+
+#endif /* TWSAPI_URING_H_ */
@@ -1,5 +1,7 @@
 #define TWSAPI_GLOBALS
 #include "twsapi.h"
+#include "twsapi-capture.h"
+#include "twsapi-internal.h"
 
 #if defined(WINDOWS) || defined(_WIN32)
 #include <string.h>
@@ -23,6 +25,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
 
 #define MAX_TWS_STRINGS 127
 #define WORD_SIZE_IN_BITS (8*sizeof(unsigned long))
@@ -32,6 +36,19 @@
 #define DBL_NOTMAX(d) (fabs((d) - DBL_MAX) > DBL_EPSILON)
 #define IS_EMPTY(str)  (!(str) || ((str)[0] == '\0'))
 #define DEFAULT_RX_BUFFERSIZE  4096
+#define REALTIME_BAR_SECONDS   5    /* TWS only supports 5 second realtime bars */
+#define MAX_BAR_AGGREGATIONS   8    /* max number of higher time frames per realtime bars request */
+#define GREEK_TICK_TYPES       4    /* BID_OPTION, ASK_OPTION, LAST_OPTION, MODEL_OPTION */
+#define GREEKS_ALIGNMENT       64
+#define XML_NAME_MAX           256  /* longer element and attribute names are truncated */
+#define XML_TEXT_MAX           4096 /* text nodes and CDATA are delivered in pieces of up to this size, longer attribute values are truncated */
+#define LONG_STRING_MIN_SIZE   65536 /* first allocation of the long string buffer */
+#define LONG_STRING_KEEP_SIZE  (1024 * 1024) /* default tws_set_long_string_buffer() keep_size */
+#define CAPTURE_BUFFER_SIZE    (256 * 1024) /* stdio buffer of the capture file */
+#define LATENCY_MSG_IDS        64   /* incoming message ids below this are timed by tws_enable_latency_stats() */
+#define SUBSCRIPTIONS_MIN_SIZE 16   /* hash slots of the subscription registry when it is enabled */
+#define IDS_MIN_SIZE           64   /* first allocation of the id allocator's tables */
+#define ID_IN_USE              (-2) /* id_next[] of an allocated id; free ids link to the next free one or -1 */
 
 #if !defined(TRUE)
 #undef FALSE
@@ -48,6 +65,97 @@ typedef struct {
     char str[512]; /* maximum conceivable string length */
 } tws_string_t;
 
+/* one higher time frame bar under construction */
+typedef struct {
+    double open, high, low, close;
+    double wap_volume;              /* sum of wap * volume, for the volume weighted average */
+    double wap;                     /* last reported wap, used when there's no volume */
+    long start;                     /* start of the bar in seconds since the epoch; -1 when no bar is open */
+    long volume;
+    int count;
+    int period;                     /* in seconds */
+} bar_accumulator_t;
+
+/* all higher time frames rolled up from a single realtime bars request */
+typedef struct {
+    int req_id;
+    int num_periods;                /* 0 marks an empty hash slot */
+    bar_accumulator_t acc[MAX_BAR_AGGREGATIONS];
+} bar_aggregation_t;
+
+/* requests kept by the subscription registry to be sent again after a reconnect */
+typedef enum sub_kind {
+    SUB_NONE,
+    /* account wide, ticker_id 0; replayed first and in this order */
+    SUB_MARKET_DATA_TYPE,
+    SUB_ACCOUNT_UPDATES,
+    SUB_NEWS_BULLETINS,
+    SUB_AUTO_OPEN_ORDERS,
+    /* per ticker_id */
+    SUB_MKT_DATA,
+    SUB_MKT_DEPTH,
+    SUB_REALTIME_BARS,
+    SUB_SCANNER
+} sub_kind_t;
+
+/* one request as it went out: its NUL terminated fields, encoded for the server version of that connection */
+typedef struct subscription {
+    char *msg;                      /* NULL marks an empty hash slot */
+    unsigned int len;
+    unsigned int size;
+    int kind;
+    int ticker_id;
+    unsigned int server_version;
+    unsigned int epoch;             /* connection it was last sent on */
+} subscription_t;
+
+typedef struct scanner_row {
+    int conid;
+    int rank;
+} scanner_row_t;
+
+/* previous rows of one scanner subscription, for tws_set_scanner_diff() */
+typedef struct scanner_state {
+    int ticker_id;
+    int count;                      /* rows in prev */
+    int capacity;
+    scanner_row_t *prev;            /* sorted by conid */
+    scanner_row_t *next;            /* list being received */
+    unsigned char *seen;            /* flags for prev rows present in next */
+    void *mem;                      /* prev, next and seen in one block */
+} scanner_state_t;
+
+typedef enum xml_state {
+    XML_TEXT,
+    XML_TAG_OPEN,                   /* after '<' */
+    XML_START_NAME,
+    XML_IN_TAG,                     /* between attributes */
+    XML_EMPTY_TAG,                  /* after '/' in a start tag */
+    XML_ATTR_NAME,
+    XML_ATTR_EQ,
+    XML_ATTR_QUOTE,
+    XML_ATTR_VALUE,
+    XML_END_NAME,
+    XML_MARKUP,                     /* after '<!' */
+    XML_COMMENT,
+    XML_CDATA,
+    XML_DECL,                       /* <!DOCTYPE ...> and friends */
+    XML_PI                          /* <? ... ?> */
+} xml_state_t;
+
+/* incremental XML tokenizer state for tws_set_xml_streaming(), survives receive buffer boundaries */
+typedef struct xml_tokenizer {
+    xml_state_t state;
+    tr_xml_source_t source;
+    char quote;
+    int match;                      /* progress through a terminator like "-->" */
+    int text_blank;                 /* text[] holds whitespace only */
+    size_t name_len, attr_len, text_len;
+    char name[XML_NAME_MAX];
+    char attr[XML_NAME_MAX];
+    char text[XML_TEXT_MAX];        /* text node, CDATA section or attribute value */
+} xml_tokenizer_t;
+
 struct tws_instance {
     void *opaque;
     tws_transmit_func_t *transmit;
@@ -55,6 +163,8 @@ struct tws_instance {
     tws_flush_func_t *flush;
     tws_open_func_t *open;
     tws_close_func_t *close;
+    tws_disconnect_hook_func_t *disconnect_hook; /* see tws_set_disconnect_hook() */
+    void *disconnect_hook_arg;
 
 	tws_transmit_element_func_t *tx_observe;
 	tws_receive_element_func_t *rx_observe;
@@ -68,17 +178,113 @@ struct tws_instance {
     volatile unsigned int connected;
     tws_string_t mempool[MAX_TWS_STRINGS];
     unsigned long bitmask[WORDS_NEEDED(MAX_TWS_STRINGS, WORD_SIZE_IN_BITS)];
+
+    /* optional decoder features; see the tws_set_*() functions */
+    unsigned int historical_columnar: 1;
+    unsigned int rt_volume_decoding: 1;
+    unsigned int scanner_diff: 1;
+    unsigned int chunked_strings: 1;
+    unsigned int latency_stats: 1;
+
+    tr_historical_bars_t hist_bars; /* column views into hist_bars_mem */
+    void *hist_bars_mem;
+    int hist_bars_capacity;
+
+    double *greeks;                 /* GREEK_TICK_TYPES x GREEK_COUNT columns of greeks_stride doubles, 64 byte aligned */
+    void *greeks_mem;
+    int greeks_stride;              /* capacity rounded up to a whole number of cache lines */
+    int greeks_capacity;            /* max_ticker_id + 1 */
+
+    void **id_ctx;                  /* tws_enable_id_allocator(): context by id - id_base, NULL for free ids */
+    int *id_next;                   /* free list in order of release, ID_IN_USE for allocated ids */
+    int id_base;
+    int id_count;                   /* ids handed out at least once */
+    int id_size;                    /* capacity of both tables */
+    int id_free_head, id_free_tail; /* -1 when empty */
+
+    tr_contract_resolution_t *resolve_items; /* running tws_resolve_contracts() batch, NULL when idle */
+    int resolve_count;
+    int resolve_first_req_id;
+    int resolve_window;
+    int resolve_next;               /* next item to request */
+    int resolve_in_flight;
+    int resolve_done;
+
+    xml_tokenizer_t *xml;           /* non-NULL when XML streaming is enabled */
+
+    scanner_state_t *scanners;      /* one per scanner subscription seen in diff mode */
+    int scanners_used;
+    int scanners_size;
+
+    bar_aggregation_t *bar_aggs;    /* open addressing hash table keyed by req_id, linear probing */
+    unsigned int bar_aggs_size;     /* number of slots, a power of 2 */
+    unsigned int bar_aggs_used;
+
+    subscription_t *subs;           /* registry: open addressing hash keyed by kind and ticker_id, linear probing; NULL when disabled */
+    unsigned int subs_size;         /* number of slots, a power of 2 */
+    unsigned int subs_used;
+    unsigned int subs_stale;        /* entries not sent on the current connection yet */
+    unsigned int subs_cursor;       /* slot where tws_resubscribe() goes on */
+    unsigned int subs_pace_sent;    /* requests sent by tws_resubscribe() since subs_pace_start */
+    unsigned long long subs_pace_start; /* monotonic clock at the first tws_resubscribe() of the connection, 0 before */
+    int subs_resync;                /* tws_resubscribe() asks for the open orders first */
+    unsigned int conn_epoch;        /* counts the connections made */
+    int sub_kind;                   /* request being recorded, SUB_NONE when none */
+    int sub_ticker_id;
+    unsigned char *sub_msg;         /* ... and its bytes so far */
+    size_t sub_msg_len, sub_msg_size;
+
+    char *long_str;                 /* reusable buffer for read_line_of_arbitrary_length() */
+    size_t long_str_size;
+    size_t long_str_max;            /* 0: no limit */
+    size_t long_str_keep;           /* shrink back to this size after each message */
+
+    FILE *cap_file;                 /* tws_start_capture(), NULL when not capturing */
+    FILE *cap_index;
+    unsigned long long cap_offset;  /* file offset of the next record */
+    unsigned long long cap_seq;     /* number of the next record */
+    unsigned long long cap_hello;   /* offset of the received handshake of the connection, 0 if not recorded */
+    unsigned long long cap_rx_time;
+    unsigned long long cap_last_time; /* time of the last record written: records are stamped in file order */
+    unsigned char *cap_rx;          /* bytes of the incoming message that have already left buf */
+    size_t cap_rx_len, cap_rx_size;
+    unsigned char *cap_tx;          /* the outgoing message being composed */
+    size_t cap_tx_len, cap_tx_size;
+    unsigned int cap_rx_mark;       /* start of the incoming message's bytes in buf */
+    int cap_in_msg;                 /* an incoming message is being captured */
+    int cap_handshake;              /* tws_connect() in progress */
+
+    tr_io_stats_t stats;            /* tws_get_stats() */
+    unsigned long long rx_consumed; /* bytes received and not left in buf, never reset: message sizes */
+    unsigned int pool_in_use;       /* strings taken from mempool */
+    int rx_in_msg;                  /* a message id has been read and the message is being decoded */
+    int tx_msg_id;                  /* id of the outgoing message being composed, -1 for the handshake */
+    size_t tx_msg_bytes;            /* ... and its size so far */
+
+    tr_latency_histogram_t **latency; /* LATENCY_MSG_IDS entries of LATENCY_PHASE_COUNT histograms, NULL until the id is seen */
+    unsigned long long lat_start;   /* monotonic clock when the message id had been read */
+    unsigned long long lat_decoded; /* ... at the first callback, 0 before */
+    unsigned long long lat_wait;    /* spent in receive() since lat_start */
+    int lat_in_msg;                 /* the message being processed is timed */
 };
 
 static int read_double(tws_instance_t *ti, double *val);
+static void resolve_contract_match(tws_instance_t *ti, int req_id, int conid);
+static void resolve_contract_done(tws_instance_t *ti, int req_id, int error_code);
 static int read_double_max(tws_instance_t *ti, double *val);
 static int read_long(tws_instance_t *ti, long *val);
 static int read_int(tws_instance_t *ti, int *val);
 static int read_int_max(tws_instance_t *ti, int *val);
 static int read_line(tws_instance_t *ti, char *line, size_t *len);
 static int read_line_of_arbitrary_length(tws_instance_t *ti, char **val, size_t initial_space);
+static void release_long_string(tws_instance_t *ti);
+typedef void read_sink_func_t(tws_instance_t *ti, void *arg, const char *data, size_t len, int is_last);
+static int read_line_streamed(tws_instance_t *ti, read_sink_func_t *sink, void *arg);
 
 static void reset_io_buffers(tws_instance_t *ti);
+static void record_subscription(tws_instance_t *ti);
+static void drop_subscription(tws_instance_t *ti, int kind, int ticker_id);
+static unsigned long long monotonic_ns(void);
 
 /* access to these strings is single threaded
  * replace plain bit ops with atomic test_and_set_bit/clear_bit + memory barriers
@@ -100,6 +306,8 @@ static char *alloc_string(tws_instance_t *ti)
         bits = 1UL << (j & (WORD_SIZE_IN_BITS - 1));
         if(!(ti->bitmask[index] & bits)) {
             ti->bitmask[index] |= bits;
+            if(++ti->pool_in_use > ti->stats.st_pool_high_water)
+                ti->stats.st_pool_high_water = ti->pool_in_use;
             // and initially start with an empty string value (aids legibility while debugging):
             ti->mempool[j].str[0] = 0;
             return ti->mempool[j].str;
@@ -107,6 +315,7 @@ static char *alloc_string(tws_instance_t *ti)
     }
 
     TWS_DEBUG_PRINTF((ti->opaque, "alloc_string: ran out of strings, will crash shortly\n"));
+    ti->stats.st_pool_exhausted++;
 
     // close the connection when we run out of pool memory to prevent the currently processed message from making it through to the handler
     tws_disconnect(ti);
@@ -126,6 +335,8 @@ static void free_string(tws_instance_t *ti, const void *ptr)
 			unsigned int index = j / WORD_SIZE_IN_BITS;
 			unsigned long bits = 1UL << (j & (WORD_SIZE_IN_BITS - 1));
 
+			if (ti->bitmask[index] & bits)
+				ti->pool_in_use--;
 			ti->bitmask[index] &= ~bits;
 		}
     }
@@ -351,10 +562,20 @@ static void init_contract_details(tws_instance_t *ti, tr_contract_details_t *cd)
     cd->d_timezone_id = alloc_string(ti);
     cd->d_trading_hours = alloc_string(ti);
     cd->d_liquid_hours = alloc_string(ti);
+    cd->d_ev_rule = alloc_string(ti);
 }
 
 static void destroy_contract_details(tws_instance_t *ti, tr_contract_details_t *cd)
 {
+    if(cd->d_sec_id_list) {
+        int j;
+
+        for(j = 0; j < cd->d_sec_id_list_count; j++)
+            tws_destroy_tag_value(ti, &cd->d_sec_id_list[j]);
+        free(cd->d_sec_id_list);
+    }
+
+    free_string(ti, cd->d_ev_rule);
     free_string(ti, cd->d_liquid_hours);
     free_string(ti, cd->d_trading_hours);
     free_string(ti, cd->d_timezone_id);
@@ -391,10 +612,12 @@ static void init_execution(tws_instance_t *ti, tr_execution_t *exec)
     exec->e_exchange = alloc_string(ti);
     exec->e_side = alloc_string(ti);
     exec->e_orderref = alloc_string(ti);
+    exec->e_ev_rule = alloc_string(ti);
 }
 
 static void destroy_execution(tws_instance_t *ti, tr_execution_t *exec)
 {
+    free_string(ti, exec->e_ev_rule);
     free_string(ti, exec->e_orderref);
     free_string(ti, exec->e_side);
     free_string(ti, exec->e_exchange);
@@ -523,6 +746,14 @@ void tws_destroy_under_comp(tws_instance_t *ti, under_comp_t *u)
 
 
 
+/* guard of the event_*() calls of the decoder: the first one of a message marks the end of decoding for the latency statistics */
+static int can_deliver(tws_instance_t *ti)
+{
+    if(ti->lat_in_msg && !ti->lat_decoded)
+        ti->lat_decoded = monotonic_ns();
+    return ti->connected;
+}
+
 static void receive_tick_price(tws_instance_t *ti)
 {
     double price;
@@ -542,7 +773,7 @@ static void receive_tick_price(tws_instance_t *ti)
     if(version >= 3)
         read_int(ti, &ival), can_auto_execute = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_tick_price(ti->opaque, ticker_id, tick_type, price, can_auto_execute);
 
     if(version >= 2) {
@@ -554,7 +785,7 @@ static void receive_tick_price(tws_instance_t *ti)
         }
 
         if(size_tick_type != TICK_UNDEFINED)
-            if(ti->connected)
+            if(can_deliver(ti))
                 event_tick_size(ti->opaque, ticker_id, size_tick_type, size);
     }
 }
@@ -571,7 +802,7 @@ static void receive_tick_size(tws_instance_t *ti)
     read_int(ti, &ival), tick_type = (tr_tick_type_t)ival;
     read_int(ti, &ival), size = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_tick_size(ti->opaque, ticker_id, tick_type, size);
 }
 
@@ -628,7 +859,22 @@ static void receive_tick_option_computation(tws_instance_t *ti)
         }
     }
 
-    if(ti->connected)
+    if(ti->greeks && ticker_id >= 0 && ticker_id < ti->greeks_capacity
+       && tick_type >= BID_OPTION && tick_type <= MODEL_OPTION) {
+        double *row = ti->greeks + (size_t)(tick_type - BID_OPTION) * GREEK_COUNT * ti->greeks_stride + ticker_id;
+        size_t stride = (size_t)ti->greeks_stride;
+
+        row[GREEK_IMPLIED_VOL * stride] = implied_vol;
+        row[GREEK_DELTA * stride] = delta;
+        row[GREEK_OPT_PRICE * stride] = opt_price;
+        row[GREEK_PV_DIVIDEND * stride] = pv_dividend;
+        row[GREEK_GAMMA * stride] = gamma;
+        row[GREEK_VEGA * stride] = vega;
+        row[GREEK_THETA * stride] = theta;
+        row[GREEK_UND_PRICE * stride] = und_price;
+    }
+
+    if(can_deliver(ti))
         event_tick_option_computation(ti->opaque, ticker_id, tick_type, implied_vol, delta, opt_price, pv_dividend, gamma, vega, theta, und_price);
 }
 
@@ -642,10 +888,113 @@ static void receive_tick_generic(tws_instance_t *ti)
     read_int(ti, &ival), ticker_id = ival;
     read_int(ti, &ival), tick_type = (tr_tick_type_t)ival;
     read_double(ti, &value);
-    if(ti->connected)
+    if(can_deliver(ti))
         event_tick_generic(ti->opaque, ticker_id, tick_type, value);
 }
 
+/*
+parse one ';' terminated decimal field of an RT_VOLUME string; the common case (at most 15 significant
+digits, no exponent) is converted with a single exact division, which yields the same result as strtod().
+
+Returns the position beyond the field separator or NULL on a malformed or unterminated field; *empty is set for zero
+length fields.
+*/
+static const char *parse_rt_volume_number(const char *s, double *val, int *empty)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *p = s;
+    unsigned long long mantissa = 0;
+    int digits = 0, decimals = -1, negative = 0;
+
+    if(*p == '-')
+        negative = 1, p++;
+
+    for(;; p++) {
+        unsigned int d = (unsigned int)(*p - '0');
+
+        if(d < 10) {
+            mantissa = mantissa * 10 + d;
+            digits++;
+            if(decimals >= 0)
+                decimals++;
+        } else if(*p == '.' && decimals < 0) {
+            decimals = 0;
+        } else {
+            break;
+        }
+    }
+
+    if(*p != ';' && *p != '\0') {
+        /* exponent or garbage: let the C library sort it out */
+        char buf[64], *end;
+        size_t len = strcspn(s, ";");
+
+        if(len >= sizeof(buf))
+            return NULL;
+        memcpy(buf, s, len);
+        buf[len] = '\0';
+        *val = strtod(buf, &end);
+        if(*end != '\0')
+            return NULL;
+        *empty = 0;
+        p = s + len;
+    } else {
+        *empty = (p == s);
+        if(digits > 15 || decimals > 22) {
+            *val = strtod(s, NULL);
+        } else {
+            *val = (double)mantissa;
+            if(decimals > 0)
+                *val /= pow10[decimals];
+            if(negative)
+                *val = -*val;
+        }
+    }
+
+    return *p == ';' ? p + 1 : NULL;
+}
+
+/* returns 0 on success, -1 when the string is not a valid RT_VOLUME tick, e.g. one cut short */
+static int parse_rt_volume(const char *s, tr_rt_volume_t *rv)
+{
+    double size, time, total_volume;
+    int empty;
+
+    s = parse_rt_volume_number(s, &rv->rv_price, &empty);
+    if(!s)
+        return -1;
+    if(empty)
+        rv->rv_price = DBL_MAX;
+    s = parse_rt_volume_number(s, &size, &empty);
+    if(!s)
+        return -1;
+    s = parse_rt_volume_number(s, &time, &empty);
+    if(!s || empty)
+        return -1;
+    s = parse_rt_volume_number(s, &total_volume, &empty);
+    if(!s)
+        return -1;
+    s = parse_rt_volume_number(s, &rv->rv_vwap, &empty);
+    if(!s)
+        return -1;
+
+    /* the last field has no separator; "true" or "false" */
+    if(s[0] == 't' || s[0] == 'T' || s[0] == '1')
+        rv->rv_single_trade = 1;
+    else if(s[0] == 'f' || s[0] == 'F' || s[0] == '0')
+        rv->rv_single_trade = 0;
+    else
+        return -1;
+
+    rv->rv_size = (long)size;
+    rv->rv_time = (long long)time;
+    rv->rv_total_volume = (long)total_volume;
+    return 0;
+}
+
 static void receive_tick_string(tws_instance_t *ti)
 {
     char *str;
@@ -660,12 +1009,16 @@ static void receive_tick_string(tws_instance_t *ti)
     ticker_value = str = alloc_string(ti);
     read_line_of_arbitrary_length(ti, &ticker_value, sizeof(tws_string_t));
 
-    if(ti->connected) {
-        event_tick_string(ti->opaque, ticker_id, tick_type, ticker_value);
+    if(can_deliver(ti)) {
+        tr_rt_volume_t rv;
+
+        if(tick_type == RT_VOLUME && ti->rt_volume_decoding && ticker_value && !parse_rt_volume(ticker_value, &rv))
+            event_tick_rt_volume(ti->opaque, ticker_id, &rv);
+        else
+            event_tick_string(ti->opaque, ticker_id, tick_type, ticker_value);
     }
 
-    if (ticker_value != str)
-        free(ticker_value);
+    release_long_string(ti);
     free_string(ti, str);
 }
 
@@ -690,7 +1043,7 @@ static void receive_tick_efp(tws_instance_t *ti)
     read_double(ti, &dividend_impact);
     read_double(ti, &dividends_to_expiry);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_tick_efp(ti->opaque, ticker_id, tick_type, basis_points, formatted_basis_points, implied_futures_price, hold_days, future_expiry, dividend_impact, dividends_to_expiry);
 
     free_string(ti, future_expiry);
@@ -727,7 +1080,7 @@ static void receive_order_status(tws_instance_t *ti)
         lval = sizeof(tws_string_t), read_line(ti, why_held, &lval);
     }
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_order_status(ti->opaque, id, status, filled, remaining,
                            avg_fill_price, permid, parentid, last_fill_price, clientid, why_held);
 
@@ -750,7 +1103,7 @@ static void receive_acct_value(tws_instance_t *ti)
     if(version >= 2)
         lval = sizeof(tws_string_t), read_line(ti, account_name, &lval);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_update_account_value(ti->opaque, key, val, cur, account_name);
 
     free_string(ti, account_name);
@@ -806,7 +1159,7 @@ static void receive_portfolio_value(tws_instance_t *ti)
     if(version == 6 && ti->server_version == 39)
         lval = sizeof(tws_string_t), read_line(ti, contract.c_primary_exch, &lval);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_update_portfolio(ti->opaque, &contract, position,
                                market_price, market_value, average_cost,
                                unrealized_pnl, realized_pnl, account_name);
@@ -824,7 +1177,7 @@ static void receive_acct_update_time(tws_instance_t *ti)
     read_int(ti, &ival); /* version unused */
     lval = sizeof(tws_string_t), read_line(ti, timestamp, &lval);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_update_account_time(ti->opaque, timestamp);
 
     free_string(ti, timestamp);
@@ -845,9 +1198,12 @@ static void receive_err_msg(tws_instance_t *ti)
 
     lval = sizeof(tws_string_t), read_line(ti, msg, &lval);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_error(ti->opaque, id, error_code, msg);
 
+    if(ti->resolve_items)
+        resolve_contract_done(ti, id, error_code);
+
     free_string(ti, msg);
 }
 
@@ -1025,12 +1381,12 @@ static void receive_open_order(tws_instance_t *ti)
     }
                 
     if (version >= 29) {
-        read_int(ti, &ival); order.o_combo_legs_count = ival;
-        if (order.o_combo_legs_count > 0) {
+        read_int(ti, &ival); contract.c_num_combolegs = ival;
+        if (contract.c_num_combolegs > 0) {
 			int j;
 
-            contract.c_comboleg = (tr_comboleg_t *)calloc(order.o_combo_legs_count, sizeof(*contract.c_comboleg));
-            for (j = 0; j < order.o_combo_legs_count; j++) {
+            contract.c_comboleg = (tr_comboleg_t *)calloc(contract.c_num_combolegs, sizeof(*contract.c_comboleg));
+            for (j = 0; contract.c_comboleg && j < contract.c_num_combolegs; j++) {
 				tr_comboleg_t *leg = &contract.c_comboleg[j];
 				
 				tws_init_tr_comboleg(ti, leg);
@@ -1050,7 +1406,7 @@ static void receive_open_order(tws_instance_t *ti)
 			int j;
 
             order.o_combo_legs = (tr_order_combo_leg_t *)calloc(order.o_combo_legs_count, sizeof(*order.o_combo_legs));
-            for (j = 0; j < order.o_combo_legs_count; j++) {
+            for (j = 0; order.o_combo_legs && j < order.o_combo_legs_count; j++) {
 				tr_order_combo_leg_t *leg = &order.o_combo_legs[j];
 
 				read_double_max(ti, &leg->cl_price);
@@ -1165,9 +1521,18 @@ static void receive_open_order(tws_instance_t *ti)
         lval = sizeof(tws_string_t); read_line(ti, ost.ost_warning_text, &lval);
     }
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_open_order(ti->opaque, order.o_orderid, &contract, &order, &ost);
 
+    /* the leg arrays are not owned by tws_destroy_contract() / tws_destroy_order(): callers build them */
+    if(contract.c_comboleg) {
+        int j;
+
+        for(j = 0; j < contract.c_num_combolegs; j++)
+            tws_destroy_tr_comboleg(ti, &contract.c_comboleg[j]);
+        free(contract.c_comboleg);
+    }
+    free(order.o_combo_legs);
     destroy_order_status(ti, &ost);
     tws_destroy_order(ti, &order);
     tws_destroy_contract(ti, &contract);
@@ -1179,7 +1544,7 @@ static void receive_next_valid_id(tws_instance_t *ti)
 
     read_int(ti, &ival); /* version */
     read_int(ti, &ival); /* orderid */
-    if(ti->connected)
+    if(can_deliver(ti))
         event_next_valid_id(ti->opaque, /*orderid*/ ival);
 }
 
@@ -1256,9 +1621,12 @@ static void receive_contract_data(tws_instance_t *ti)
 		}
 	}
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_contract_details(ti->opaque, req_id, &cdetails);
 
+    if(ti->resolve_items)
+        resolve_contract_match(ti, req_id, cdetails.d_summary.c_conid);
+
     destroy_contract_details(ti, &cdetails);
 }
 
@@ -1331,9 +1699,12 @@ static void receive_bond_contract_data(tws_instance_t *ti)
 		}
 	}
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_bond_contract_details(ti->opaque, req_id, &cdetails);
 
+    if(ti->resolve_items)
+        resolve_contract_match(ti, req_id, cdetails.d_summary.c_conid);
+
     destroy_contract_details(ti, &cdetails);
 }
 
@@ -1401,7 +1772,7 @@ static void receive_execution_data(tws_instance_t *ti)
 		read_double(ti, &exec.e_ev_multiplier);
 	}
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_exec_details(ti->opaque, req_id, &contract, &exec);
 
     tws_destroy_contract(ti, &contract);
@@ -1421,7 +1792,7 @@ static void receive_market_depth(tws_instance_t *ti)
     read_double(ti, &price);
     read_int(ti, &ival), size = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_update_mkt_depth(ti->opaque, id, position, operation,
                                side, price, size);
 }
@@ -1443,7 +1814,7 @@ static void receive_market_depth_l2(tws_instance_t *ti)
     read_double(ti, &price);
     read_int(ti, &ival), size = ival;
 
-    if(ti->connected) {
+    if(can_deliver(ti)) {
         event_update_mkt_depth_l2(ti->opaque, id, position, mkt_maker,
                                   operation, side, price, size);
     }
@@ -1451,6 +1822,30 @@ static void receive_market_depth_l2(tws_instance_t *ti)
     free_string(ti, mkt_maker);
 }
 
+/* read_sink_func_t implementations for tws_set_chunked_strings(); data == NULL ends a string cut short by the connection */
+static void news_bulletin_chunk(tws_instance_t *ti, void *arg, const char *data, size_t len, int is_last)
+{
+    const int *ids = (const int *)arg; /* msgid, msg_type */
+
+    /* the last call waits for the originating exchange which follows the message */
+    if(!data)
+        event_update_news_bulletin_chunk(ti->opaque, ids[0], ids[1], NULL, 0, 1, NULL);
+    else if(len && can_deliver(ti))
+        event_update_news_bulletin_chunk(ti->opaque, ids[0], ids[1], data, (unsigned int)len, 0, NULL);
+}
+
+static void fa_chunk(tws_instance_t *ti, void *arg, const char *data, size_t len, int is_last)
+{
+    if(!data || can_deliver(ti))
+        event_receive_fa_chunk(ti->opaque, *(const tr_fa_msg_type_t *)arg, data, (unsigned int)len, is_last);
+}
+
+static void fundamental_data_chunk(tws_instance_t *ti, void *arg, const char *data, size_t len, int is_last)
+{
+    if(!data || can_deliver(ti))
+        event_fundamental_data_chunk(ti->opaque, *(const int *)arg, data, (unsigned int)len, is_last);
+}
+
 static void receive_news_bulletins(tws_instance_t *ti)
 {
     char *msg, *originating_exch, *str;
@@ -1461,19 +1856,32 @@ static void receive_news_bulletins(tws_instance_t *ti)
     read_int(ti, &ival), newsmsgid = ival;
     read_int(ti, &ival), newsmsgtype = ival;
 
+    if(ti->chunked_strings) {
+        int ids[2];
+
+        ids[0] = newsmsgid, ids[1] = newsmsgtype;
+        read_line_streamed(ti, news_bulletin_chunk, ids);
+
+        originating_exch = alloc_string(ti);
+        lval = sizeof(tws_string_t), read_line(ti, originating_exch, &lval);
+        if(can_deliver(ti))
+            event_update_news_bulletin_chunk(ti->opaque, newsmsgid, newsmsgtype, "", 0, 1, originating_exch);
+        free_string(ti, originating_exch);
+        return;
+    }
+
     msg = str = alloc_string(ti);
     read_line_of_arbitrary_length(ti, &msg, sizeof(tws_string_t)); /* news message */
 
     originating_exch = alloc_string(ti);
     lval = sizeof(tws_string_t), read_line(ti, originating_exch, &lval);
 
-    if(ti->connected) {
+    if(can_deliver(ti)) {
         event_update_news_bulletin(ti->opaque, newsmsgid, newsmsgtype,
                                    msg, originating_exch);
     }
 
-    if (msg != str)
-        free(msg);
+    release_long_string(ti);
     free_string(ti, str);
     free_string(ti, originating_exch);
 }
@@ -1487,12 +1895,215 @@ static void receive_managed_accts(tws_instance_t *ti)
     read_int(ti, &ival); /*version*/
     lval = sizeof(tws_string_t), read_line(ti, acct_list, &lval); /* accounts list */
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_managed_accounts(ti->opaque, acct_list);
 
     free_string(ti, acct_list);
 }
 
+static void xml_append(char *buf, size_t *len, size_t max, char c)
+{
+    if(*len < max - 1)
+        buf[(*len)++] = c;
+}
+
+static void xml_flush_text(tws_instance_t *ti, xml_tokenizer_t *x)
+{
+    if(x->text_len && !x->text_blank && can_deliver(ti)) {
+        x->text[x->text_len] = '\0';
+        event_xml_text(ti->opaque, x->source, x->text, (int)x->text_len);
+    }
+    x->text_len = 0;
+    x->text_blank = 1;
+}
+
+static void xml_text_char(tws_instance_t *ti, xml_tokenizer_t *x, char c)
+{
+    if(x->text_len == XML_TEXT_MAX - 1)
+        xml_flush_text(ti, x);
+    x->text[x->text_len++] = c;
+    if(!isspace((unsigned char)c))
+        x->text_blank = 0;
+}
+
+static void xml_start_element(tws_instance_t *ti, xml_tokenizer_t *x)
+{
+    x->name[x->name_len] = '\0';
+    if(can_deliver(ti))
+        event_xml_start_element(ti->opaque, x->source, x->name);
+}
+
+static void xml_end_element(tws_instance_t *ti, xml_tokenizer_t *x)
+{
+    x->name[x->name_len] = '\0';
+    if(can_deliver(ti))
+        event_xml_end_element(ti->opaque, x->source, x->name);
+}
+
+static void xml_begin(xml_tokenizer_t *x, tr_xml_source_t source)
+{
+    x->state = XML_TEXT;
+    x->source = source;
+    x->match = 0;
+    x->text_blank = 1;
+    x->name_len = x->attr_len = x->text_len = 0;
+}
+
+/* read_sink_func_t: advance the tokenizer over one piece of the document */
+static void xml_feed(tws_instance_t *ti, void *arg, const char *data, size_t len, int is_last)
+{
+    xml_tokenizer_t *x = (xml_tokenizer_t *)arg;
+    const char *end = data + len;
+
+    while(data < end) {
+        char c = *data++;
+
+        switch(x->state) {
+        case XML_TEXT:
+            if(c == '<') {
+                xml_flush_text(ti, x);
+                x->state = XML_TAG_OPEN;
+            } else {
+                xml_text_char(ti, x, c);
+            }
+            break;
+
+        case XML_TAG_OPEN:
+            x->name_len = x->attr_len = 0;
+            x->match = 0;
+            if(c == '/')
+                x->state = XML_END_NAME;
+            else if(c == '!')
+                x->state = XML_MARKUP;
+            else if(c == '?')
+                x->state = XML_PI;
+            else
+                x->name[x->name_len++] = c, x->state = XML_START_NAME;
+            break;
+
+        case XML_START_NAME:
+            if(c == '>' || c == '/' || isspace((unsigned char)c)) {
+                xml_start_element(ti, x);
+                x->state = c == '>' ? XML_TEXT : c == '/' ? XML_EMPTY_TAG : XML_IN_TAG;
+            } else {
+                xml_append(x->name, &x->name_len, XML_NAME_MAX, c);
+            }
+            break;
+
+        case XML_IN_TAG:
+            if(c == '>')
+                x->state = XML_TEXT;
+            else if(c == '/')
+                x->state = XML_EMPTY_TAG;
+            else if(!isspace((unsigned char)c))
+                x->attr_len = 0, x->attr[x->attr_len++] = c, x->state = XML_ATTR_NAME;
+            break;
+
+        case XML_EMPTY_TAG:
+            if(c == '>') {
+                xml_end_element(ti, x);
+                x->state = XML_TEXT;
+            }
+            break;
+
+        case XML_ATTR_NAME:
+            if(c == '=')
+                x->state = XML_ATTR_QUOTE;
+            else if(isspace((unsigned char)c))
+                x->state = XML_ATTR_EQ;
+            else
+                xml_append(x->attr, &x->attr_len, XML_NAME_MAX, c);
+            break;
+
+        case XML_ATTR_EQ:
+            if(c == '=')
+                x->state = XML_ATTR_QUOTE;
+            break;
+
+        case XML_ATTR_QUOTE:
+            if(c == '"' || c == '\'') {
+                x->quote = c;
+                x->text_len = 0;
+                x->state = XML_ATTR_VALUE;
+            }
+            break;
+
+        case XML_ATTR_VALUE:
+            if(c != x->quote) {
+                xml_append(x->text, &x->text_len, XML_TEXT_MAX, c);
+                break;
+            }
+            x->attr[x->attr_len] = '\0';
+            x->text[x->text_len] = '\0';
+            if(can_deliver(ti))
+                event_xml_attribute(ti->opaque, x->source, x->attr, x->text);
+            x->text_len = 0;
+            x->state = XML_IN_TAG;
+            break;
+
+        case XML_END_NAME:
+            if(c == '>') {
+                xml_end_element(ti, x);
+                x->state = XML_TEXT;
+            } else if(!isspace((unsigned char)c)) {
+                xml_append(x->name, &x->name_len, XML_NAME_MAX, c);
+            }
+            break;
+
+        case XML_MARKUP:
+            /* tell "<!--" and "<![CDATA[" apart from declarations */
+            x->attr[x->attr_len++] = c;
+            if(x->attr_len == 2 && !memcmp(x->attr, "--", 2)) {
+                x->state = XML_COMMENT;
+            } else if(x->attr_len == 7 && !memcmp(x->attr, "[CDATA[", 7)) {
+                x->state = XML_CDATA;
+            } else if(memcmp(x->attr, "--", x->attr_len < 2 ? x->attr_len : 2)
+                      && memcmp(x->attr, "[CDATA[", x->attr_len < 7 ? x->attr_len : 7)) {
+                x->state = c == '>' ? XML_TEXT : XML_DECL;
+            }
+            break;
+
+        case XML_COMMENT:
+            if(c == '>' && x->match >= 2)
+                x->state = XML_TEXT;
+            x->match = c == '-' ? x->match + 1 : 0;
+            break;
+
+        case XML_CDATA:
+            if(c == ']') {
+                x->match++;
+            } else if(c == '>' && x->match >= 2) {
+                for(; x->match > 2; x->match--)
+                    xml_text_char(ti, x, ']');
+                x->match = 0;
+                x->state = XML_TEXT;
+            } else {
+                for(; x->match > 0; x->match--)
+                    xml_text_char(ti, x, ']');
+                xml_text_char(ti, x, c);
+            }
+            break;
+
+        case XML_DECL:
+            if(c == '>')
+                x->state = XML_TEXT;
+            break;
+
+        case XML_PI:
+            if(c == '>' && x->match)
+                x->state = XML_TEXT;
+            x->match = c == '?';
+            break;
+        }
+    }
+
+    if(is_last) {
+        xml_flush_text(ti, x);
+        if(can_deliver(ti))
+            event_xml_end_document(ti->opaque, x->source);
+    }
+}
+
 static void receive_fa(tws_instance_t *ti)
 {
     char *str;
@@ -1503,18 +2114,151 @@ static void receive_fa(tws_instance_t *ti)
     read_int(ti, &ival); /*version*/
     read_int(ti, &ival), fadata_type = (tr_fa_msg_type_t)ival;
 
+    if(ti->xml) {
+        xml_begin(ti->xml, (tr_xml_source_t)fadata_type);
+        read_line_streamed(ti, xml_feed, ti->xml);
+        return;
+    }
+
+    if(ti->chunked_strings) {
+        read_line_streamed(ti, fa_chunk, &fadata_type);
+        return;
+    }
+
     xml = str = alloc_string(ti);
     read_line_of_arbitrary_length(ti, &xml, sizeof(tws_string_t)); /* xml */
 
-    if(ti->connected) {
+    if(can_deliver(ti)) {
         event_receive_fa(ti->opaque, fadata_type, xml);
     }
 
-    if (xml != str)
-        free(xml);
+    release_long_string(ti);
     free_string(ti, str);
 }
 
+long tws_days_from_civil(int y, int m, int d)
+{
+    long era;
+    int yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097L + doe - 719468L;
+}
+
+/*
+convert a HISTORICAL_DATA bar date to seconds since the epoch. Accepts both format_date styles:
+
+    1: "yyyymmdd  hh:mm:ss" (intraday bars) or "yyyymmdd" (daily and larger bars)
+    2: "nnnnnnnnnn" (seconds since 1970-01-01 00:00:00 GMT)
+
+Returns -1 when the string cannot be parsed.
+*/
+static long parse_bar_time(const char *s)
+{
+    long val = 0;
+    int digits = 0;
+    int y, mo, d, hh = 0, mm = 0, ss = 0;
+
+    while(*s == ' ')
+        s++;
+    for(; *s >= '0' && *s <= '9'; s++, digits++)
+        val = val * 10 + (*s - '0');
+
+    if(digits == 0)
+        return -1;
+    if(digits != 8 || (*s != '\0' && *s != ' '))
+        return (*s == '\0' ? val : -1);
+
+    y = (int)(val / 10000);
+    mo = (int)(val / 100 % 100);
+    d = (int)(val % 100);
+
+    while(*s == ' ')
+        s++;
+    if(*s != '\0') {
+        if(sscanf(s, "%d:%d:%d", &hh, &mm, &ss) < 2)
+            return -1;
+    }
+
+    return tws_days_from_civil(y, mo, d) * 86400L + hh * 3600L + mm * 60L + ss;
+}
+
+/* make sure the historical bar columns can hold at least 'count' bars; returns 0 on success, -1 on heap alloc failure */
+static int reserve_historical_bars(tws_instance_t *ti, int count)
+{
+    tr_historical_bars_t *hb = &ti->hist_bars;
+    unsigned char *mem;
+    size_t cap;
+
+    if(count <= ti->hist_bars_capacity)
+        return 0;
+
+    cap = ti->hist_bars_capacity * 2;
+    if(cap < (size_t)count)
+        cap = count;
+    if(cap < 64)
+        cap = 64;
+
+    /* one block for all columns, ordered by element size to keep every column properly aligned.
+       The old content is not preserved: columns are refilled for every message. */
+    mem = malloc(cap * (5 * sizeof(double) + 2 * sizeof(long) + sizeof(int) + 1));
+    if(!mem)
+        return -1;
+    free(ti->hist_bars_mem);
+    ti->hist_bars_mem = mem;
+    ti->hist_bars_capacity = (int)cap;
+
+    hb->hb_open = (double *)mem;
+    hb->hb_high = hb->hb_open + cap;
+    hb->hb_low = hb->hb_high + cap;
+    hb->hb_close = hb->hb_low + cap;
+    hb->hb_wap = hb->hb_close + cap;
+    hb->hb_time = (long *)(hb->hb_wap + cap);
+    hb->hb_volume = hb->hb_time + cap;
+    hb->hb_bar_count = (int *)(hb->hb_volume + cap);
+    hb->hb_has_gaps = (unsigned char *)(hb->hb_bar_count + cap);
+    return 0;
+}
+
+static void receive_historical_data_columns(tws_instance_t *ti, int version, int req_id, int item_count, char *date, char *has_gaps)
+{
+    tr_historical_bars_t *hb = &ti->hist_bars;
+    size_t lval;
+    int j;
+
+    if(item_count < 0 || reserve_historical_bars(ti, item_count)) {
+        TWS_DEBUG_PRINTF((ti->opaque, "receive_historical_data: cannot store %d bars\n", item_count));
+        tws_disconnect(ti);
+        return;
+    }
+
+    for(j = 0; j < item_count; j++) {
+        lval = sizeof(tws_string_t); read_line(ti, date, &lval);
+        hb->hb_time[j] = parse_bar_time(date);
+        read_double(ti, &hb->hb_open[j]);
+        read_double(ti, &hb->hb_high[j]);
+        read_double(ti, &hb->hb_low[j]);
+        read_double(ti, &hb->hb_close[j]);
+        read_long(ti, &hb->hb_volume[j]);
+        read_double(ti, &hb->hb_wap[j]);
+        lval = sizeof(tws_string_t); read_line(ti, has_gaps, &lval);
+        hb->hb_has_gaps[j] = !!strncasecmp(has_gaps, "false", 5);
+
+        if(version >= 3)
+            read_int(ti, &hb->hb_bar_count[j]);
+        else
+            hb->hb_bar_count[j] = -1;
+    }
+    hb->hb_count = item_count;
+
+    if(can_deliver(ti))
+        event_historical_data_columns(ti->opaque, req_id, hb);
+}
+
 static void receive_historical_data(tws_instance_t *ti)
 {
     double open, high, low, close, wap;
@@ -1533,6 +2277,11 @@ static void receive_historical_data(tws_instance_t *ti)
     }
     read_int(ti, &ival), item_count = ival;
 
+    if(ti->historical_columnar) {
+        receive_historical_data_columns(ti, version, req_id, item_count, date, has_gaps);
+        item_count = 0;
+    }
+
     for(j = 0; j < item_count; j++) {
         lval = sizeof(tws_string_t); read_line(ti, date, &lval);
         read_double(ti, &open);
@@ -1549,12 +2298,12 @@ static void receive_historical_data(tws_instance_t *ti)
         else
             bar_count = -1;
 
-        if(ti->connected)
+        if(can_deliver(ti))
             event_historical_data(ti->opaque, req_id, date, open, high, low, close, volume, bar_count, wap, gaps);
 
     }
     /* send end of dataset marker */
-    if(ti->connected)
+    if(can_deliver(ti))
         event_historical_data_end(ti->opaque, req_id, completion_from, completion_to);
 
     free_string(ti, date);
@@ -1570,18 +2319,143 @@ static void receive_scanner_parameters(tws_instance_t *ti)
 
     read_int(ti, &ival); /*version*/
 
+    if(ti->xml) {
+        xml_begin(ti->xml, XML_SCANNER_PARAMETERS);
+        read_line_streamed(ti, xml_feed, ti->xml);
+        return;
+    }
+
     // we expect to receive a very large XML string here, so don't even try to make the effort for smaller strings.
     // In my case, I see an incoming XML string of ~ 193K so we instruct the function to start with a 200K buffer
-    // on the heap to speed it up a little bit by (most probably) not requiring any realloc ~ large memcopy
-    // operation in there.
+    // to speed it up a little bit by (most probably) not requiring any realloc ~ large memcopy
+    // operation in there (or with the long string limit, when that is lower).
     xml = NULL;
     read_line_of_arbitrary_length(ti, &xml, 200 * 1024);
 
-    if(ti->connected) {
+    if(can_deliver(ti)) {
         event_scanner_parameters(ti->opaque, xml);
     }
 
-    free(xml);
+    release_long_string(ti);
+}
+
+static int compare_scanner_rows(const void *a, const void *b)
+{
+    int x = ((const scanner_row_t *)a)->conid, y = ((const scanner_row_t *)b)->conid;
+
+    return (x > y) - (x < y);
+}
+
+static scanner_state_t *find_scanner_state(tws_instance_t *ti, int ticker_id)
+{
+    int i;
+
+    for(i = 0; i < ti->scanners_used; i++)
+        if(ti->scanners[i].ticker_id == ticker_id)
+            return &ti->scanners[i];
+    return NULL;
+}
+
+static void drop_scanner_state(tws_instance_t *ti, int ticker_id)
+{
+    scanner_state_t *sc = find_scanner_state(ti, ticker_id);
+
+    if(sc) {
+        free(sc->mem);
+        *sc = ti->scanners[--ti->scanners_used];
+    }
+}
+
+/* find or create the state of 'ticker_id' with room for 'rows' new rows; returns NULL on heap alloc failure */
+static scanner_state_t *reserve_scanner_state(tws_instance_t *ti, int ticker_id, int rows)
+{
+    scanner_state_t *sc = find_scanner_state(ti, ticker_id);
+
+    if(!sc) {
+        if(ti->scanners_used == ti->scanners_size) {
+            int size = ti->scanners_size ? 2 * ti->scanners_size : 4;
+            scanner_state_t *p = (scanner_state_t *)realloc(ti->scanners, size * sizeof *p);
+
+            if(!p) {
+                TWS_DEBUG_PRINTF((ti->opaque, "reserve_scanner_state: memory allocation failure\n"));
+                return NULL;
+            }
+            ti->scanners = p;
+            ti->scanners_size = size;
+        }
+        sc = &ti->scanners[ti->scanners_used++];
+        memset(sc, 0, sizeof *sc);
+        sc->ticker_id = ticker_id;
+    }
+
+    if(rows > sc->capacity) {
+        int capacity = sc->capacity ? sc->capacity : 16;
+        scanner_row_t *p;
+
+        while(capacity < rows)
+            capacity *= 2;
+
+        p = (scanner_row_t *)malloc(capacity * (2 * sizeof(scanner_row_t) + 1));
+        if(!p) {
+            TWS_DEBUG_PRINTF((ti->opaque, "reserve_scanner_state: memory allocation failure\n"));
+            return NULL;
+        }
+        if(sc->count)
+            memcpy(p, sc->prev, sc->count * sizeof *p);
+        free(sc->mem);
+        sc->mem = p;
+        sc->prev = p;
+        sc->next = p + capacity;
+        sc->seen = (unsigned char *)(p + 2 * capacity);
+        sc->capacity = capacity;
+    }
+
+    memset(sc->seen, 0, sc->count);
+    return sc;
+}
+
+static void scanner_diff_row(tws_instance_t *ti, scanner_state_t *sc, int j, int rank, tr_contract_details_t *cd,
+                             const char distance[], const char benchmark[], const char projection[], const char legs_str[])
+{
+    int conid = cd->d_summary.c_conid;
+    int lo = 0, hi = sc->count;
+
+    sc->next[j].conid = conid;
+    sc->next[j].rank = rank;
+
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if(sc->prev[mid].conid < conid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo == sc->count || sc->prev[lo].conid != conid) {
+        if(can_deliver(ti))
+            event_scanner_data_changed(ti->opaque, sc->ticker_id, SCANNER_ROW_ENTERED, conid, rank, -1, cd, distance, benchmark, projection, legs_str);
+        return;
+    }
+
+    sc->seen[lo] = 1;
+    if(sc->prev[lo].rank != rank && can_deliver(ti))
+        event_scanner_data_changed(ti->opaque, sc->ticker_id, SCANNER_ROW_MOVED, conid, rank, sc->prev[lo].rank, cd, distance, benchmark, projection, legs_str);
+}
+
+/* report the rows which left the list and make the received list the previous one */
+static void scanner_diff_end(tws_instance_t *ti, scanner_state_t *sc, int num_elements)
+{
+    scanner_row_t *p;
+    int i;
+
+    for(i = 0; i < sc->count; i++)
+        if(!sc->seen[i] && can_deliver(ti))
+            event_scanner_data_changed(ti->opaque, sc->ticker_id, SCANNER_ROW_LEFT, sc->prev[i].conid, -1, sc->prev[i].rank, NULL, NULL, NULL, NULL, NULL);
+
+    qsort(sc->next, num_elements, sizeof *sc->next, compare_scanner_rows);
+    p = sc->prev, sc->prev = sc->next, sc->next = p;
+    sc->count = num_elements;
 }
 
 static void receive_scanner_data(tws_instance_t *ti)
@@ -1591,6 +2465,7 @@ static void receive_scanner_data(tws_instance_t *ti)
     size_t lval;
     int j;
     int ival, version, rank, ticker_id, num_elements;
+    scanner_state_t *sc = NULL;
 
     init_contract_details(ti, &cdetails);
 
@@ -1598,7 +2473,10 @@ static void receive_scanner_data(tws_instance_t *ti)
     read_int(ti, &ival), ticker_id = ival;
     read_int(ti, &ival), num_elements = ival;
 
-    if(ti->connected)
+    if(ti->scanner_diff && version >= 3 && num_elements >= 0)
+        sc = reserve_scanner_state(ti, ticker_id, num_elements);
+
+    if(can_deliver(ti))
         event_scanner_data_start(ti->opaque, ticker_id, num_elements);
 
     for(j = 0; j < num_elements; j++) {
@@ -1629,14 +2507,22 @@ static void receive_scanner_data(tws_instance_t *ti)
             lval = sizeof(tws_string_t), read_line(ti, legs_str, &lval);
         }
 
-        if(ti->connected)
+        /* look the state up again: an event handler may have cancelled the subscription */
+        if(sc)
+            sc = find_scanner_state(ti, ticker_id);
+        if(sc)
+            scanner_diff_row(ti, sc, j, rank, &cdetails, distance, benchmark, projection, legs_str);
+        else if(can_deliver(ti))
             event_scanner_data(ti->opaque, ticker_id, rank, &cdetails, distance, benchmark, projection, legs_str);
 
         if(legs_str)
             free_string(ti, legs_str);
     }
 
-    if(ti->connected)
+    if(sc && (sc = find_scanner_state(ti, ticker_id)) != NULL)
+        scanner_diff_end(ti, sc, num_elements);
+
+    if(can_deliver(ti))
         event_scanner_data_end(ti->opaque, ticker_id, num_elements);
 
     destroy_contract_details(ti, &cdetails);
@@ -1653,10 +2539,91 @@ static void receive_current_time(tws_instance_t *ti)
     read_int(ti, &ival /*version unused */);
     read_long(ti, &time);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_current_time(ti->opaque, time);
 }
 
+static unsigned int bar_aggregation_slot(const tws_instance_t *ti, int req_id)
+{
+    return ((unsigned int)req_id * 2654435761U) & (ti->bar_aggs_size - 1);
+}
+
+/* returns NULL when req_id has no aggregations */
+static bar_aggregation_t *find_bar_aggregation(tws_instance_t *ti, int req_id)
+{
+    unsigned int j;
+
+    if(!ti->bar_aggs_used)
+        return NULL;
+
+    for(j = bar_aggregation_slot(ti, req_id); ti->bar_aggs[j].num_periods; j = (j + 1) & (ti->bar_aggs_size - 1)) {
+        if(ti->bar_aggs[j].req_id == req_id)
+            return &ti->bar_aggs[j];
+    }
+    return NULL;
+}
+
+static void emit_aggregated_bar(tws_instance_t *ti, int req_id, bar_accumulator_t *acc)
+{
+    double wap = acc->volume > 0 ? acc->wap_volume / acc->volume : acc->wap;
+
+    if(can_deliver(ti))
+        event_aggregated_bar(ti->opaque, req_id, acc->period, acc->start, acc->open, acc->high, acc->low, acc->close, acc->volume, wap, acc->count);
+    acc->start = -1;
+}
+
+/* O(1) per time frame: fold one 5 second bar into every time frame registered for req_id */
+static void aggregate_realtime_bar(tws_instance_t *ti, int req_id, long time, double open, double high, double low, double close, long volume, double wap, int count)
+{
+    bar_aggregation_t *agg = find_bar_aggregation(ti, req_id);
+    int j;
+
+    if(!agg)
+        return;
+
+    for(j = 0; j < agg->num_periods; j++) {
+        bar_accumulator_t *acc = &agg->acc[j];
+        long start = time - time % acc->period;
+
+        if(acc->start != start) {
+            /* a gap in the feed left the previous bar incomplete: deliver it anyway */
+            if(acc->start >= 0)
+                emit_aggregated_bar(ti, req_id, acc);
+
+            acc->start = start;
+            acc->open = open;
+            acc->high = high;
+            acc->low = low;
+            acc->volume = 0;
+            acc->wap_volume = 0.0;
+            acc->count = 0;
+        } else {
+            if(high > acc->high)
+                acc->high = high;
+            if(low < acc->low)
+                acc->low = low;
+        }
+        acc->close = close;
+        acc->volume += volume;
+        acc->wap_volume += wap * volume;
+        acc->wap = wap;
+        acc->count += count;
+
+        /* the last 5 second bar of the period closes the bar: don't wait for the next one to arrive */
+        if(time + REALTIME_BAR_SECONDS >= start + acc->period)
+            emit_aggregated_bar(ti, req_id, acc);
+    }
+}
+
+/* discard the partially built bars; the aggregation setup stays for the next request */
+static void reset_bar_aggregation(bar_aggregation_t *agg)
+{
+    int j;
+
+    for(j = 0; j < agg->num_periods; j++)
+        agg->acc[j].start = -1;
+}
+
 static void receive_realtime_bars(tws_instance_t *ti)
 {
     long time, volume;
@@ -1674,8 +2641,11 @@ static void receive_realtime_bars(tws_instance_t *ti)
     read_double(ti, &wap);
     read_int(ti, &count);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_realtime_bar(ti->opaque, req_id, time, open, high, low, close, volume, wap, count);
+
+    if(ti->bar_aggs_used)
+        aggregate_realtime_bar(ti, req_id, time, open, high, low, close, volume, wap, count);
 }
 
 static void receive_fundamental_data(tws_instance_t *ti)
@@ -1687,15 +2657,19 @@ static void receive_fundamental_data(tws_instance_t *ti)
     read_int(ti, &ival); /* version ignored */
     read_int(ti, &ival), req_id = ival;
 
+    if(ti->chunked_strings) {
+        read_line_streamed(ti, fundamental_data_chunk, &req_id);
+        return;
+    }
+
     data = str = alloc_string(ti);
     read_line_of_arbitrary_length(ti, &data, sizeof(tws_string_t));
 
-    if(ti->connected) {
+    if(can_deliver(ti)) {
         event_fundamental_data(ti->opaque, req_id, data);
     }
 
-    if (data != str)
-        free(data);
+    release_long_string(ti);
     free_string(ti, str);
 }
 
@@ -1706,8 +2680,11 @@ static void receive_contract_data_end(tws_instance_t *ti)
     read_int(ti, &ival); /* version ignored */
     read_int(ti, &ival), req_id = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_contract_details_end(ti->opaque, req_id);
+
+    if(ti->resolve_items)
+        resolve_contract_done(ti, req_id, 0);
 }
 
 static void receive_open_order_end(tws_instance_t *ti)
@@ -1715,7 +2692,7 @@ static void receive_open_order_end(tws_instance_t *ti)
     int ival;
 
     read_int(ti, &ival); /* version ignored */
-    if(ti->connected)
+    if(can_deliver(ti))
         event_open_order_end(ti->opaque);
 }
 
@@ -1728,7 +2705,7 @@ static void receive_acct_download_end(tws_instance_t *ti)
     read_int(ti, &ival); /* version ignored */
     read_line(ti, acct_name, &lval);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_acct_download_end(ti->opaque, acct_name);
 }
 
@@ -1739,7 +2716,7 @@ static void receive_execution_data_end(tws_instance_t *ti)
     read_int(ti, &ival); /* version ignored */
     read_int(ti, &ival); req_id = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_exec_details_end(ti->opaque, req_id);
 }
 
@@ -1755,7 +2732,7 @@ static void receive_delta_neutral_validation(tws_instance_t *ti)
     read_double(ti, &und.u_delta);
     read_double(ti, &und.u_price);
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_delta_neutral_validation(ti->opaque, req_id, &und);
 }
 
@@ -1766,7 +2743,7 @@ static void receive_tick_snapshot_end(tws_instance_t *ti)
     read_int(ti, &ival); /* version ignored */
     read_int(ti, &ival); req_id = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_tick_snapshot_end(ti->opaque, req_id);
 }
 
@@ -1779,7 +2756,7 @@ static void receive_market_data_type(tws_instance_t *ti)
     read_int(ti, &ival); req_id = ival;
     read_int(ti, &ival); market_type = (market_data_type_t)ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_market_data_type(ti->opaque, req_id, market_type);
 }
 
@@ -1800,26 +2777,224 @@ static void receive_commission_report(tws_instance_t *ti)
 	read_double(ti, &report.cr_yield);
 	read_int(ti, &ival); report.cr_yield_redemption_date = ival;
 
-    if(ti->connected)
+    if(can_deliver(ti))
         event_commission_report(ti->opaque, &report);
 }
 
 
-/* allows for reading events from within the same thread or an externally
- * spawned thread, returns 0 on success, -1 on error,
- */
-int tws_event_process(tws_instance_t *ti)
+/* nanoseconds on a monotonic clock */
+static unsigned long long monotonic_ns(void)
 {
-    int ival;
-    int valid = 1;
-    tws_incoming_id_t msgcode;
+    struct timespec ts;
+
+#ifdef unix
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC); /* not monotonic, but the best plain C offers */
+#endif
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static unsigned long long wall_clock_ns(void)
+{
+    struct timespec ts;
+
+#ifdef unix
+    clock_gettime(CLOCK_REALTIME, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static int capture_append(unsigned char **buf, size_t *len, size_t *size, const void *src, size_t n)
+{
+    if(*len + n > *size) {
+        size_t new_size = *size ? *size : 4096;
+        unsigned char *p;
+
+        while(new_size < *len + n)
+            new_size *= 2;
+        p = (unsigned char *)realloc(*buf, new_size);
+        if(!p)
+            return -1;
+        *buf = p;
+        *size = new_size;
+    }
+    memcpy(*buf + *len, src, n);
+    *len += n;
+    return 0;
+}
+
+static void capture_write(tws_instance_t *ti, unsigned long long time_ns, int direction, int msg_id, int flags, const unsigned char *data, size_t len)
+{
+    tws_capture_record_t rec;
+    int err = 0;
+
+    /* an RX record is written after its callbacks, which may have flushed TX records stamped later */
+    if(time_ns < ti->cap_last_time)
+        time_ns = ti->cap_last_time;
+
+    if(direction == TWS_CAPTURE_RX && (flags & TWS_CAPTURE_HANDSHAKE))
+        ti->cap_hello = ti->cap_offset;
+
+    if(ti->cap_seq % TWS_CAPTURE_INDEX_INTERVAL == 0) {
+        tws_capture_index_entry_t e;
+
+        e.i_offset = ti->cap_offset;
+        e.i_seq = ti->cap_seq;
+        e.i_time_ns = time_ns;
+        e.i_hello_offset = ti->cap_hello;
+        err |= fwrite(&e, sizeof e, 1, ti->cap_index) != 1;
+    }
+
+    rec.r_time_ns = time_ns;
+    rec.r_length = (unsigned int)len;
+    rec.r_msg_id = (unsigned short)msg_id;
+    rec.r_direction = (unsigned char)direction;
+    rec.r_flags = (unsigned char)flags;
+    err |= fwrite(&rec, sizeof rec, 1, ti->cap_file) != 1;
+    err |= len > 0 && fwrite(data, 1, len, ti->cap_file) != len;
+
+    if(err) {
+        TWS_DEBUG_PRINTF((ti->opaque, "capture_write: write error, capture stopped\n"));
+        tws_stop_capture(ti);
+        return;
+    }
+    ti->cap_offset += sizeof rec + len;
+    ti->cap_seq++;
+    ti->cap_last_time = time_ns;
+}
+
+static void capture_rx_begin(tws_instance_t *ti)
+{
+    if(ti->cap_file) {
+        ti->cap_in_msg = 1;
+        ti->cap_rx_mark = ti->buf_next;
+        ti->cap_rx_len = 0;
+        ti->cap_rx_time = 0;
+    }
+}
+
+/* buf is about to be refilled: save the part of the incoming message it holds */
+static void capture_rx_stash(tws_instance_t *ti)
+{
+    if(capture_append(&ti->cap_rx, &ti->cap_rx_len, &ti->cap_rx_size, ti->buf + ti->cap_rx_mark, ti->buf_last - ti->cap_rx_mark)) {
+        TWS_DEBUG_PRINTF((ti->opaque, "capture_rx_stash: heap alloc failure, capture stopped\n"));
+        tws_stop_capture(ti);
+        return;
+    }
+    ti->cap_rx_mark = 0;
+}
+
+static void capture_rx_end(tws_instance_t *ti, int msg_id, int flags)
+{
+    const unsigned char *data = ti->buf + ti->cap_rx_mark;
+    size_t len = ti->buf_next > ti->cap_rx_mark ? ti->buf_next - ti->cap_rx_mark : 0; /* a disconnect resets buf */
+
+    if(!ti->cap_in_msg)
+        return;
+    ti->cap_in_msg = 0;
+
+    if(!ti->connected)
+        flags |= TWS_CAPTURE_INCOMPLETE;
+    if(!ti->cap_rx_time)
+        ti->cap_rx_time = monotonic_ns();
+
+    /* most messages never leave buf and are written straight from there */
+    if(ti->cap_rx_len) {
+        if(capture_append(&ti->cap_rx, &ti->cap_rx_len, &ti->cap_rx_size, data, len)) {
+            tws_stop_capture(ti);
+            return;
+        }
+        data = ti->cap_rx;
+        len = ti->cap_rx_len;
+    }
+    capture_write(ti, ti->cap_rx_time, TWS_CAPTURE_RX, msg_id, flags, data, len);
+}
+
+static unsigned int latency_bucket(unsigned long long ns)
+{
+    unsigned int e;
+
+    if(ns < TWS_LATENCY_SUB_BUCKETS)
+        return (unsigned int)ns;
+
+    /* e: position of the highest bit set, at least 4 as TWS_LATENCY_SUB_BUCKETS is 2^4 */
+#if defined(__GNUC__)
+    e = 63 - (unsigned int)__builtin_clzll(ns);
+#else
+    for(e = 4; ns >> (e + 1); e++)
+        ;
+#endif
+    if(e >= 40)
+        return TWS_LATENCY_BUCKETS - 1;
+    return TWS_LATENCY_SUB_BUCKETS * (e - 3) + (unsigned int)((ns >> (e - 4)) & (TWS_LATENCY_SUB_BUCKETS - 1));
+}
+
+static void latency_add(tr_latency_histogram_t *h, unsigned long long ns)
+{
+    if(!h->lh_count || ns < h->lh_min_ns)
+        h->lh_min_ns = ns;
+    if(ns > h->lh_max_ns)
+        h->lh_max_ns = ns;
+    h->lh_count++;
+    h->lh_sum_ns += ns;
+    h->lh_buckets[latency_bucket(ns)]++;
+}
+
+/* the timed message has been processed; msg_id is -1 for an unknown message */
+static void latency_record(tws_instance_t *ti, int msg_id)
+{
+    unsigned long long end = monotonic_ns(), decoded = ti->lat_decoded ? ti->lat_decoded : end;
+    tr_latency_histogram_t *h;
+
+    ti->lat_in_msg = 0;
+    /* the stats may have been disabled by a callback */
+    if(!ti->latency || msg_id < 0 || msg_id >= LATENCY_MSG_IDS)
+        return;
+
+    h = ti->latency[msg_id];
+    if(!h) {
+        h = (tr_latency_histogram_t *)calloc(LATENCY_PHASE_COUNT, sizeof *h);
+        if(!h)
+            return;
+        ti->latency[msg_id] = h;
+    }
+
+    latency_add(&h[LATENCY_DECODE], decoded - ti->lat_start);
+    if(ti->lat_decoded)
+        latency_add(&h[LATENCY_CALLBACK], end - decoded);
+    latency_add(&h[LATENCY_TOTAL], end - ti->lat_start);
+    latency_add(&h[LATENCY_RECEIVE_WAIT], ti->lat_wait);
+}
+
+/* allows for reading events from within the same thread or an externally
+ * spawned thread, returns 0 on success, -1 on error,
+ */
+int tws_event_process(tws_instance_t *ti)
+{
+    int ival;
+    int valid = 1;
+    tws_incoming_id_t msgcode;
+    unsigned long long start = ti->rx_consumed - (ti->buf_last - ti->buf_next);
 
 	if (ti->rx_observe) {
 		ti->rx_observe(ti, NULL, 0, 0);
 	}
 
+    capture_rx_begin(ti);
     read_int(ti, &ival);
     msgcode = (tws_incoming_id_t)ival;
+    if(ti->cap_in_msg)
+        ti->cap_rx_time = monotonic_ns();
+    if(ti->latency_stats) {
+        ti->lat_start = monotonic_ns();
+        ti->lat_decoded = ti->lat_wait = 0;
+        ti->lat_in_msg = 1;
+    }
+    /* not connected: the connection was lost waiting for the message, which is no decode error */
+    ti->rx_in_msg = ti->connected;
 
     TWS_DEBUG_PRINTF((ti->opaque, "\nreceived id=%d, name=%s\n", (int)msgcode, tws_incoming_msg_name(msgcode)));
 
@@ -1863,6 +3038,20 @@ int tws_event_process(tws_instance_t *ti)
     default: valid = 0; break;
     }
 
+    if(ti->cap_in_msg)
+        capture_rx_end(ti, valid ? (int)msgcode : 0, 0);
+    if(ti->lat_in_msg)
+        latency_record(ti, valid ? (int)msgcode : -1);
+    if(ti->rx_in_msg) {
+        ti->rx_in_msg = 0;
+        if(!valid || !ti->connected) {
+            ti->stats.st_decode_errors++;
+        } else if((int)msgcode >= 0 && (int)msgcode < TWS_STATS_MSG_IDS) {
+            ti->stats.st_rx_messages[msgcode]++;
+            ti->stats.st_rx_bytes[msgcode] += ti->rx_consumed - (ti->buf_last - ti->buf_next) - start;
+        }
+    }
+
     return valid ? 0 : -1;
 }
 
@@ -1882,6 +3071,9 @@ tws_instance_t *tws_create(void *opaque, tws_transmit_func_t *transmit, tws_rece
 		ti->tx_observe = tx_listener;
 		ti->rx_observe = rx_listener;
 
+        ti->long_str_keep = LONG_STRING_KEEP_SIZE;
+        ti->stats.st_pool_size = MAX_TWS_STRINGS;
+
         reset_io_buffers(ti);
     }
 
@@ -1892,9 +3084,29 @@ void tws_destroy(tws_instance_t *ti)
 {
     tws_disconnect(ti);
 
+    free(ti->hist_bars_mem);
+    free(ti->greeks_mem);
+    tws_enable_id_allocator(ti, -1);
+    free(ti->long_str);
+    tws_stop_capture(ti);
+    free(ti->xml);
+    while(ti->scanners_used)
+        drop_scanner_state(ti, ti->scanners[0].ticker_id);
+    free(ti->scanners);
+    free(ti->bar_aggs);
+    tws_enable_latency_stats(ti, 0);
+    tws_enable_subscription_registry(ti, 0);
     free(ti);
 }
 
+/* hand tx_buf to transmit(); returns !0 when not all of it was taken */
+static int transmit_buffer(tws_instance_t *ti)
+{
+    ti->stats.st_transmit_calls++;
+    ti->stats.st_transmit_bytes += ti->tx_buf_next;
+    return (int)ti->tx_buf_next != ti->transmit(ti->opaque, ti->tx_buf, ti->tx_buf_next);
+}
+
 /* perform output buffering */
 static int send_blob(tws_instance_t *ti, const char *src, size_t srclen)
 {
@@ -1906,8 +3118,24 @@ static int send_blob(tws_instance_t *ti, const char *src, size_t srclen)
 			ti->tx_observe(ti, src, srclen, 0);
 		}
 
+        if (ti->cap_file && capture_append(&ti->cap_tx, &ti->cap_tx_len, &ti->cap_tx_size, src, srclen)) {
+            tws_stop_capture(ti);
+        }
+
+        /* the registry keeps the request, or at least not the one it replaces, when there's no room for it */
+        if (ti->sub_kind != SUB_NONE && capture_append(&ti->sub_msg, &ti->sub_msg_len, &ti->sub_msg_size, src, srclen)) {
+            drop_subscription(ti, ti->sub_kind, ti->sub_ticker_id);
+            ti->sub_kind = SUB_NONE;
+        }
+
+        /* every message starts with its id */
+        if (!ti->tx_msg_bytes) {
+            ti->tx_msg_id = ti->cap_handshake ? -1 : atoi(src);
+        }
+        ti->tx_msg_bytes += srclen;
+
         while (len < srclen) {
-            err = ((int)ti->tx_buf_next != ti->transmit(ti->opaque, ti->tx_buf, ti->tx_buf_next));
+            err = transmit_buffer(ti);
             if(err) {
                 tws_disconnect(ti);
                 return err;
@@ -1939,15 +3167,28 @@ static int flush_message(tws_instance_t *ti)
 {
     int err = 0;
 
+    if (ti->cap_file && ti->cap_tx_len) {
+        capture_write(ti, monotonic_ns(), TWS_CAPTURE_TX, ti->cap_handshake ? 0 : atoi((const char *)ti->cap_tx),
+                      ti->cap_handshake ? TWS_CAPTURE_HANDSHAKE : 0, ti->cap_tx, ti->cap_tx_len);
+    }
+    ti->cap_tx_len = 0;
+
+    if (ti->tx_msg_bytes && ti->tx_msg_id >= 0 && ti->tx_msg_id < TWS_STATS_MSG_IDS) {
+        ti->stats.st_tx_messages[ti->tx_msg_id]++;
+        ti->stats.st_tx_bytes[ti->tx_msg_id] += ti->tx_msg_bytes;
+    }
+    ti->tx_msg_bytes = 0;
+
     if (ti->connected) {
         if (ti->tx_buf_next > 0) {
-            err = ((int)ti->tx_buf_next != ti->transmit(ti->opaque, ti->tx_buf, ti->tx_buf_next));
+            err = transmit_buffer(ti);
             if(err) {
                 tws_disconnect(ti);
                 goto out;
             }
         }
         /* now that all lingering message data has been transmitted, signal end of message by requesting a TX/flush: */
+        ti->stats.st_flushes++;
         err = ti->flush(ti->opaque);
         if(err) {
             tws_disconnect(ti);
@@ -1956,6 +3197,9 @@ static int flush_message(tws_instance_t *ti)
     }
     ti->tx_buf_next = 0;
 out:
+    if (ti->sub_kind != SUB_NONE) {
+        record_subscription(ti);
+    }
     return err;
 }
 
@@ -2018,6 +3262,34 @@ static int send_double_max(tws_instance_t *ti, double val)
     return DBL_NOTMAX(val) ? send_double(ti, val) : send_str(ti, "");
 }
 
+/* buf has been used up: receive() the next piece of the stream; returns what receive() returned */
+static int refill_buffer(tws_instance_t *ti)
+{
+    unsigned long long t = 0;
+    int nread;
+
+    if(ti->cap_in_msg)
+        capture_rx_stash(ti);
+    if(ti->lat_in_msg)
+        t = monotonic_ns();
+
+    nread = ti->receive(ti->opaque, ti->buf, (unsigned int)sizeof ti->buf);
+
+    if(t)
+        ti->lat_wait += monotonic_ns() - t;
+    ti->stats.st_receive_calls++;
+    if(nread > 0) {
+        ti->buf_last = nread;
+        ti->buf_next = 0;
+        ti->rx_consumed += nread;
+        ti->stats.st_receive_bytes += nread;
+        ti->stats.st_refills++;
+        if(ti->rx_in_msg)
+            ti->stats.st_split_refills++;
+    }
+    return nread;
+}
+
 /* returns 1 char at a time, kernel not entered most of the time
  * return -1 on error or EOF
  */
@@ -2027,13 +3299,11 @@ static int read_char(tws_instance_t *ti)
 
     if (ti->connected) {
         if(ti->buf_next == ti->buf_last) {
-            nread = ti->receive(ti->opaque, ti->buf, (unsigned int)sizeof ti->buf);
+            nread = refill_buffer(ti);
             if(nread <= 0) {
                 nread = -1;
                 goto out;
             }
-            ti->buf_last = nread;
-            ti->buf_next = 0;
         }
 
         nread = ti->buf[ti->buf_next++];
@@ -2095,53 +3365,106 @@ out:
 }
 
 /*
-When fetching a parameter string value of arbitrary length, we return a pointer to
-space allocated on the heap (we only use the string memory pool for shorter strings
+make the long string buffer hold at least 'size' chars, growing it geometrically; the contents are preserved.
+Fails when the tws_set_long_string_buffer() limit would be exceeded or the heap is exhausted.
+*/
+static int reserve_long_string(tws_instance_t *ti, size_t size)
+{
+    size_t new_size;
+    char *p;
+
+    if(size <= ti->long_str_size)
+        return 0;
+
+    new_size = ti->long_str_size < LONG_STRING_MIN_SIZE ? LONG_STRING_MIN_SIZE : ti->long_str_size;
+    while(new_size < size)
+        new_size *= 2;
+    if(ti->long_str_max && new_size > ti->long_str_max) {
+        if(size > ti->long_str_max)
+            return -1;
+        new_size = ti->long_str_max;
+    }
+
+    p = realloc(ti->long_str, new_size);
+    if(!p)
+        return -1;
+    ti->long_str = p;
+    ti->long_str_size = new_size;
+    if(new_size > ti->stats.st_long_string_high_water)
+        ti->stats.st_long_string_high_water = (unsigned int)new_size;
+    return 0;
+}
+
+/* called once the string returned by read_line_of_arbitrary_length() has been dispatched: applies the shrink policy */
+static void release_long_string(tws_instance_t *ti)
+{
+    char *p;
+
+    if(ti->long_str_size <= ti->long_str_keep)
+        return;
+
+    if(ti->long_str_keep == 0) {
+        free(ti->long_str);
+        ti->long_str = NULL;
+        ti->long_str_size = 0;
+        return;
+    }
+
+    p = realloc(ti->long_str, ti->long_str_keep);
+    if(p) {
+        ti->long_str = p;
+        ti->long_str_size = ti->long_str_keep;
+    }
+}
+
+/*
+When fetching a parameter string value of arbitrary length, we don't use the string memory pool alone
 as that one is size limited and (in its entirety!) too small for several messages.
 
 We don't want to take a buffer overflow risk like that any more, so we fix this by
-allowing arbitrary string length for this parameter type only.
+allowing arbitrary string length for this parameter type only: '*val' may point to a caller buffer
+of 'alloc_size' chars (usually a pool string) which is used as long as the string fits; longer strings,
+or all strings when '*val' is NULL, end up in the per-instance long string buffer, which is reused
+from message to message instead of allocating every string on the heap. With '*val' NULL, 'alloc_size'
+is only the initial reservation: no more than the tws_set_long_string_buffer() limit, grown on demand.
+Either way the caller must not free the result but call release_long_string() after use.
 */
 static int read_line_of_arbitrary_length(tws_instance_t *ti, char **val, size_t alloc_size)
 {
     size_t j = 0;
     char *line;
     int nread = -1, err = -1;
-    int malloced = 0;
 
     line = *val;
     *val = NULL;
 
     if (line == NULL || alloc_size == 0) {
-        // guestimate reasonable initial buffer size: we expect large inputs so we start pretty big:
-        if (alloc_size < 65536)
-            alloc_size = 65536;
-        line = malloc(alloc_size);
-        malloced = 1;
-        if (line == NULL)
+        if (ti->long_str_max && alloc_size > ti->long_str_max)
+            alloc_size = ti->long_str_max;
+        if (reserve_long_string(ti, alloc_size))
         {
             TWS_DEBUG_PRINTF((ti->opaque, "read_line_of_arbitrary_length: going out 0, heap alloc failure\n"));
+            line = NULL;
             goto out;
         }
+        line = ti->long_str;
+        alloc_size = ti->long_str_size;
     }
 
     line[0] = '\0';
     for(j = 0; ; j++) {
         if (j + 1 >= alloc_size) {
-            alloc_size += 65536;
-            if (malloced)
-            {
-                line = realloc(line, alloc_size);
-            }
-            else
-            {
-                line = malloc(alloc_size);
-            }
-            malloced = 1;
-            if (line == NULL) {
-                TWS_DEBUG_PRINTF((ti->opaque, "read_line_of_arbitrary_length: going out 1, heap alloc failure\n"));
+            char *prev = line != ti->long_str ? line : NULL;
+
+            if (reserve_long_string(ti, alloc_size + 1)) {
+                TWS_DEBUG_PRINTF((ti->opaque, "read_line_of_arbitrary_length: going out 1, heap alloc failure or string longer than %u\n", (unsigned int) ti->long_str_max));
                 goto out;
             }
+            // moving on from the caller's buffer: carry over what has been read so far
+            if (prev)
+                memcpy(ti->long_str, prev, j);
+            line = ti->long_str;
+            alloc_size = ti->long_str_size;
         }
         nread = read_char(ti);
         if(nread < 0) {
@@ -2165,12 +3488,6 @@ out:
         }
         // always close the connection in buffer overflow conditions; the next element fetch will be corrupt anyway and this way we prevent nasty surprises downrange.
         tws_disconnect(ti);
-
-        // and free the allocated buffer when an error occurred: it is NOT passed back to the caller
-        if (malloced && line)
-        {
-            free(line);
-        }
         //assert(*val == NULL);
     }
 
@@ -2181,6 +3498,71 @@ out:
     return err;
 }
 
+/*
+Read one field without collecting it: the field is handed to 'sink' in the pieces in which it sits in the receive buffer,
+refilling the buffer as needed. The last call has is_last set and may have len == 0. Returns 0 on success, -1 on error;
+when the connection is lost after the first piece, a last call with data == NULL ends the field before the disconnect.
+Only an rx observer makes the field be collected, in the long string buffer: it is shown the whole field once, as for any
+other field, or an error when the field does not fit within the tws_set_long_string_buffer() limit.
+*/
+static int read_line_streamed(tws_instance_t *ti, read_sink_func_t *sink, void *arg)
+{
+    size_t observed = 0;
+    int observe_err = 0, started = 0;
+
+    for(;;) {
+        const char *start, *nul;
+        size_t len;
+
+        if(!ti->connected)
+            break;
+
+        if(ti->buf_next == ti->buf_last) {
+            int nread = refill_buffer(ti);
+
+            if(nread <= 0) {
+                TWS_DEBUG_PRINTF((ti->opaque, "read_line_streamed: going out 1, nread=%d\n", nread));
+                break;
+            }
+        }
+
+        start = (const char *)ti->buf + ti->buf_next;
+        nul = (const char *)memchr(start, '\0', ti->buf_last - ti->buf_next);
+        len = nul ? (size_t)(nul - start) : ti->buf_last - ti->buf_next;
+        ti->buf_next += (unsigned int)len + (nul != NULL);
+
+        if(ti->rx_observe && !observe_err) {
+            if(reserve_long_string(ti, observed + len + 1)) {
+                observe_err = -1;
+            } else {
+                memcpy(ti->long_str + observed, start, len);
+                observed += len;
+            }
+        }
+
+        if(len || nul)
+            sink(ti, arg, start, len, nul != NULL), started = 1;
+        if(nul) {
+            if(ti->rx_observe) {
+                if(!observe_err)
+                    ti->long_str[observed] = '\0';
+                ti->rx_observe(ti, observe_err ? NULL : ti->long_str, observe_err ? 0 : (unsigned int)observed, observe_err);
+                release_long_string(ti);
+            }
+            return 0;
+        }
+    }
+
+    if (ti->rx_observe) {
+        ti->rx_observe(ti, NULL, 0, -1);
+        release_long_string(ti);
+    }
+    if(started)
+        sink(ti, arg, NULL, 0, 1);
+    tws_disconnect(ti);
+    return -1;
+}
+
 static int read_double(tws_instance_t *ti, double *val)
 {
     char line[5* sizeof *val];
@@ -2247,11 +3629,206 @@ static void reset_io_buffers(tws_instance_t *ti)
 {
     /* WARNING: reset the output buffer to NIL fill when we send a connect message: this flushes any data lingering from a previously failed transmit on a previous connect */
     ti->tx_buf_next = 0;
+    ti->cap_tx_len = 0;
+    ti->tx_msg_bytes = 0;
     /* also reset the RECEIVE BUFFER to an 'empty' state! */
     ti->buf_last = 0;
     ti->buf_next = 0;
 }
 
+static unsigned int subscription_slot(const tws_instance_t *ti, int kind, int ticker_id)
+{
+    return (((unsigned int)ticker_id << 4 | (unsigned int)kind) * 2654435761U) & (ti->subs_size - 1);
+}
+
+/* returns NULL when the request is not in the registry */
+static subscription_t *find_subscription(tws_instance_t *ti, int kind, int ticker_id)
+{
+    unsigned int j;
+
+    if(!ti->subs_used)
+        return NULL;
+
+    for(j = subscription_slot(ti, kind, ticker_id); ti->subs[j].msg; j = (j + 1) & (ti->subs_size - 1)) {
+        if(ti->subs[j].kind == kind && ti->subs[j].ticker_id == ticker_id)
+            return &ti->subs[j];
+    }
+    return NULL;
+}
+
+static int resize_subscriptions(tws_instance_t *ti, unsigned int size)
+{
+    subscription_t *old = ti->subs;
+    subscription_t *slots = (subscription_t *)calloc(size, sizeof(*slots));
+    unsigned int old_size = ti->subs_size, j;
+
+    if(!slots)
+        return -1;
+    ti->subs = slots;
+    ti->subs_size = size;
+    ti->subs_cursor = 0;
+    for(j = 0; j < old_size; j++) {
+        if(old[j].msg) {
+            unsigned int k = subscription_slot(ti, old[j].kind, old[j].ticker_id);
+
+            while(slots[k].msg)
+                k = (k + 1) & (size - 1);
+            slots[k] = old[j];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static void drop_subscription(tws_instance_t *ti, int kind, int ticker_id)
+{
+    subscription_t *s = find_subscription(ti, kind, ticker_id);
+    unsigned int hole, j, mask;
+
+    if(!s)
+        return;
+
+    if(s->epoch != ti->conn_epoch)
+        ti->subs_stale--;
+    free(s->msg);
+    s->msg = NULL;
+
+    /* shift the remainder of the probe sequence back, as in tws_remove_bar_aggregation() */
+    mask = ti->subs_size - 1;
+    hole = (unsigned int)(s - ti->subs);
+    for(j = (hole + 1) & mask; ti->subs[j].msg; j = (j + 1) & mask) {
+        unsigned int home = subscription_slot(ti, ti->subs[j].kind, ti->subs[j].ticker_id);
+
+        if(((j - home) & mask) >= ((j - hole) & mask)) {
+            ti->subs[hole] = ti->subs[j];
+            ti->subs[j].msg = NULL;
+            hole = j;
+        }
+    }
+    ti->subs_used--;
+}
+
+/* have send_blob() collect the request about to be composed, for flush_message() to keep it once it has been sent */
+static void record_request(tws_instance_t *ti, int kind, int ticker_id)
+{
+    if(ti->subs) {
+        ti->sub_kind = kind;
+        ti->sub_ticker_id = ticker_id;
+        ti->sub_msg_len = 0;
+    }
+}
+
+static void record_subscription(tws_instance_t *ti)
+{
+    subscription_t *s;
+    int kind = ti->sub_kind, ticker_id = ti->sub_ticker_id;
+    unsigned int len = (unsigned int)ti->sub_msg_len;
+
+    ti->sub_kind = SUB_NONE;
+    /* a request which did not make it out leaves the registry as it was: the connection is gone along with it */
+    if(!ti->connected || !len)
+        return;
+
+    s = find_subscription(ti, kind, ticker_id);
+    if(s) {
+        if(s->epoch != ti->conn_epoch)
+            ti->subs_stale--;
+        if(s->size < len) {
+            char *msg = (char *)realloc(s->msg, len);
+
+            if(!msg) {
+                drop_subscription(ti, kind, ticker_id);
+                return;
+            }
+            s->msg = msg;
+            s->size = len;
+        }
+    } else {
+        char *msg = (char *)malloc(len);
+        unsigned int j;
+
+        /* keep the load factor at or below 1/2 */
+        if(!msg || (2 * (ti->subs_used + 1) > ti->subs_size && resize_subscriptions(ti, 2 * ti->subs_size))) {
+            free(msg);
+            return;
+        }
+        j = subscription_slot(ti, kind, ticker_id);
+        while(ti->subs[j].msg)
+            j = (j + 1) & (ti->subs_size - 1);
+        s = &ti->subs[j];
+        s->msg = msg;
+        s->size = len;
+        s->kind = kind;
+        s->ticker_id = ticker_id;
+        ti->subs_used++;
+    }
+
+    memcpy(s->msg, ti->sub_msg, len);
+    s->len = len;
+    s->server_version = ti->server_version;
+    s->epoch = ti->conn_epoch;
+}
+
+/* the next entry tws_resubscribe() sends; only to be called while subs_stale > 0 */
+static subscription_t *next_stale_subscription(tws_instance_t *ti)
+{
+    subscription_t *s;
+    int kind;
+
+    /* market data type, account updates etc. ahead of the subscriptions, which depend on them */
+    for(kind = SUB_MARKET_DATA_TYPE; kind <= SUB_AUTO_OPEN_ORDERS; kind++) {
+        s = find_subscription(ti, kind, 0);
+        if(s && s->epoch != ti->conn_epoch)
+            return s;
+    }
+
+    /* entries move when others are dropped or the table grows, so the scan wraps around until subs_stale is down to 0 */
+    for(;; ti->subs_cursor = (ti->subs_cursor + 1) & (ti->subs_size - 1)) {
+        s = &ti->subs[ti->subs_cursor];
+        if(s->msg && s->epoch != ti->conn_epoch)
+            return s;
+    }
+}
+
+/* send a recorded request again, field by field, so that tx_listener, capture and statistics see it like the original */
+static int send_subscription(tws_instance_t *ti, subscription_t *s)
+{
+    const char *p = s->msg, *end = s->msg + s->len;
+
+	if (ti->tx_observe) {
+		ti->tx_observe(ti, NULL, 0, atoi(p));
+	}
+
+    s->epoch = ti->conn_epoch;
+    ti->subs_stale--;
+    while(p < end) {
+        size_t len = strlen(p) + 1;
+
+        send_blob(ti, p, len);
+        p += len;
+    }
+
+    flush_message(ti);
+
+    return ti->connected ? 0 : -1;
+}
+
+/* a request encoded for another server version cannot be sent as it is: drop it and tell the application through event_error() */
+static void lose_subscription(tws_instance_t *ti, subscription_t *s)
+{
+    static const int codes[] = {
+        0, FAIL_SEND_REQMARKETDATATYPE, FAIL_SEND_ACCT, FAIL_SEND_BULLETINS, FAIL_SEND_OORDER,
+        FAIL_SEND_REQMKT, FAIL_SEND_REQMKTDEPTH, FAIL_SEND_REQRTBARS, FAIL_SEND_REQSCANNER
+    };
+    int kind = s->kind, ticker_id = s->ticker_id;
+    unsigned int server_version = s->server_version;
+    char msg[200];
+
+    drop_subscription(ti, kind, ticker_id);
+    sprintf(msg, "%.100sserver version changed from %u to %u, request again", tws_strerror(codes[kind])->err_msg,
+            server_version, ti->server_version);
+    event_error(ti->opaque, ticker_id, codes[kind], msg);
+}
 
 /*
 similar to IB/TWS Java method:
@@ -2261,6 +3838,7 @@ similar to IB/TWS Java method:
 int tws_connect(tws_instance_t *ti, int client_id)
 {
     size_t lval;
+    unsigned int j;
     int val, err;
 
     if(ti->connected) {
@@ -2275,12 +3853,14 @@ int tws_connect(tws_instance_t *ti, int client_id)
     }
     // turn this 'is connected' flag ON so that the read/send methods in here will work as expected.
     ti->connected = 1;
+    ti->cap_handshake = 1;
 
     if(send_int(ti, TWSCLIENT_VERSION)) {
         err = CONNECT_FAIL; goto out;
     }
     flush_message(ti);
 
+    capture_rx_begin(ti);
     if(read_int(ti, &val)) {
         err = CONNECT_FAIL; goto out;
     }
@@ -2298,6 +3878,7 @@ int tws_connect(tws_instance_t *ti, int client_id)
             err = CONNECT_FAIL; goto out;
         }
     }
+    capture_rx_end(ti, 0, TWS_CAPTURE_HANDSHAKE);
 
     if(ti->server_version >= 3) {
         if(send_int(ti, client_id)) {
@@ -2306,8 +3887,21 @@ int tws_connect(tws_instance_t *ti, int client_id)
         flush_message(ti);
     }
 
+    /* everything in the registry is to be sent again on this connection */
+    ti->conn_epoch++;
+    ti->subs_stale = ti->subs_used;
+    ti->subs_cursor = 0;
+    ti->subs_pace_start = 0;
+    ti->subs_resync = ti->subs && ti->conn_epoch > 1;
+
+    /* the bars of this connection do not continue the partial ones of the last */
+    for(j = 0; j < ti->bar_aggs_size; j++)
+        reset_bar_aggregation(&ti->bar_aggs[j]);
+
     err = 0;
 out:
+    capture_rx_end(ti, 0, TWS_CAPTURE_HANDSHAKE);
+    ti->cap_handshake = 0;
     if(err) {
         // do NOT 'destroy' the tws instance for reasons of symmetry: that sort of thing should only happen when tws_create() fails!
         //
@@ -2321,16 +3915,36 @@ int tws_connected(tws_instance_t *ti)
     return ti->connected;
 }
 
+unsigned int tws_rx_pending(tws_instance_t *ti)
+{
+    return ti->connected ? ti->buf_last - ti->buf_next : 0;
+}
+
 void  tws_disconnect(tws_instance_t *ti)
 {
     if (ti->connected) {
+        if (ti->disconnect_hook)
+            ti->disconnect_hook(ti, ti->disconnect_hook_arg);
         ti->close(ti->opaque);
     }
     ti->connected = 0;
+    ti->resolve_items = NULL;
 
     reset_io_buffers(ti);
 }
 
+int tws_reconnect(tws_instance_t *ti, int client_id)
+{
+    tws_disconnect(ti);
+    return tws_connect(ti, client_id);
+}
+
+void tws_set_disconnect_hook(tws_instance_t *ti, tws_disconnect_hook_func_t *hook, void *arg)
+{
+    ti->disconnect_hook = hook;
+    ti->disconnect_hook_arg = arg;
+}
+
 /*
 similar to IB/TWS Java method:
 
@@ -2366,6 +3980,9 @@ int tws_req_scanner_subscription(tws_instance_t *ti, int ticker_id, const tr_sca
 		ti->tx_observe(ti, NULL, 0, REQ_SCANNER_SUBSCRIPTION);
 	}
 
+    drop_scanner_state(ti, ticker_id);
+    record_request(ti, SUB_SCANNER, ticker_id);
+
     send_int(ti, REQ_SCANNER_SUBSCRIPTION);
     send_int(ti, 3 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -2414,6 +4031,9 @@ int tws_cancel_scanner_subscription(tws_instance_t *ti, int ticker_id)
 		ti->tx_observe(ti, NULL, 0, CANCEL_SCANNER_SUBSCRIPTION);
 	}
 
+    drop_scanner_state(ti, ticker_id);
+    drop_subscription(ti, SUB_SCANNER, ticker_id);
+
 	send_int(ti, CANCEL_SCANNER_SUBSCRIPTION);
     send_int(ti, 1 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -2575,6 +4195,10 @@ int tws_req_mkt_data(tws_instance_t *ti, int ticker_id, const tr_contract_t *con
 		ti->tx_observe(ti, NULL, 0, REQ_MKT_DATA);
 	}
 
+    /* a snapshot ends by itself, there's nothing to resubscribe */
+    if(!snapshot)
+        record_request(ti, SUB_MKT_DATA, ticker_id);
+
     send_int(ti, REQ_MKT_DATA);
     send_int(ti, 9 /* version */);
     send_int(ti, ticker_id);
@@ -2777,6 +4401,8 @@ int tws_req_mkt_depth(tws_instance_t *ti, int ticker_id, const tr_contract_t *co
 		ti->tx_observe(ti, NULL, 0, REQ_MKT_DEPTH);
 	}
 
+    record_request(ti, SUB_MKT_DEPTH, ticker_id);
+
     send_int(ti, REQ_MKT_DEPTH);
     send_int(ti, 3 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -2807,6 +4433,8 @@ similar to IB/TWS Java method:
 */
 int tws_cancel_mkt_data(tws_instance_t *ti, int ticker_id)
 {
+    drop_subscription(ti, SUB_MKT_DATA, ticker_id);
+
     send_int(ti, CANCEL_MKT_DATA);
     send_int(ti, 1 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -2827,6 +4455,8 @@ int tws_cancel_mkt_depth(tws_instance_t *ti, int ticker_id)
     if(ti->server_version < 6)
         return UPDATE_TWS;
 
+    drop_subscription(ti, SUB_MKT_DEPTH, ticker_id);
+
     send_int(ti, CANCEL_MKT_DEPTH);
     send_int(ti, 1 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -3310,6 +4940,11 @@ int tws_req_account_updates(tws_instance_t *ti, int subscribe, const char acct_c
 		ti->tx_observe(ti, NULL, 0, REQ_ACCOUNT_DATA);
 	}
 
+    if(subscribe)
+        record_request(ti, SUB_ACCOUNT_UPDATES, 0);
+    else
+        drop_subscription(ti, SUB_ACCOUNT_UPDATES, 0);
+
     send_int(ti, REQ_ACCOUNT_DATA);
     send_int(ti, 2 /*VERSION*/);
     send_boolean(ti, subscribe);
@@ -3424,6 +5059,8 @@ int tws_req_news_bulletins(tws_instance_t *ti, int allmsgs)
 		ti->tx_observe(ti, NULL, 0, REQ_NEWS_BULLETINS);
 	}
 
+    record_request(ti, SUB_NEWS_BULLETINS, 0);
+
     send_int(ti, REQ_NEWS_BULLETINS);
     send_int(ti, 1 /*VERSION*/);
     send_boolean(ti, allmsgs);
@@ -3440,6 +5077,8 @@ similar to IB/TWS Java method:
 */
 int tws_cancel_news_bulletins(tws_instance_t *ti)
 {
+    drop_subscription(ti, SUB_NEWS_BULLETINS, 0);
+
     send_int(ti, CANCEL_NEWS_BULLETINS);
     send_int(ti, 1 /*VERSION*/);
 
@@ -3475,6 +5114,8 @@ int tws_req_auto_open_orders(tws_instance_t *ti, int auto_bind)
 		ti->tx_observe(ti, NULL, 0, REQ_AUTO_OPEN_ORDERS);
 	}
 
+    record_request(ti, SUB_AUTO_OPEN_ORDERS, 0);
+
     send_int(ti, REQ_AUTO_OPEN_ORDERS);
     send_int(ti, 1 /*VERSION*/);
     send_boolean(ti, auto_bind);
@@ -3817,6 +5458,8 @@ int tws_req_market_data_type(tws_instance_t *ti, const market_data_type_t market
 		ti->tx_observe(ti, NULL, 0, REQ_MARKET_DATA_TYPE);
 	}
 
+    record_request(ti, SUB_MARKET_DATA_TYPE, 0);
+
     // send the reqMarketDataType message
     send_int(ti, REQ_MARKET_DATA_TYPE);
     send_int(ti, 1 /*version*/);
@@ -3841,6 +5484,8 @@ int tws_request_realtime_bars(tws_instance_t *ti, int ticker_id, const tr_contra
 		ti->tx_observe(ti, NULL, 0, REQ_REAL_TIME_BARS);
 	}
 
+    record_request(ti, SUB_REALTIME_BARS, ticker_id);
+
     send_int(ti, REQ_REAL_TIME_BARS);
     send_int(ti, 1 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -3871,9 +5516,17 @@ similar to IB/TWS Java method:
 */
 int tws_cancel_realtime_bars(tws_instance_t *ti, int ticker_id)
 {
+    bar_aggregation_t *agg;
+
     if(ti->server_version < MIN_SERVER_VER_REAL_TIME_BARS)
         return UPDATE_TWS;
 
+    /* discard partially built higher time frame bars; the aggregation setup itself is kept for a subsequent request */
+    agg = find_bar_aggregation(ti, ticker_id);
+    if(agg)
+        reset_bar_aggregation(agg);
+    drop_subscription(ti, SUB_REALTIME_BARS, ticker_id);
+
     send_int(ti, CANCEL_REAL_TIME_BARS);
     send_int(ti, 1 /*VERSION*/);
     send_int(ti, ticker_id);
@@ -3897,6 +5550,625 @@ const char *tws_connection_time(tws_instance_t *ti)
     return ti->connected ? ti->connect_time : 0;
 }
 
+int tws_start_capture(tws_instance_t *ti, const char *path)
+{
+    tws_capture_file_header_t h;
+    tws_capture_index_header_t xh;
+    char *index_path;
+
+    tws_stop_capture(ti);
+
+    index_path = (char *)malloc(strlen(path) + 5);
+    if(!index_path)
+        return -1;
+    sprintf(index_path, "%s.idx", path);
+    ti->cap_file = fopen(path, "wb");
+    ti->cap_index = fopen(index_path, "wb");
+    free(index_path);
+    if(!ti->cap_file || !ti->cap_index)
+        goto fail;
+    setvbuf(ti->cap_file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    memset(&h, 0, sizeof h);
+    memcpy(h.f_magic, TWS_CAPTURE_MAGIC, sizeof h.f_magic);
+    h.f_version = TWS_CAPTURE_VERSION;
+    h.f_header_size = sizeof h;
+    h.f_start_mono_ns = monotonic_ns();
+    h.f_start_wall_ns = wall_clock_ns();
+
+    memset(&xh, 0, sizeof xh);
+    memcpy(xh.x_magic, TWS_CAPTURE_INDEX_MAGIC, sizeof xh.x_magic);
+    xh.x_interval = TWS_CAPTURE_INDEX_INTERVAL;
+    xh.x_entry_size = sizeof(tws_capture_index_entry_t);
+
+    if(fwrite(&h, sizeof h, 1, ti->cap_file) != 1 || fwrite(&xh, sizeof xh, 1, ti->cap_index) != 1)
+        goto fail;
+
+    ti->cap_offset = sizeof h;
+    ti->cap_seq = 0;
+    ti->cap_hello = 0;
+    ti->cap_last_time = h.f_start_mono_ns;
+    ti->cap_tx_len = 0;
+    return 0;
+
+fail:
+    tws_stop_capture(ti);
+    return -1;
+}
+
+void tws_stop_capture(tws_instance_t *ti)
+{
+    if(ti->cap_file)
+        fclose(ti->cap_file);
+    if(ti->cap_index)
+        fclose(ti->cap_index);
+    ti->cap_file = ti->cap_index = NULL;
+    ti->cap_in_msg = 0;
+
+    free(ti->cap_rx);
+    free(ti->cap_tx);
+    ti->cap_rx = ti->cap_tx = NULL;
+    ti->cap_rx_len = ti->cap_rx_size = ti->cap_tx_len = ti->cap_tx_size = 0;
+}
+
+void tws_get_stats(tws_instance_t *ti, tr_io_stats_t *stats, int reset)
+{
+    *stats = ti->stats;
+    if(reset) {
+        memset(&ti->stats, 0, sizeof ti->stats);
+        ti->stats.st_pool_size = MAX_TWS_STRINGS;
+        ti->stats.st_pool_high_water = ti->pool_in_use;
+        ti->stats.st_long_string_high_water = (unsigned int)ti->long_str_size;
+    }
+}
+
+void tws_set_long_string_buffer(tws_instance_t *ti, unsigned int max_size, unsigned int keep_size)
+{
+    ti->long_str_max = max_size;
+    ti->long_str_keep = keep_size;
+}
+
+void tws_set_historical_data_columnar(tws_instance_t *ti, int enable)
+{
+    ti->historical_columnar = !!enable;
+}
+
+/* send requests for pending items until the window is full; fire the completion event once all items are done */
+static void resolve_contract_advance(tws_instance_t *ti)
+{
+    tr_contract_resolution_t *items;
+
+    while(ti->resolve_in_flight < ti->resolve_window && ti->resolve_next < ti->resolve_count) {
+        tr_contract_resolution_t *item = &ti->resolve_items[ti->resolve_next++];
+        int err;
+
+        item->cr_status = RESOLVE_IN_FLIGHT;
+        ti->resolve_in_flight++;
+        err = tws_req_contract_details(ti, item->cr_req_id, item->cr_contract);
+        if(!ti->resolve_items)
+            return; /* send failure disconnected us: the batch is abandoned */
+        if(err) {
+            item->cr_status = RESOLVE_FAILED;
+            item->cr_error_code = err;
+            ti->resolve_in_flight--;
+            ti->resolve_done++;
+        }
+    }
+
+    if(ti->resolve_done < ti->resolve_count)
+        return;
+
+    /* the batch is finished: the event may start the next one */
+    items = ti->resolve_items;
+    ti->resolve_items = NULL;
+    event_contract_resolution_done(ti->opaque, items, ti->resolve_count);
+}
+
+static tr_contract_resolution_t *resolve_contract_item(tws_instance_t *ti, int req_id)
+{
+    int i = req_id - ti->resolve_first_req_id;
+
+    if(i < 0 || i >= ti->resolve_next || ti->resolve_items[i].cr_status != RESOLVE_IN_FLIGHT)
+        return NULL;
+    return &ti->resolve_items[i];
+}
+
+static void resolve_contract_match(tws_instance_t *ti, int req_id, int conid)
+{
+    tr_contract_resolution_t *item = resolve_contract_item(ti, req_id);
+
+    if(item && !item->cr_num_matches++)
+        item->cr_conid = conid;
+}
+
+/* CONTRACT_DATA_END (error_code == 0) or ERR_MSG for one of the batch items: move the window forward */
+static void resolve_contract_done(tws_instance_t *ti, int req_id, int error_code)
+{
+    tr_contract_resolution_t *item = resolve_contract_item(ti, req_id);
+
+    if(!item)
+        return;
+
+    item->cr_status = error_code ? RESOLVE_FAILED : RESOLVE_DONE;
+    item->cr_error_code = error_code;
+    ti->resolve_in_flight--;
+    ti->resolve_done++;
+    resolve_contract_advance(ti);
+}
+
+int tws_set_xml_streaming(tws_instance_t *ti, int enable)
+{
+    if(!enable) {
+        free(ti->xml);
+        ti->xml = NULL;
+    } else if(!ti->xml) {
+        ti->xml = (xml_tokenizer_t *)malloc(sizeof *ti->xml);
+        if(!ti->xml)
+            return -1;
+    }
+    return 0;
+}
+
+void tws_set_chunked_strings(tws_instance_t *ti, int enable)
+{
+    ti->chunked_strings = !!enable;
+}
+
+void tws_set_scanner_diff(tws_instance_t *ti, int enable)
+{
+    ti->scanner_diff = !!enable;
+}
+
+int tws_resolve_contracts(tws_instance_t *ti, tr_contract_resolution_t *items, int count, int first_req_id, int window)
+{
+    int i;
+
+    if(ti->resolve_items || !items || count <= 0 || window <= 0 || first_req_id > INTEGER_MAX_VALUE - count)
+        return -1;
+
+    for(i = 0; i < count; i++) {
+        items[i].cr_req_id = first_req_id + i;
+        items[i].cr_status = RESOLVE_PENDING;
+        items[i].cr_num_matches = 0;
+        items[i].cr_conid = 0;
+        items[i].cr_error_code = 0;
+    }
+
+    ti->resolve_items = items;
+    ti->resolve_count = count;
+    ti->resolve_first_req_id = first_req_id;
+    ti->resolve_window = window;
+    ti->resolve_next = 0;
+    ti->resolve_in_flight = 0;
+    ti->resolve_done = 0;
+
+    resolve_contract_advance(ti);
+    return 0;
+}
+
+int tws_enable_subscription_registry(tws_instance_t *ti, int enable)
+{
+    unsigned int j;
+
+    if(enable)
+        return ti->subs ? 0 : resize_subscriptions(ti, SUBSCRIPTIONS_MIN_SIZE);
+
+    for(j = 0; j < ti->subs_size; j++)
+        free(ti->subs[j].msg);
+    free(ti->subs);
+    free(ti->sub_msg);
+    ti->subs = NULL;
+    ti->subs_size = ti->subs_used = ti->subs_stale = ti->subs_cursor = 0;
+    ti->subs_resync = 0;
+    ti->sub_kind = SUB_NONE;
+    ti->sub_msg = NULL;
+    ti->sub_msg_len = ti->sub_msg_size = 0;
+    return 0;
+}
+
+int tws_subscription_count(tws_instance_t *ti)
+{
+    return (int)ti->subs_used;
+}
+
+int tws_resubscribe(tws_instance_t *ti, int max_rate)
+{
+    unsigned long long now, allowed;
+
+    if(!ti->connected)
+        return -1;
+    if(!ti->subs_stale && !ti->subs_resync)
+        return 0;
+    if(max_rate <= 0)
+        max_rate = TWS_RESUBSCRIBE_DEFAULT_RATE;
+
+    /* a tenth of a second's worth right away, then 'max_rate' per second since the first call */
+    now = monotonic_ns();
+    if(!ti->subs_pace_start) {
+        ti->subs_pace_start = now;
+        ti->subs_pace_sent = 0;
+    }
+    allowed = (now - ti->subs_pace_start) / 1000000ULL * (unsigned int)max_rate / 1000 + (max_rate + 9) / 10;
+
+    while(ti->subs_pace_sent < allowed) {
+        subscription_t *s;
+
+        if(ti->subs_resync) {
+            ti->subs_resync = 0;
+            ti->subs_pace_sent++;
+            if(tws_req_open_orders(ti))
+                return -1;
+            continue;
+        }
+        if(!ti->subs_stale)
+            break;
+
+        s = next_stale_subscription(ti);
+        if(s->server_version != ti->server_version) {
+            lose_subscription(ti, s);
+            continue;
+        }
+        ti->subs_pace_sent++;
+        if(send_subscription(ti, s))
+            return -1;
+    }
+
+    return (int)ti->subs_stale + ti->subs_resync;
+}
+
+void tws_set_rt_volume_decoding(tws_instance_t *ti, int enable)
+{
+    ti->rt_volume_decoding = !!enable;
+}
+
+int tws_enable_greeks_store(tws_instance_t *ti, int max_ticker_id)
+{
+    const int per_line = GREEKS_ALIGNMENT / sizeof(double);
+    int stride, capacity = max_ticker_id + 1;
+    size_t i, n;
+    void *mem;
+    double *greeks;
+
+    if(max_ticker_id < 0) {
+        free(ti->greeks_mem);
+        ti->greeks_mem = NULL;
+        ti->greeks = NULL;
+        ti->greeks_stride = ti->greeks_capacity = 0;
+        return 0;
+    }
+
+    stride = (capacity + per_line - 1) / per_line * per_line;
+    if(stride < capacity || (size_t)stride > ((size_t)-1 - GREEKS_ALIGNMENT) / (GREEK_TICK_TYPES * GREEK_COUNT * sizeof(double)))
+        return -1;
+
+    n = (size_t)GREEK_TICK_TYPES * GREEK_COUNT * stride;
+    mem = malloc(n * sizeof(double) + GREEKS_ALIGNMENT - 1);
+    if(!mem)
+        return -1;
+
+    greeks = (double *)(((size_t)mem + GREEKS_ALIGNMENT - 1) & ~(size_t)(GREEKS_ALIGNMENT - 1));
+    for(i = 0; i < n; i++)
+        greeks[i] = DBL_MAX;
+
+    /* keep what has been collected so far when the store is resized */
+    if(ti->greeks) {
+        int t, g, keep = capacity < ti->greeks_capacity ? capacity : ti->greeks_capacity;
+
+        for(t = 0; t < GREEK_TICK_TYPES; t++)
+            for(g = 0; g < GREEK_COUNT; g++)
+                memcpy(greeks + ((size_t)t * GREEK_COUNT + g) * stride,
+                       ti->greeks + ((size_t)t * GREEK_COUNT + g) * ti->greeks_stride, keep * sizeof(double));
+    }
+
+    free(ti->greeks_mem);
+    ti->greeks_mem = mem;
+    ti->greeks = greeks;
+    ti->greeks_stride = stride;
+    ti->greeks_capacity = capacity;
+    return 0;
+}
+
+const double *tws_greeks_column(tws_instance_t *ti, tr_tick_type_t type, tr_greek_t greek, int *count)
+{
+    if(!ti->greeks || type < BID_OPTION || type > MODEL_OPTION || greek < 0 || greek >= GREEK_COUNT)
+        return NULL;
+
+    if(count)
+        *count = ti->greeks_capacity;
+    return ti->greeks + ((size_t)(type - BID_OPTION) * GREEK_COUNT + greek) * ti->greeks_stride;
+}
+
+int tws_get_greeks(tws_instance_t *ti, int ticker_id, tr_tick_type_t type, double greeks[GREEK_COUNT])
+{
+    const double *col;
+    int g;
+
+    if(!ti->greeks || ticker_id < 0 || ticker_id >= ti->greeks_capacity || type < BID_OPTION || type > MODEL_OPTION)
+        return -1;
+
+    col = ti->greeks + (size_t)(type - BID_OPTION) * GREEK_COUNT * ti->greeks_stride + ticker_id;
+    for(g = 0; g < GREEK_COUNT; g++)
+        greeks[g] = col[(size_t)g * ti->greeks_stride];
+    return 0;
+}
+
+int tws_enable_id_allocator(tws_instance_t *ti, int first_id)
+{
+    free(ti->id_ctx);
+    free(ti->id_next);
+    ti->id_ctx = NULL;
+    ti->id_next = NULL;
+    ti->id_count = ti->id_size = 0;
+    ti->id_free_head = ti->id_free_tail = -1;
+    if(first_id < 0)
+        return 0;
+
+    ti->id_ctx = (void **)malloc(IDS_MIN_SIZE * sizeof(*ti->id_ctx));
+    ti->id_next = (int *)malloc(IDS_MIN_SIZE * sizeof(*ti->id_next));
+    if(!ti->id_ctx || !ti->id_next) {
+        tws_enable_id_allocator(ti, -1);
+        return -1;
+    }
+    ti->id_base = first_id;
+    ti->id_size = IDS_MIN_SIZE;
+    return 0;
+}
+
+int tws_alloc_id(tws_instance_t *ti, void *context)
+{
+    int j;
+
+    if(!ti->id_size)
+        return -1;
+
+    /* the id released longest ago: late messages for its previous use have had the most time to arrive */
+    if(ti->id_free_head >= 0) {
+        j = ti->id_free_head;
+        ti->id_free_head = ti->id_next[j];
+        if(ti->id_free_head < 0)
+            ti->id_free_tail = -1;
+    } else {
+        if(ti->id_count == ti->id_size) {
+            int size = 2 * ti->id_size;
+            void **ctx;
+            int *next;
+
+            if(size < 0 || ti->id_base > INTEGER_MAX_VALUE - size)
+                return -1;
+            ctx = (void **)realloc(ti->id_ctx, size * sizeof(*ctx));
+            if(!ctx)
+                return -1;
+            ti->id_ctx = ctx;
+            next = (int *)realloc(ti->id_next, size * sizeof(*next));
+            if(!next)
+                return -1;
+            ti->id_next = next;
+            ti->id_size = size;
+        }
+        j = ti->id_count++;
+    }
+
+    ti->id_ctx[j] = context;
+    ti->id_next[j] = ID_IN_USE;
+    return ti->id_base + j;
+}
+
+int tws_free_id(tws_instance_t *ti, int id)
+{
+    unsigned int j = (unsigned int)id - (unsigned int)ti->id_base;
+
+    if(j >= (unsigned int)ti->id_count || ti->id_next[j] != ID_IN_USE)
+        return -1;
+
+    ti->id_ctx[j] = NULL;
+    ti->id_next[j] = -1;
+    if(ti->id_free_tail >= 0)
+        ti->id_next[ti->id_free_tail] = (int)j;
+    else
+        ti->id_free_head = (int)j;
+    ti->id_free_tail = (int)j;
+    return 0;
+}
+
+int tws_set_id_context(tws_instance_t *ti, int id, void *context)
+{
+    unsigned int j = (unsigned int)id - (unsigned int)ti->id_base;
+
+    if(j >= (unsigned int)ti->id_count || ti->id_next[j] != ID_IN_USE)
+        return -1;
+
+    ti->id_ctx[j] = context;
+    return 0;
+}
+
+void *tws_id_context(tws_instance_t *ti, int id)
+{
+    unsigned int j = (unsigned int)id - (unsigned int)ti->id_base;
+
+    return j < (unsigned int)ti->id_count ? ti->id_ctx[j] : NULL;
+}
+
+void *const *tws_id_context_table(tws_instance_t *ti, int *first_id, int *count)
+{
+    if(first_id)
+        *first_id = ti->id_base;
+    if(count)
+        *count = ti->id_count;
+    return ti->id_size ? ti->id_ctx : NULL;
+}
+
+int tws_add_bar_aggregation(tws_instance_t *ti, int req_id, int period)
+{
+    bar_aggregation_t *agg;
+    int j;
+
+    if(period <= REALTIME_BAR_SECONDS || period % REALTIME_BAR_SECONDS)
+        return -1;
+
+    agg = find_bar_aggregation(ti, req_id);
+    if(!agg) {
+        /* keep the load factor at or below 1/2 */
+        if(2 * (ti->bar_aggs_used + 1) > ti->bar_aggs_size) {
+            bar_aggregation_t *old = ti->bar_aggs;
+            unsigned int old_size = ti->bar_aggs_size;
+            unsigned int size = old_size ? 2 * old_size : 16;
+            bar_aggregation_t *slots = (bar_aggregation_t *)calloc(size, sizeof(*slots));
+
+            if(!slots)
+                return -1;
+            ti->bar_aggs = slots;
+            ti->bar_aggs_size = size;
+            for(j = 0; j < (int)old_size; j++) {
+                if(old[j].num_periods) {
+                    unsigned int k = bar_aggregation_slot(ti, old[j].req_id);
+
+                    while(slots[k].num_periods)
+                        k = (k + 1) & (size - 1);
+                    slots[k] = old[j];
+                }
+            }
+            free(old);
+        }
+
+        j = bar_aggregation_slot(ti, req_id);
+        while(ti->bar_aggs[j].num_periods)
+            j = (j + 1) & (ti->bar_aggs_size - 1);
+        agg = &ti->bar_aggs[j];
+        agg->req_id = req_id;
+        ti->bar_aggs_used++;
+    }
+
+    for(j = 0; j < agg->num_periods; j++) {
+        if(agg->acc[j].period == period)
+            return 0;
+    }
+    if(agg->num_periods == MAX_BAR_AGGREGATIONS)
+        return -1;
+
+    memset(&agg->acc[j], 0, sizeof(agg->acc[j]));
+    agg->acc[j].period = period;
+    agg->acc[j].start = -1;
+    agg->num_periods++;
+    return 0;
+}
+
+int tws_remove_bar_aggregation(tws_instance_t *ti, int req_id, int period)
+{
+    bar_aggregation_t *agg = find_bar_aggregation(ti, req_id);
+    unsigned int hole, j, mask;
+    int k;
+
+    if(!agg)
+        return -1;
+
+    for(k = 0; k < agg->num_periods; ) {
+        if(!period || agg->acc[k].period == period)
+            agg->acc[k] = agg->acc[--agg->num_periods];
+        else
+            k++;
+    }
+    if(agg->num_periods)
+        return 0;
+
+    /* slot became empty: shift the remainder of the probe sequence back so lookups need no tombstones */
+    mask = ti->bar_aggs_size - 1;
+    hole = (unsigned int)(agg - ti->bar_aggs);
+    for(j = (hole + 1) & mask; ti->bar_aggs[j].num_periods; j = (j + 1) & mask) {
+        unsigned int home = bar_aggregation_slot(ti, ti->bar_aggs[j].req_id);
+
+        /* move the entry when its home slot does not lie cyclically within (hole, j] */
+        if(((j - home) & mask) >= ((j - hole) & mask)) {
+            ti->bar_aggs[hole] = ti->bar_aggs[j];
+            ti->bar_aggs[j].num_periods = 0;
+            hole = j;
+        }
+    }
+    ti->bar_aggs_used--;
+    return 0;
+}
+
+int tws_enable_latency_stats(tws_instance_t *ti, int enable)
+{
+    int i;
+
+    if(!enable) {
+        if(ti->latency) {
+            for(i = 0; i < LATENCY_MSG_IDS; i++)
+                free(ti->latency[i]);
+            free(ti->latency);
+            ti->latency = NULL;
+        }
+        ti->latency_stats = 0;
+        return 0;
+    }
+
+    if(!ti->latency) {
+        ti->latency = (tr_latency_histogram_t **)calloc(LATENCY_MSG_IDS, sizeof *ti->latency);
+        if(!ti->latency)
+            return -1;
+    }
+    ti->latency_stats = 1;
+    return 0;
+}
+
+const tr_latency_histogram_t *tws_get_latency_stats(tws_instance_t *ti, tws_incoming_id_t id, tr_latency_phase_t phase)
+{
+    if(!ti->latency || (int)id < 0 || (int)id >= LATENCY_MSG_IDS || !ti->latency[id] || phase < 0 || phase >= LATENCY_PHASE_COUNT)
+        return NULL;
+
+    return &ti->latency[id][phase];
+}
+
+void tws_reset_latency_stats(tws_instance_t *ti)
+{
+    int i;
+
+    if(!ti->latency)
+        return;
+
+    for(i = 0; i < LATENCY_MSG_IDS; i++)
+        if(ti->latency[i])
+            memset(ti->latency[i], 0, LATENCY_PHASE_COUNT * sizeof *ti->latency[i]);
+}
+
+unsigned long long tws_latency_bucket_ns(int bucket)
+{
+    unsigned int e, sub;
+
+    if(bucket < TWS_LATENCY_SUB_BUCKETS)
+        return bucket < 0 ? 0 : (unsigned long long)bucket;
+    if(bucket >= TWS_LATENCY_BUCKETS - 1)
+        return ~0ULL;
+
+    /* inverse of latency_bucket() */
+    e = (unsigned int)bucket / TWS_LATENCY_SUB_BUCKETS + 3;
+    sub = (unsigned int)bucket % TWS_LATENCY_SUB_BUCKETS;
+    return ((unsigned long long)(TWS_LATENCY_SUB_BUCKETS + sub + 1) << (e - 4)) - 1;
+}
+
+unsigned long long tws_latency_percentile(const tr_latency_histogram_t *h, double percentile)
+{
+    unsigned long long rank, seen = 0, ns;
+    int i;
+
+    if(!h || !h->lh_count)
+        return 0;
+
+    rank = (unsigned long long)ceil(percentile / 100.0 * (double)h->lh_count);
+    if(rank < 1)
+        rank = 1;
+    if(rank > h->lh_count)
+        rank = h->lh_count;
+
+    for(i = 0; i < TWS_LATENCY_BUCKETS - 1; i++) {
+        seen += h->lh_buckets[i];
+        if(seen >= rank)
+            break;
+    }
+    ns = tws_latency_bucket_ns(i);
+    return ns < h->lh_max_ns ? ns : h->lh_max_ns;
+}
+
 const struct twsclient_errmsg *tws_strerror(int errcode)
 {
     static const struct twsclient_errmsg unknown_err = {
@@ -72,6 +72,14 @@ typedef enum {
 	ALIASES       = 3,
 } tr_fa_msg_type_t;
 
+/* which message an XML document streamed by tws_set_xml_streaming() comes from */
+typedef enum {
+	XML_SCANNER_PARAMETERS = 0,
+	XML_FA_GROUPS          = GROUPS,
+	XML_FA_PROFILES        = PROFILES,
+	XML_FA_ALIASES         = ALIASES,
+} tr_xml_source_t;
+
 typedef enum {
 	MDT_UNKNOWN = 0,
     REALTIME	= 1,
@@ -172,6 +180,47 @@ typedef enum tr_tick_type {
     RT_HISTORICAL_VOL = 58    /* real-time historical volatility -- according to the IB API docs at http://www.interactivebrokers.com/php/apiUsersGuide/apiguide/tables/generic_tick_types.htm */
 } tr_tick_type_t;
 
+/* state of one item of a tws_resolve_contracts() batch */
+typedef enum tr_resolve_status
+{
+    RESOLVE_PENDING = 0,                /* not requested yet */
+    RESOLVE_IN_FLIGHT = 1,              /* REQ_CONTRACT_DATA sent, waiting for CONTRACT_DATA_END */
+    RESOLVE_DONE = 2,                   /* CONTRACT_DATA_END received; cr_num_matches may still be 0 */
+    RESOLVE_FAILED = 3                  /* ERR_MSG received for the request or the request could not be sent */
+} tr_resolve_status_t;
+
+/* kind of row change reported by event_scanner_data_changed() */
+typedef enum tr_scanner_change
+{
+    SCANNER_ROW_ENTERED = 0,            /* conid was not in the previous list */
+    SCANNER_ROW_LEFT = 1,               /* conid is no longer in the list */
+    SCANNER_ROW_MOVED = 2               /* conid is still listed at a different rank */
+} tr_scanner_change_t;
+
+/* columns of the option greeks store, see tws_enable_greeks_store() */
+typedef enum tr_greek
+{
+    GREEK_IMPLIED_VOL = 0,
+    GREEK_DELTA = 1,
+    GREEK_OPT_PRICE = 2,
+    GREEK_PV_DIVIDEND = 3,
+    GREEK_GAMMA = 4,
+    GREEK_VEGA = 5,
+    GREEK_THETA = 6,
+    GREEK_UND_PRICE = 7,
+    GREEK_COUNT = 8
+} tr_greek_t;
+
+/* what the histograms of tws_enable_latency_stats() measure, per incoming message */
+typedef enum tr_latency_phase
+{
+    LATENCY_DECODE = 0,                 /* message id read .. first callback, or the end of a message which fires none */
+    LATENCY_CALLBACK = 1,               /* first callback .. tws_event_process() returns; only messages which fire a callback */
+    LATENCY_TOTAL = 2,                  /* message id read .. tws_event_process() returns */
+    LATENCY_RECEIVE_WAIT = 3,           /* spent in receive() for the rest of the message once its id was read; part of LATENCY_DECODE */
+    LATENCY_PHASE_COUNT = 4
+} tr_latency_phase_t;
+
 
 /* outgoing message IDs */
 typedef enum tws_outgoing_ids {
@@ -1259,6 +1308,83 @@ typedef struct tr_commission_report
     int    cr_yield_redemption_date; /* YYYYMMDD format */
 } tr_commission_report_t;
 
+/*
+one HISTORICAL_DATA message worth of bars, stored column-wise: element [j] of each column describes bar #j.
+
+The columns are owned by the tws instance and are reused for the next message: copy what you need before returning from event_historical_data_columns().
+*/
+typedef struct tr_historical_bars {
+    long          *hb_time;                             /* bar start time in seconds since 1970-01-01 00:00:00; date strings reported with format_date=1 are taken as-is, i.e. in the TWS login timezone */
+    double        *hb_open;
+    double        *hb_high;
+    double        *hb_low;
+    double        *hb_close;
+    double        *hb_wap;
+    long          *hb_volume;
+    int           *hb_bar_count;                        /* -1 when not reported by TWS */
+    unsigned char *hb_has_gaps;                         /* 0 or 1 */
+    int            hb_count;                            /* number of bars in each column */
+} tr_historical_bars_t;
+
+/* one item of a tws_resolve_contracts() batch */
+typedef struct tr_contract_resolution {
+    const tr_contract_t *cr_contract;                   /* in: contract spec; must stay valid until the batch completes */
+    int                  cr_req_id;                     /* out: req_id used for the REQ_CONTRACT_DATA request */
+    tr_resolve_status_t  cr_status;
+    int                  cr_num_matches;                /* number of CONTRACT_DATA / BOND_CONTRACT_DATA replies */
+    int                  cr_conid;                      /* conid of the first reply, 0 when none */
+    int                  cr_error_code;                 /* ERR_MSG error code or twsclient_error_code_t when RESOLVE_FAILED */
+} tr_contract_resolution_t;
+
+/*
+RT_VOLUME (tick type 48) trade print, decoded from the tick string "price;size;time;totalVolume;vwap;singleTrade"
+*/
+typedef struct tr_rt_volume {
+    double    rv_price;                                 /* last trade price; DBL_MAX when the tick only reports a volume update */
+    double    rv_vwap;
+    long long rv_time;                                  /* trade time in milliseconds since 1970-01-01 00:00:00 GMT */
+    long      rv_size;                                  /* last trade size */
+    long      rv_total_volume;
+    int       rv_single_trade;                          /* 1 when the trade was filled by a single market maker */
+} tr_rt_volume_t;
+
+/*
+log-linear histogram of durations in ns: values below TWS_LATENCY_SUB_BUCKETS have a bucket each, every power of two
+above is split into TWS_LATENCY_SUB_BUCKETS linear buckets (about 6% resolution) up to 2^40 ns; longer ones land in the last bucket.
+*/
+#define TWS_LATENCY_SUB_BUCKETS     16
+#define TWS_LATENCY_BUCKETS         (TWS_LATENCY_SUB_BUCKETS * 37)
+
+/* traffic and resource counters of an instance, see tws_get_stats() */
+#define TWS_STATS_MSG_IDS           64              /* message ids counted per id; higher ones only count in the totals */
+
+typedef struct tr_io_stats {
+    unsigned long long st_rx_messages[TWS_STATS_MSG_IDS];   /* decoded messages by tws_incoming_id_t */
+    unsigned long long st_rx_bytes[TWS_STATS_MSG_IDS];      /* their wire size, message id included */
+    unsigned long long st_tx_messages[TWS_STATS_MSG_IDS];   /* sent messages by tws_outgoing_id_t; the connection handshake is left out */
+    unsigned long long st_tx_bytes[TWS_STATS_MSG_IDS];
+    unsigned long long st_receive_calls;                    /* receive() calls, including those which failed or returned 0 */
+    unsigned long long st_receive_bytes;
+    unsigned long long st_refills;                          /* receive() calls which delivered data */
+    unsigned long long st_split_refills;                    /* ... in the middle of a message: the message straddled the receive buffer */
+    unsigned long long st_transmit_calls;
+    unsigned long long st_transmit_bytes;
+    unsigned long long st_flushes;                          /* flush() calls, one per sent message */
+    unsigned long long st_decode_errors;                    /* unknown message ids, messages cut short by corrupt data or a lost connection */
+    unsigned int       st_pool_size;                        /* strings in the per-instance string pool */
+    unsigned int       st_pool_high_water;                  /* most of them in use at once */
+    unsigned int       st_pool_exhausted;                   /* times the pool ran dry, which drops the connection */
+    unsigned int       st_long_string_high_water;           /* largest size of the tws_set_long_string_buffer() buffer */
+} tr_io_stats_t;
+
+typedef struct tr_latency_histogram {
+    unsigned long long lh_count;
+    unsigned long long lh_sum_ns;
+    unsigned long long lh_min_ns;
+    unsigned long long lh_max_ns;
+    unsigned long long lh_buckets[TWS_LATENCY_BUCKETS];   /* bucket i counts the values up to tws_latency_bucket_ns(i) */
+} tr_latency_histogram_t;
+
 
 // internal use structure, treat as a reference/handle:
 struct tws_instance;
@@ -1291,6 +1417,9 @@ typedef int tws_close_func_t(void *arg);
  * reception case, elem==NULL, elem_size==0 and start_of_message is non-zero.
  *
  * Also note that elem/elem_size are undefined when 'return_value' is non-zero, i.e. when an error occurred during reception/decoding of the element.
+ *
+ * The receive observer is called once per field with the whole field, also for the fields tws_set_chunked_strings() and
+ * tws_set_xml_streaming() deliver in pieces (which are collected for the observer only, in the long string buffer).
  */
 typedef int tws_transmit_element_func_t(void *arg, const char *elem, unsigned int elem_size, tws_outgoing_id_t start_of_message);
 typedef int tws_receive_element_func_t(void *arg, const char *elem, unsigned int elem_size, int return_value);
@@ -1332,6 +1461,12 @@ tws_instance_t *tws_create(void *opaque, tws_transmit_func_t *transmit, tws_rece
 void   tws_destroy(tws_instance_t *tws_instance);
 int    tws_connected(tws_instance_t *tws_instance); /* true=1 or false=0 */
 int    tws_event_process(tws_instance_t *tws_instance); /* dispatches event to a callback.c func */
+/*
+ * bytes received and not decoded yet. While this is 0, tws_event_process() starts by calling receive(); otherwise it decodes
+ * from what is there, calling receive() only when the message continues beyond it. An event loop uses this to drain an
+ * instance before it waits for its socket again (see twsapi-loop.h).
+ */
+unsigned int tws_rx_pending(tws_instance_t *tws_instance);
 
 /* init TWS structures to default values */
 void   tws_init_tr_comboleg(tws_instance_t *tws, tr_comboleg_t *comboleg_ref);
@@ -1376,6 +1511,15 @@ char *tws_strcpy(char *tws_string_ref, const char *src);
 /* transmit connect message and wait for response */
 int    tws_connect(tws_instance_t *tws, int client_id);
 void   tws_disconnect(tws_instance_t *tws);
+/* tws_disconnect() when still connected, then tws_connect(); follow up with tws_resubscribe() */
+int    tws_reconnect(tws_instance_t *tws, int client_id);
+/*
+ * 'hook' (NULL: none) is called with 'arg' by tws_disconnect() of a connected instance right before the close() callback,
+ * while the socket is still open: an event loop takes it off its poll set there, before the number can be reused. The
+ * event loop of twsapi-loop.h sets the hook of the instances it holds.
+ */
+typedef void tws_disconnect_hook_func_t(tws_instance_t *tws, void *arg);
+void   tws_set_disconnect_hook(tws_instance_t *tws, tws_disconnect_hook_func_t *hook, void *arg);
 
 /* sends message REQ_SCANNER_PARAMETERS to IB/TWS */
 int    tws_req_scanner_parameters(tws_instance_t *tws);
@@ -1453,6 +1597,159 @@ int    tws_cancel_realtime_bars(tws_instance_t *tws, int ticker_id);
 /**** 2 auxiliary routines */
 int    tws_server_version(tws_instance_t *tws);
 const char *tws_connection_time(tws_instance_t *tws);
+/*
+record the raw traffic of the connection to 'path' in the binary format described in twsapi-capture.h, with a seek index
+in "<path>.idx". Start it before tws_connect() to include the handshake, which replaying the capture needs. Records are
+buffered and written in large blocks; tws_stop_capture() and tws_destroy() write out the rest. A write error stops the capture.
+Returns 0 on success, -1 when the files cannot be created.
+*/
+int    tws_start_capture(tws_instance_t *tws, const char *path);
+void   tws_stop_capture(tws_instance_t *tws);
+/*
+strings of arbitrary length (tick strings, news bulletins, FA and scanner parameter XML, fundamental data) which do not fit
+in a pool string are read into a per-instance buffer that grows geometrically and is reused for the following messages.
+'max_size' caps that buffer (0: no limit); a longer string is treated like any other corrupt element and drops the connection.
+After each such message a buffer larger than 'keep_size' is shrunk back to it (0: freed). Defaults: no limit, 1 MB.
+*/
+void   tws_set_long_string_buffer(tws_instance_t *tws, unsigned int max_size, unsigned int keep_size);
+/*
+copy the traffic and resource counters, which are always kept (a few increments per message), into 'stats'. !0 'reset'
+starts them over, with the high-water marks at the current usage, e.g. for per-interval figures. Counters cover the
+lifetime of the instance across reconnects.
+*/
+void   tws_get_stats(tws_instance_t *tws, tr_io_stats_t *stats, int reset);
+
+/**** optional decoder features: all are turned off after tws_create() */
+
+/* !0: deliver each HISTORICAL_DATA message through a single event_historical_data_columns() call instead of one event_historical_data() call per bar */
+void   tws_set_historical_data_columnar(tws_instance_t *tws, int enable);
+
+/*
+roll the 5 second REAL_TIME_BARS of request 'req_id' up into bars of 'period' seconds (a multiple of 5, e.g. 60, 300, 900 or 3600;
+up to 8 periods per request). Bars are aligned on multiples of 'period' since the epoch and each completed bar is delivered through
+event_aggregated_bar() as soon as its last 5 second bar has arrived. tws_connect() drops the bars in progress, which the
+bars of a new connection do not continue; the aggregations themselves stay. Returns 0 on success, -1 on failure.
+*/
+int    tws_add_bar_aggregation(tws_instance_t *tws, int req_id, int period);
+/* period == 0 removes all aggregations for req_id; returns 0 on success, -1 when nothing was registered */
+int    tws_remove_bar_aggregation(tws_instance_t *tws, int req_id, int period);
+
+/* !0: decode RT_VOLUME tick strings in the library and deliver them through event_tick_rt_volume() instead of event_tick_string() */
+void   tws_set_rt_volume_decoding(tws_instance_t *tws, int enable);
+
+/*
+keep the values delivered by TICK_OPTION_COMPUTATION in a structure-of-arrays store: one column of doubles per greek and per
+tick type (BID_OPTION, ASK_OPTION, LAST_OPTION, MODEL_OPTION), indexed by ticker_id. Ticker ids 0..max_ticker_id are stored,
+others are only passed to event_tick_option_computation(). Values not yet received are DBL_MAX. max_ticker_id < 0 drops the store.
+Returns 0 on success, -1 on failure.
+*/
+int    tws_enable_greeks_store(tws_instance_t *tws, int max_ticker_id);
+/*
+returns a 64 byte aligned column of *count values (the row index is the ticker_id) for scanning a whole option chain at once,
+or NULL when the store is disabled or 'type' is not an option computation tick type. The column stays valid until the store is
+resized or dropped; it is updated in place while messages are processed.
+*/
+const double *tws_greeks_column(tws_instance_t *tws, tr_tick_type_t type, tr_greek_t greek, int *count);
+/* copy the GREEK_COUNT values of one ticker into 'greeks' (indexed by tr_greek_t); returns 0 on success, -1 when not stored */
+int    tws_get_greeks(tws_instance_t *tws, int ticker_id, tr_tick_type_t type, double greeks[GREEK_COUNT]);
+
+/*
+hand out ticker and request ids densely from 'first_id' up, each with a context pointer of the caller's, so that callbacks
+find the object behind a ticker_id or req_id by indexing an array instead of searching a map. The range grows as needed;
+the ids of other requests have to stay out of it. Released ids are handed out again in the order they were released, so
+that late messages for the previous use of an id most likely arrive before it is reused. Enabling again starts over,
+first_id < 0 drops the allocator. Returns 0 on success, -1 on heap alloc failure.
+*/
+int    tws_enable_id_allocator(tws_instance_t *tws, int first_id);
+/* a free id with 'context' attached, or -1 when the allocator is not enabled or out of memory */
+int    tws_alloc_id(tws_instance_t *tws, void *context);
+/* release an id after its request has been cancelled or completed; returns 0 on success, -1 when it is not allocated */
+int    tws_free_id(tws_instance_t *tws, int id);
+/* attach another context to an allocated id; returns 0 on success, -1 when it is not allocated */
+int    tws_set_id_context(tws_instance_t *tws, int id, void *context);
+/* the context of 'id', NULL when it is not allocated or outside the range */
+void  *tws_id_context(tws_instance_t *tws, int id);
+/*
+the context table itself, for callbacks that want to skip the call: entry id - *first_id for ids below *first_id + *count,
+NULL entries for free ids. Valid until tws_alloc_id() grows it or the allocator is dropped; NULL when not enabled.
+*/
+void *const *tws_id_context_table(tws_instance_t *tws, int *first_id, int *count);
+
+/*
+!0: remember the previous SCANNER_DATA list of each ticker_id and deliver only the rows that entered, left or changed rank
+(keyed by conid) through event_scanner_data_changed() instead of one event_scanner_data() call per row. The start and end
+events still fire with the size of the full list. The list is forgotten by tws_req_scanner_subscription() and
+tws_cancel_scanner_subscription() for that ticker_id. Needs servers which send conids (SCANNER_DATA version 3 and up).
+*/
+void   tws_set_scanner_diff(tws_instance_t *tws, int enable);
+
+/*
+!0: do not collect the XML documents of SCANNER_PARAMETERS and RECEIVE_FA but tokenize them while they arrive, straight
+from the receive buffer, and deliver them through event_xml_start_element(), event_xml_attribute(), event_xml_text(),
+event_xml_end_element() and event_xml_end_document() instead of event_scanner_parameters() / event_receive_fa().
+This is a tokenizer, not a validating parser: entity and character references are passed on verbatim, comments,
+processing instructions and declarations are skipped and whitespace-only text is dropped. Returns 0 on success, -1 on heap alloc failure.
+*/
+int    tws_set_xml_streaming(tws_instance_t *tws, int enable);
+
+/*
+!0: deliver the arbitrary length strings of NEWS_BULLETINS, FUNDAMENTAL_DATA and RECEIVE_FA as a sequence of chunks, straight
+from the receive buffer, through event_update_news_bulletin_chunk(), event_fundamental_data_chunk() and event_receive_fa_chunk()
+instead of event_update_news_bulletin(), event_fundamental_data() and event_receive_fa(). Chunks are not NUL terminated;
+the last call of a string has is_last set and may have len == 0. When the connection is lost in the middle of a string,
+its last call has is_last set, data == NULL and len == 0 (and origin_exch NULL for news), and the instance disconnects
+right after it. tws_set_xml_streaming() takes precedence for RECEIVE_FA.
+*/
+void   tws_set_chunked_strings(tws_instance_t *tws, int enable);
+
+/*
+request the contract details of 'count' contracts with at most 'window' REQ_CONTRACT_DATA requests outstanding at any time;
+item i uses req_id first_req_id + i, so that range must not be used by other requests until the batch completes.
+The replies are delivered through the usual events as well; the items are updated in place as CONTRACT_DATA_END or ERR_MSG
+arrive for them and event_contract_resolution_done() fires once all of them are done or failed. One batch per instance
+at a time; a batch is abandoned by tws_disconnect(). Returns 0 on success, -1 on invalid arguments or when a batch is running.
+*/
+int    tws_resolve_contracts(tws_instance_t *tws, tr_contract_resolution_t *items, int count, int first_req_id, int window);
+
+/*
+!0: keep the subscriptions of the instance in a registry so that they survive the connection, e.g. across the daily
+restart of TWS. Registered are the market data (but not snapshot), market depth, realtime bars and scanner requests by
+ticker_id, and the latest market data type, account updates, news bulletins and auto open orders request; a cancel
+removes them again, a request for a ticker_id already registered replaces it. Each request is kept as it was sent, so
+replaying one costs no more than a copy. Disabling drops the registry. Returns 0 on success, -1 on heap alloc failure.
+*/
+int    tws_enable_subscription_registry(tws_instance_t *tws, int enable);
+/* the number of requests in the registry */
+int    tws_subscription_count(tws_instance_t *tws);
+
+#define TWS_RESUBSCRIBE_DEFAULT_RATE    45      /* requests per second; TWS allows 50 messages per second in all */
+
+/*
+after a reconnect: ask for the open orders, then send the registered requests again, the account wide ones first, at no
+more than 'max_rate' (0: the default) per second, starting with a tenth of a second's worth. Call it until it returns 0,
+e.g. from a timer every few tens of milliseconds, and make other requests in between as usual. Requests recorded for
+another server version are dropped and reported through event_error() with the code of the request that failed. Executions
+which happened while disconnected are not asked for: see tws_req_executions(). Returns the number of requests still to be
+sent, or -1 when not connected.
+*/
+int    tws_resubscribe(tws_instance_t *tws, int max_rate);
+
+/*
+!0: time every incoming message on the monotonic clock and record the tr_latency_phase_t durations in histograms per message id.
+The clock starts once the message id has been read, so time spent waiting for the message to arrive is not included. For
+messages which fire several callbacks, or which stream strings or XML, decoding and callbacks interleave: LATENCY_DECODE ends
+at the first callback. Costs three to four clock reads per message and 4 histograms per message id seen (about 19 KB).
+Disabling drops the histograms. Returns 0 on success, -1 on heap alloc failure.
+*/
+int    tws_enable_latency_stats(tws_instance_t *tws, int enable);
+/* histogram of one phase of message 'id', NULL when none has been recorded; updated in place as messages are processed */
+const tr_latency_histogram_t *tws_get_latency_stats(tws_instance_t *tws, tws_incoming_id_t id, tr_latency_phase_t phase);
+/* clear all histograms */
+void   tws_reset_latency_stats(tws_instance_t *tws);
+/* largest duration which falls into 'bucket' */
+unsigned long long tws_latency_bucket_ns(int bucket);
+/* duration below which 'percentile' (0..100) percent of the recorded values fall, to bucket resolution; 0 for an empty histogram */
+unsigned long long tws_latency_percentile(const tr_latency_histogram_t *h, double percentile);
 
 /************************************ callbacks *************************************/
 /* API users must implement some or all of these C functions; the comment before each function describes which incoming message(s) fire the given event: */
@@ -1467,6 +1764,8 @@ void event_tick_option_computation(void *opaque, int ticker_id, tr_tick_type_t t
 void event_tick_generic(void *opaque, int ticker_id, tr_tick_type_t type, double value);
 /* fired by: TICK_STRING */
 void event_tick_string(void *opaque, int ticker_id, tr_tick_type_t type, const char value[]);
+/* fired by: TICK_STRING for tick type RT_VOLUME when tws_set_rt_volume_decoding() is enabled (malformed RT_VOLUME strings, including those lacking a field, are still delivered through event_tick_string()) */
+void event_tick_rt_volume(void *opaque, int ticker_id, const tr_rt_volume_t *trade);
 /* fired by: TICK_EFP */
 void event_tick_efp(void *opaque, int ticker_id, tr_tick_type_t tick_type, double basis_points, const char formatted_basis_points[], double implied_futures_price, int hold_days, const char future_expiry[], double dividend_impact, double dividends_to_expiry);
 /* fired by: ORDER_STATUS */
@@ -1487,6 +1786,8 @@ void event_next_valid_id(void *opaque, int order_id);
 void event_contract_details(void *opaque, int req_id, const tr_contract_details_t *contract_details);
 /* fired by: CONTRACT_DATA_END */
 void event_contract_details_end(void *opaque, int req_id);
+/* fired by: CONTRACT_DATA_END, ERR_MSG when the last item of a tws_resolve_contracts() batch is done */
+void event_contract_resolution_done(void *opaque, tr_contract_resolution_t *items, int count);
 /* fired by: BOND_CONTRACT_DATA */
 void event_bond_contract_details(void *opaque, int req_id, const tr_contract_details_t *contract_details);
 /* fired by: EXECUTION_DATA */
@@ -1501,18 +1802,36 @@ void event_update_mkt_depth(void *opaque, int ticker_id, int position, int opera
 void event_update_mkt_depth_l2(void *opaque, int ticker_id, int position, const char *market_maker, int operation, int side, double price, int size);
 /* fired by: NEWS_BULLETINS */
 void event_update_news_bulletin(void *opaque, int msgid, int msg_type, const char news_msg[], const char origin_exch[]);
+/* fired by: NEWS_BULLETINS when tws_set_chunked_strings() is enabled; origin_exch is NULL except in the last call, which always has len == 0; data is NULL in a last call that ends a string cut short by the connection */
+void event_update_news_bulletin_chunk(void *opaque, int msgid, int msg_type, const char data[], unsigned int len, int is_last, const char origin_exch[]);
 /* fired by: MANAGED_ACCTS */
 void event_managed_accounts(void *opaque, const char accounts_list[]);
 /* fired by: RECEIVE_FA */
 void event_receive_fa(void *opaque, tr_fa_msg_type_t fa_data_type, const char cxml[]);
+/* fired by: RECEIVE_FA when tws_set_chunked_strings() is enabled; data is NULL in a last call that ends a string cut short by the connection */
+void event_receive_fa_chunk(void *opaque, tr_fa_msg_type_t fa_data_type, const char data[], unsigned int len, int is_last);
 /* fired by: HISTORICAL_DATA (possibly multiple times per incoming message) */
 void event_historical_data(void *opaque, int req_id, const char date[], double open, double high, double low, double close, long int volume, int bar_count, double wap, int has_gaps);
 /* fired by: HISTORICAL_DATA  (once, after one or more invocations of event_historical_data()) */
 void event_historical_data_end(void *opaque, int req_id, const char completion_from[], const char completion_to[]);
+/* fired by: HISTORICAL_DATA when tws_set_historical_data_columnar() is enabled (once per message, replaces the event_historical_data() invocations; event_historical_data_end() follows as usual) */
+void event_historical_data_columns(void *opaque, int req_id, const tr_historical_bars_t *bars);
 /* fired by: SCANNER_PARAMETERS */
 void event_scanner_parameters(void *opaque, const char xml[]);
+/* fired by: SCANNER_PARAMETERS, RECEIVE_FA when tws_set_xml_streaming() is enabled */
+void event_xml_start_element(void *opaque, tr_xml_source_t source, const char name[]);
+/* fired by: SCANNER_PARAMETERS, RECEIVE_FA when tws_set_xml_streaming() is enabled; follows event_xml_start_element() of the element carrying the attribute */
+void event_xml_attribute(void *opaque, tr_xml_source_t source, const char name[], const char value[]);
+/* fired by: SCANNER_PARAMETERS, RECEIVE_FA when tws_set_xml_streaming() is enabled; long text nodes arrive in several pieces */
+void event_xml_text(void *opaque, tr_xml_source_t source, const char text[], int len);
+/* fired by: SCANNER_PARAMETERS, RECEIVE_FA when tws_set_xml_streaming() is enabled; also fired for empty elements (<name/>) */
+void event_xml_end_element(void *opaque, tr_xml_source_t source, const char name[]);
+/* fired by: SCANNER_PARAMETERS, RECEIVE_FA when tws_set_xml_streaming() is enabled, once the whole document has been received */
+void event_xml_end_document(void *opaque, tr_xml_source_t source);
 /* fired by: SCANNER_DATA (possibly multiple times per incoming message) */
 void event_scanner_data(void *opaque, int ticker_id, int rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[]);
+/* fired by: SCANNER_DATA when tws_set_scanner_diff() is enabled (rank is -1, cd and the strings are NULL for SCANNER_ROW_LEFT; prev_rank is -1 for SCANNER_ROW_ENTERED) */
+void event_scanner_data_changed(void *opaque, int ticker_id, tr_scanner_change_t change, int conid, int rank, int prev_rank, tr_contract_details_t *cd, const char distance[], const char benchmark[], const char projection[], const char legs_str[]);
 /* fired by: SCANNER_DATA (once, after one or more invocations of event_scanner_data()) */
 void event_scanner_data_end(void *opaque, int ticker_id, int num_elements);
 /* fired by: SCANNER_DATA (once, before any invocations of event_scanner_data()) */
@@ -1521,8 +1840,12 @@ void event_scanner_data_start(void *opaque, int ticker_id, int num_elements);
 void event_current_time(void *opaque, long time);
 /* fired by: REAL_TIME_BARS */
 void event_realtime_bar(void *opaque, int req_id, long time, double open, double high, double low, double close, long int volume, double wap, int count);
+/* fired by: REAL_TIME_BARS (after event_realtime_bar(), for each bar completed by a tws_add_bar_aggregation() time frame) */
+void event_aggregated_bar(void *opaque, int req_id, int period, long time, double open, double high, double low, double close, long int volume, double wap, int count);
 /* fired by: FUNDAMENTAL_DATA */
 void event_fundamental_data(void *opaque, int req_id, const char data[]);
+/* fired by: FUNDAMENTAL_DATA when tws_set_chunked_strings() is enabled; data is NULL in a last call that ends a string cut short by the connection */
+void event_fundamental_data_chunk(void *opaque, int req_id, const char data[], unsigned int len, int is_last);
 /* fired by: DELTA_NEUTRAL_VALIDATION */
 void event_delta_neutral_validation(void *opaque, int req_id, const under_comp_t *und);
 /* fired by: ACCT_DOWNLOAD_END */